@@ -0,0 +1,319 @@
+#include "avi_writer.h"
+
+#include <cstdio>
+#include <cstring>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#define AVI_PREALLOC_BYTES (32u << 20)  // 每次 fallocate 预分配的大小
+#define AVI_FLUSH_BYTES (4u << 20)      // 累计这么多数据后提交一次回写, 避免脏页堆积到 close 时集中写
+#define AVI_HEADER_BYTES 224            // RIFF + hdrl + movi 列表头, 第一帧从这里开始
+#define AVI_MOVI_OFFSET 220             // 'movi' 标识的位置, idx1 的偏移以此为基准
+
+#define AVIF_HASINDEX 0x10
+#define AVIIF_KEYFRAME 0x10
+
+namespace {
+
+void put16(std::vector<uint8_t> &v, uint16_t x)
+{
+    v.push_back(x & 0xFF);
+    v.push_back(x >> 8);
+}
+
+void put32(std::vector<uint8_t> &v, uint32_t x)
+{
+    for (int i = 0; i < 4; i++) v.push_back((x >> (8 * i)) & 0xFF);
+}
+
+void putFourcc(std::vector<uint8_t> &v, const char *fourcc)
+{
+    v.insert(v.end(), fourcc, fourcc + 4);
+}
+
+void putLE32(uint8_t *p, uint32_t x)
+{
+    for (int i = 0; i < 4; i++) p[i] = (x >> (8 * i)) & 0xFF;
+}
+
+} // namespace
+
+AviWriter::~AviWriter()
+{
+    if (fd_ >= 0) close();
+}
+
+bool AviWriter::open(const std::string &path, int width, int height, uint32_t rate, uint32_t scale)
+{
+    if (fd_ >= 0) close();
+    fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
+        perror("Failed to create video file");
+        return false;
+    }
+    path_ = path;
+    width_ = width;
+    height_ = height;
+    rate_ = rate ? rate : 30;
+    scale_ = scale ? scale : 1;
+    pos_ = 0;
+    allocated_ = 0;
+    flushed_ = 0;
+    fallocateOk_ = true;
+    maxChunk_ = 0;
+    index_.clear();
+    firstUs_ = 0;
+    nextSlot_ = 0;
+
+    // 先写占位的文件头, 帧数和长度在 close 时回写
+    const std::vector<uint8_t> head = header();
+    preallocate(head.size());
+    if (!writeAll(head.data(), head.size())) {
+        ::close(fd_);
+        fd_ = -1;
+        unlink(path.c_str());
+        return false;
+    }
+    return true;
+}
+
+uint64_t AviWriter::projectedBytes() const
+{
+    return pos_ + 8 + index_.size() * 16;
+}
+
+int AviWriter::writeFrame(const uint8_t *data, size_t length, int64_t timestampUs)
+{
+    if (fd_ < 0 || !data || length == 0) return -1;
+
+    // 按时间戳算出该帧应处的序号, 比预期靠后说明相机掉了帧, 用空块补齐
+    int gap = 0;
+    if (index_.empty()) {
+        firstUs_ = timestampUs;
+    } else {
+        const int64_t elapsed = timestampUs - firstUs_;
+        const int64_t slot = (elapsed * rate_ + static_cast<int64_t>(scale_) * 500000)
+                             / (static_cast<int64_t>(scale_) * 1000000);
+        const int64_t diff = slot - static_cast<int64_t>(nextSlot_);
+        if (diff > AVI_MAX_GAP_FRAMES || diff < -AVI_MAX_GAP_FRAMES) {
+            // 时间戳不连续(停流重启或时钟跳变), 以当前帧重新对齐, 不补帧
+            firstUs_ = timestampUs - static_cast<int64_t>(nextSlot_) * scale_ * 1000000 / rate_;
+        } else if (diff > 0) {
+            gap = static_cast<int>(diff);
+        }
+    }
+    for (int i = 0; i < gap; i++) {
+        if (!writeChunk(nullptr, 0, 0)) return -1;
+        nextSlot_++;
+    }
+    if (!writeChunk(data, length, AVIIF_KEYFRAME)) return -1;
+    nextSlot_++;
+    return gap;
+}
+
+bool AviWriter::writeChunk(const uint8_t *data, size_t length, uint32_t flags)
+{
+    const uint64_t start = pos_;
+    const size_t padded = length + (length & 1);
+    preallocate(start + 8 + padded);
+
+    uint8_t head[8];
+    memcpy(head, "00dc", 4);
+    putLE32(head + 4, static_cast<uint32_t>(length));
+    static const uint8_t pad = 0;
+
+    // 块头, 数据, 对齐字节一次 writev 写出, 数据不经过额外拷贝
+    struct iovec iov[3];
+    int count = 0;
+    iov[count].iov_base = head;
+    iov[count++].iov_len = sizeof(head);
+    if (length > 0) {
+        iov[count].iov_base = const_cast<uint8_t*>(data);
+        iov[count++].iov_len = length;
+    }
+    if (padded != length) {
+        iov[count].iov_base = const_cast<uint8_t*>(&pad);
+        iov[count++].iov_len = 1;
+    }
+    const size_t total = sizeof(head) + padded;
+    ssize_t n;
+    do {
+        n = writev(fd_, iov, count);
+    } while (n < 0 && errno == EINTR);
+    if (n < 0) {
+        perror("Failed to write video frame");
+        return false;
+    }
+    pos_ += static_cast<uint64_t>(n);
+    // 部分写入时逐段补齐剩余部分
+    size_t done = static_cast<size_t>(n);
+    for (int i = 0; i < count && done < total; i++) {
+        if (done >= iov[i].iov_len) {
+            done -= iov[i].iov_len;
+            continue;
+        }
+        const uint8_t *p = static_cast<const uint8_t*>(iov[i].iov_base) + done;
+        if (!writeAll(p, iov[i].iov_len - done)) return false;
+        done = 0;
+    }
+
+    index_.push_back({flags, static_cast<uint32_t>(start - AVI_MOVI_OFFSET), static_cast<uint32_t>(length)});
+    if (length > maxChunk_) maxChunk_ = static_cast<uint32_t>(length);
+
+    if (pos_ - flushed_ >= AVI_FLUSH_BYTES) {
+        sync_file_range(fd_, flushed_, pos_ - flushed_, SYNC_FILE_RANGE_WRITE);
+        flushed_ = pos_;
+    }
+    return true;
+}
+
+bool AviWriter::writeAll(const void *data, size_t length)
+{
+    const uint8_t *p = static_cast<const uint8_t*>(data);
+    while (length > 0) {
+        const ssize_t n = write(fd_, p, length);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("Failed to write video file");
+            return false;
+        }
+        p += n;
+        length -= static_cast<size_t>(n);
+        pos_ += static_cast<uint64_t>(n);
+    }
+    return true;
+}
+
+// 写入位置接近已分配的末尾时再预分配一段; 文件系统不支持时不再尝试
+void AviWriter::preallocate(uint64_t end)
+{
+    if (!fallocateOk_ || end <= allocated_) return;
+    uint64_t target = allocated_ + AVI_PREALLOC_BYTES;
+    if (target < end) target = end;
+    if (fallocate(fd_, FALLOC_FL_KEEP_SIZE, static_cast<off_t>(allocated_),
+                  static_cast<off_t>(target - allocated_)) != 0) {
+        if (errno != EOPNOTSUPP) perror("Failed to preallocate video file");
+        fallocateOk_ = false;
+        return;
+    }
+    allocated_ = target;
+}
+
+std::vector<uint8_t> AviWriter::header() const
+{
+    const uint32_t frames = static_cast<uint32_t>(index_.size());
+    const uint32_t moviEnd = static_cast<uint32_t>(pos_ > AVI_HEADER_BYTES ? pos_ : AVI_HEADER_BYTES);
+    const uint32_t indexBytes = frames * 16;
+    const uint32_t bufferSize = maxChunk_ ? maxChunk_ + 8 : static_cast<uint32_t>(width_ * height_);
+
+    std::vector<uint8_t> v;
+    v.reserve(AVI_HEADER_BYTES);
+    putFourcc(v, "RIFF");
+    put32(v, moviEnd + (frames ? 8 + indexBytes : 0) - 8);
+    putFourcc(v, "AVI ");
+
+    putFourcc(v, "LIST");
+    put32(v, 192);
+    putFourcc(v, "hdrl");
+    putFourcc(v, "avih");
+    put32(v, 56);
+    put32(v, static_cast<uint32_t>(static_cast<uint64_t>(scale_) * 1000000 / rate_));  // dwMicroSecPerFrame
+    put32(v, static_cast<uint32_t>(static_cast<uint64_t>(maxChunk_) * rate_ / scale_)); // dwMaxBytesPerSec
+    put32(v, 0);                // dwPaddingGranularity
+    put32(v, AVIF_HASINDEX);
+    put32(v, frames);           // dwTotalFrames
+    put32(v, 0);                // dwInitialFrames
+    put32(v, 1);                // dwStreams
+    put32(v, bufferSize);
+    put32(v, static_cast<uint32_t>(width_));
+    put32(v, static_cast<uint32_t>(height_));
+    for (int i = 0; i < 4; i++) put32(v, 0);
+
+    putFourcc(v, "LIST");
+    put32(v, 116);
+    putFourcc(v, "strl");
+    putFourcc(v, "strh");
+    put32(v, 56);
+    putFourcc(v, "vids");
+    putFourcc(v, "MJPG");
+    put32(v, 0);                // dwFlags
+    put16(v, 0);                // wPriority
+    put16(v, 0);                // wLanguage
+    put32(v, 0);                // dwInitialFrames
+    put32(v, scale_);
+    put32(v, rate_);
+    put32(v, 0);                // dwStart
+    put32(v, frames);           // dwLength
+    put32(v, bufferSize);
+    put32(v, 0xFFFFFFFFu);      // dwQuality, 默认
+    put32(v, 0);                // dwSampleSize, 变长帧
+    put16(v, 0);
+    put16(v, 0);
+    put16(v, static_cast<uint16_t>(width_));
+    put16(v, static_cast<uint16_t>(height_));
+
+    putFourcc(v, "strf");
+    put32(v, 40);               // BITMAPINFOHEADER
+    put32(v, 40);
+    put32(v, static_cast<uint32_t>(width_));
+    put32(v, static_cast<uint32_t>(height_));
+    put16(v, 1);                // biPlanes
+    put16(v, 24);               // biBitCount
+    putFourcc(v, "MJPG");
+    put32(v, static_cast<uint32_t>(width_ * height_ * 3));
+    for (int i = 0; i < 4; i++) put32(v, 0);
+
+    putFourcc(v, "LIST");
+    put32(v, moviEnd - AVI_MOVI_OFFSET);
+    putFourcc(v, "movi");
+    return v;
+}
+
+bool AviWriter::close()
+{
+    if (fd_ < 0) return false;
+    bool ok = true;
+
+    // idx1: 每帧一项, 偏移相对 'movi' 标识
+    if (!index_.empty()) {
+        std::vector<uint8_t> idx;
+        idx.reserve(8 + index_.size() * 16);
+        putFourcc(idx, "idx1");
+        put32(idx, static_cast<uint32_t>(index_.size() * 16));
+        for (const IndexEntry &e : index_) {
+            putFourcc(idx, "00dc");
+            put32(idx, e.flags);
+            put32(idx, e.offset);
+            put32(idx, e.size);
+        }
+        const uint64_t moviEnd = pos_;
+        ok = writeAll(idx.data(), idx.size());
+        // header() 以 pos_ 作为 movi 结尾, 回写前退回到索引之前
+        const uint64_t fileEnd = pos_;
+        pos_ = moviEnd;
+        const std::vector<uint8_t> head = header();
+        pos_ = fileEnd;
+        if (ok && pwrite(fd_, head.data(), head.size(), 0) != static_cast<ssize_t>(head.size())) {
+            perror("Failed to update video header");
+            ok = false;
+        }
+    }
+    // 释放多预分配的空间
+    if (allocated_ > pos_ && ftruncate(fd_, static_cast<off_t>(pos_)) != 0) {
+        perror("Failed to truncate video file");
+    }
+    if (fdatasync(fd_) != 0) {
+        perror("Failed to sync video file");
+        ok = false;
+    }
+    if (::close(fd_) != 0) ok = false;
+    fd_ = -1;
+    // 一帧都没有的文件没有意义
+    if (index_.empty()) {
+        unlink(path_.c_str());
+        return false;
+    }
+    return ok;
+}
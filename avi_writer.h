@@ -0,0 +1,66 @@
+#ifndef AVI_WRITER_H
+#define AVI_WRITER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#define AVI_MAX_FILE_BYTES (1000u << 20)   // 单个文件上限, 留出余量保证 AVI 1.0 的 32 位偏移和 idx1 不溢出
+#define AVI_MAX_GAP_FRAMES 60              // 时间戳跳变时最多补的空帧数
+
+/*
+ * MJPEG-AVI 封装(AVI 1.0, 单视频流, 每帧一个 '00dc' 块, 结尾写 idx1 索引)
+ * 帧数据原样写入, 不解码不转码; 帧的位置由 V4L2 时间戳决定, 相机掉帧时补 0 字节的空块(播放器视为重复上一帧), 保持音画/时长正确
+ * 空间用 fallocate 按 AVI_PREALLOC_BYTES 提前分配, 避免边录边扩展文件带来的碎片和元数据更新; close 时截到实际大小并回写文件头
+ * 不是线程安全的, 只在写入线程使用
+ */
+class AviWriter {
+public:
+    AviWriter() = default;
+    ~AviWriter();
+
+    AviWriter(const AviWriter&) = delete;
+    AviWriter& operator=(const AviWriter&) = delete;
+
+    // 帧率为 rate/scale(与 V4L2 timeperframe 相反: timeperframe = scale/rate 秒)
+    bool open(const std::string &path, int width, int height, uint32_t rate, uint32_t scale);
+    // 写入一帧 JPEG, timestampUs 为采集时间(微秒, 同一时钟), 返回补的空帧数, 失败返回 -1
+    int writeFrame(const uint8_t *data, size_t length, int64_t timestampUs);
+    // 回写文件头和索引, 落盘后关闭
+    bool close();
+
+    bool isOpen() const { return fd_ >= 0; }
+    // 当前文件大小加上 close 时要写的索引大小
+    uint64_t projectedBytes() const;
+    uint32_t frames() const { return static_cast<uint32_t>(index_.size()); }
+
+private:
+    struct IndexEntry {
+        uint32_t flags;
+        uint32_t offset;    // 相对 'movi' 标识的偏移
+        uint32_t size;
+    };
+
+    bool writeChunk(const uint8_t *data, size_t length, uint32_t flags);
+    bool writeAll(const void *data, size_t length);
+    void preallocate(uint64_t end);
+    std::vector<uint8_t> header() const;
+
+    int fd_ = -1;
+    std::string path_;
+    int width_ = 0;
+    int height_ = 0;
+    uint32_t rate_ = 30;
+    uint32_t scale_ = 1;
+    uint64_t pos_ = 0;              // 当前写入位置(文件末尾)
+    uint64_t allocated_ = 0;        // fallocate 已分配到的位置
+    uint64_t flushed_ = 0;          // 已提交回写的位置
+    bool fallocateOk_ = true;
+    uint32_t maxChunk_ = 0;
+    std::vector<IndexEntry> index_;
+    int64_t firstUs_ = 0;
+    uint64_t nextSlot_ = 0;         // 下一帧按帧率应处的序号
+};
+
+#endif // AVI_WRITER_H
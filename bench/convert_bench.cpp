@@ -0,0 +1,211 @@
+/*
+ * yuv_convert 各实现的正确性检查与速度测试
+ *  正确性: 与 libyuv 的同类转换逐像素比较, 输出各通道最大误差
+ *  速度  : 每个 指令集 x 输入格式 x 输出格式 x 分辨率 的 MPix/s, libyuv 作为参照
+ * 用法: convert_bench [最短测试秒数]
+ */
+#include "yuv_convert.h"
+#include "libyuv.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+using namespace yuvconv;
+
+typedef std::chrono::steady_clock Clock;
+
+struct Resolution {
+    int width;
+    int height;
+};
+
+static const Resolution resolutions[] = {
+    {640, 480}, {1280, 720}, {1920, 1080}, {3840, 2160}
+};
+static const InFormat inFormats[] = {InFormat::NV12, InFormat::YUYV, InFormat::I420};
+static const OutFormat outFormats[] = {OutFormat::RGB888, OutFormat::BGRA, OutFormat::RGB565};
+static const Isa isas[] = {Isa::Scalar, Isa::SSE2, Isa::AVX2, Isa::NEON};
+
+static const char *inName(InFormat f)
+{
+    return f == InFormat::NV12 ? "NV12" : f == InFormat::YUYV ? "YUYV" : "I420";
+}
+
+static const char *outName(OutFormat f)
+{
+    return f == OutFormat::RGB888 ? "RGB888" : f == OutFormat::BGRA ? "BGRA" : "RGB565";
+}
+
+// 一帧合成输入, 三种格式描述同一幅图像
+struct Source {
+    int width, height;
+    std::vector<uint8_t> y, u, v, uv, yuyv;
+
+    Source(int w, int h) : width(w), height(h)
+    {
+        const int cw = (w + 1) / 2, ch = (h + 1) / 2;
+        y.resize(w * h);
+        u.resize(cw * ch);
+        v.resize(cw * ch);
+        uint32_t seed = 12345;
+        for (size_t i = 0; i < y.size(); i++) {
+            seed = seed * 1103515245 + 12345;
+            y[i] = static_cast<uint8_t>(seed >> 16);
+        }
+        for (size_t i = 0; i < u.size(); i++) {
+            seed = seed * 1103515245 + 12345;
+            u[i] = static_cast<uint8_t>(seed >> 16);
+            v[i] = static_cast<uint8_t>(seed >> 24);
+        }
+        uv.resize(cw * 2 * ch);
+        for (size_t i = 0; i < u.size(); i++) {
+            uv[2 * i] = u[i];
+            uv[2 * i + 1] = v[i];
+        }
+        // YUYV 每行有独立色度, 这里按 4:2:0 复制两行, 与 NV12/I420 表示同一幅图像
+        yuyv.resize(w * 2 * h);
+        for (int row = 0; row < h; row++) {
+            for (int x = 0; x < w; x += 2) {
+                uint8_t *p = &yuyv[(row * w + x) * 2];
+                p[0] = y[row * w + x];
+                p[1] = u[(row / 2) * cw + x / 2];
+                p[2] = y[row * w + x + 1];
+                p[3] = v[(row / 2) * cw + x / 2];
+            }
+        }
+    }
+
+    Planes planes(InFormat f) const
+    {
+        const int cw = (width + 1) / 2;
+        Planes p = {{nullptr, nullptr, nullptr}, {0, 0, 0}};
+        if (f == InFormat::NV12) {
+            p.data[0] = y.data(); p.stride[0] = width;
+            p.data[1] = uv.data(); p.stride[1] = cw * 2;
+        } else if (f == InFormat::YUYV) {
+            p.data[0] = yuyv.data(); p.stride[0] = width * 2;
+        } else {
+            p.data[0] = y.data(); p.stride[0] = width;
+            p.data[1] = u.data(); p.stride[1] = cw;
+            p.data[2] = v.data(); p.stride[2] = cw;
+        }
+        return p;
+    }
+};
+
+// libyuv 参照实现
+static void reference(const Source &s, InFormat in, OutFormat out, uint8_t *dst, int stride)
+{
+    const int w = s.width, h = s.height, cw = (w + 1) / 2;
+    if (in == InFormat::YUYV) {
+        std::vector<uint8_t> argb(w * h * 4);
+        libyuv::YUY2ToARGB(s.yuyv.data(), w * 2, argb.data(), w * 4, w, h);
+        if (out == OutFormat::BGRA) libyuv::ARGBCopy(argb.data(), w * 4, dst, stride, w, h);
+        else if (out == OutFormat::RGB888) libyuv::ARGBToRAW(argb.data(), w * 4, dst, stride, w, h);
+        else libyuv::ARGBToRGB565(argb.data(), w * 4, dst, stride, w, h);
+    } else if (in == InFormat::NV12) {
+        if (out == OutFormat::BGRA) libyuv::NV12ToARGB(s.y.data(), w, s.uv.data(), cw * 2, dst, stride, w, h);
+        else if (out == OutFormat::RGB888) libyuv::NV12ToRAW(s.y.data(), w, s.uv.data(), cw * 2, dst, stride, w, h);
+        else libyuv::NV12ToRGB565(s.y.data(), w, s.uv.data(), cw * 2, dst, stride, w, h);
+    } else {
+        if (out == OutFormat::BGRA) libyuv::I420ToARGB(s.y.data(), w, s.u.data(), cw, s.v.data(), cw, dst, stride, w, h);
+        else if (out == OutFormat::RGB888) libyuv::I420ToRAW(s.y.data(), w, s.u.data(), cw, s.v.data(), cw, dst, stride, w, h);
+        else libyuv::I420ToRGB565(s.y.data(), w, s.u.data(), cw, s.v.data(), cw, dst, stride, w, h);
+    }
+}
+
+// 各通道最大误差(RGB565 按 8 位展开后比较)
+static int maxError(const std::vector<uint8_t> &a, const std::vector<uint8_t> &b, OutFormat out)
+{
+    int worst = 0;
+    if (out == OutFormat::RGB565) {
+        for (size_t i = 0; i + 1 < a.size(); i += 2) {
+            const int pa = a[i] | (a[i + 1] << 8), pb = b[i] | (b[i + 1] << 8);
+            const int dr = std::abs(((pa >> 11) & 31) - ((pb >> 11) & 31)) << 3;
+            const int dg = std::abs(((pa >> 5) & 63) - ((pb >> 5) & 63)) << 2;
+            const int db = std::abs((pa & 31) - (pb & 31)) << 3;
+            worst = std::max(worst, std::max(dr, std::max(dg, db)));
+        }
+    } else {
+        for (size_t i = 0; i < a.size(); i++) worst = std::max(worst, std::abs(a[i] - b[i]));
+    }
+    return worst;
+}
+
+template <typename Fn>
+static double mpixPerSec(int pixels, double minSeconds, Fn fn)
+{
+    fn();
+    int iterations = 0;
+    Clock::time_point start = Clock::now();
+    double elapsed = 0;
+    do {
+        fn();
+        iterations++;
+        elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    } while (elapsed < minSeconds);
+    return static_cast<double>(pixels) * iterations / elapsed / 1e6;
+}
+
+int main(int argc, char *argv[])
+{
+    const double minSeconds = argc > 1 ? std::atof(argv[1]) : 0.2;
+    const Isa defaultIsa = activeIsa();
+    printf("runtime dispatch selected: %s\n", isaName(defaultIsa));
+
+    // 正确性: 奇数尺寸覆盖行尾的标量处理
+    printf("\ncorrectness vs libyuv (max channel error, 8-bit units)\n");
+    bool allOk = true;
+    const Resolution checkSizes[] = {{1920, 1080}, {101, 37}};
+    for (const Resolution &res : checkSizes) {
+        Source src(res.width, res.height);
+        for (InFormat in : inFormats) {
+            // YUYV 要求偶数宽度
+            if (in == InFormat::YUYV && (res.width & 1)) continue;
+            for (OutFormat out : outFormats) {
+                const int stride = res.width * bytesPerPixel(out);
+                std::vector<uint8_t> ref(stride * res.height), got(stride * res.height);
+                reference(src, in, out, ref.data(), stride);
+                for (Isa isa : isas) {
+                    if (!setIsa(isa)) continue;
+                    convert(in, src.planes(in), res.width, res.height, got.data(), stride, out);
+                    const int err = maxError(ref, got, out);
+                    // 与 libyuv 的定点系数不同, 允许少量误差
+                    const bool ok = err <= (out == OutFormat::RGB565 ? 8 : 4);
+                    allOk = allOk && ok;
+                    printf("  %4dx%-4d %s->%-6s %-6s err %2d %s\n", res.width, res.height,
+                           inName(in), outName(out), isaName(isa), err, ok ? "ok" : "FAIL");
+                }
+            }
+        }
+    }
+
+    printf("\nthroughput (MPix/s)\n");
+    for (const Resolution &res : resolutions) {
+        Source src(res.width, res.height);
+        for (InFormat in : inFormats) {
+            for (OutFormat out : outFormats) {
+                const int stride = res.width * bytesPerPixel(out);
+                std::vector<uint8_t> dst(stride * res.height);
+                const int pixels = res.width * res.height;
+                printf("  %4dx%-4d %s->%-6s", res.width, res.height, inName(in), outName(out));
+                for (Isa isa : isas) {
+                    if (!setIsa(isa)) continue;
+                    const Planes p = src.planes(in);
+                    double mps = mpixPerSec(pixels, minSeconds, [&]() {
+                        convert(in, p, res.width, res.height, dst.data(), stride, out);
+                    });
+                    printf("  %s %7.1f", isaName(isa), mps);
+                }
+                double ref = mpixPerSec(pixels, minSeconds, [&]() {
+                    reference(src, in, out, dst.data(), stride);
+                });
+                printf("  libyuv %7.1f\n", ref);
+            }
+        }
+    }
+    setIsa(defaultIsa);
+    return allOk ? 0 : 1;
+}
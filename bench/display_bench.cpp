@@ -0,0 +1,164 @@
+/*
+ * 显示路径单帧耗时对比
+ *  旧: 转换为 RGB888 -> QImage::transformed(rotate 270) -> QImage::scaled(SmoothTransformation)
+ *  新: convertRotateScale 一次完成转换/缩放/旋转
+ *  另测 YUYV/NV12 在不同线程数下按条带并行的耗时, 以及各输出格式的耗时
+ *  最后给出各步骤的 trace 直方图和单次埋点的开销
+ * 输入为合成帧, 不需要摄像头: YUYV/NV12 1920x1080, 以及 MJPG 缩放解码后的 RGB32
+ * 解码尺寸与预览相同, 由 JpegDecoder::pickScaleDenom 按旋转后的显示区域选取(800x480 时为 1/4, 即 480x270)
+ */
+#include "frame_transform.h"
+#include "jpeg_decoder.h"
+#include "thread_pool.h"
+#include "frame_pool.h"
+#include "trace.h"
+#include "libyuv.h"
+
+#include <QImage>
+#include <QMatrix>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+static const int SRC_W = 1920;
+static const int SRC_H = 1080;
+
+template <typename Fn>
+static double timeMs(int iterations, Fn fn)
+{
+    fn();   // 预热, 分配好复用的缓冲区
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < iterations; i++) fn();
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count() / iterations;
+}
+
+static void fillPattern(std::vector<uint8_t> &buf)
+{
+    for (size_t i = 0; i < buf.size(); i++) {
+        buf[i] = static_cast<uint8_t>((i * 7 + (i >> 11) * 13) & 0xFF);
+    }
+}
+
+static QImage oldTail(const QImage &rgb, const QSize &box)
+{
+    QImage rotated = rgb.transformed(QMatrix().rotate(270));
+    return rotated.scaled(box, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+}
+
+int main(int argc, char *argv[])
+{
+    const int iterations = argc > 1 ? std::atoi(argv[1]) : 50;
+    const QSize box(argc > 3 ? std::atoi(argv[2]) : 800, argc > 3 ? std::atoi(argv[3]) : 480);
+
+    std::vector<uint8_t> yuyv(SRC_W * SRC_H * 2);
+    std::vector<uint8_t> nv12(SRC_W * SRC_H * 3 / 2);
+    fillPattern(yuyv);
+    fillPattern(nv12);
+    // 预览解码时显示区域宽高互换(画面旋转 270 度)
+    const int denom = JpegDecoder::pickScaleDenom(SRC_W, SRC_H, QSize(box.height(), box.width()));
+    QImage argb((SRC_W + denom - 1) / denom, (SRC_H + denom - 1) / denom, QImage::Format_RGB32);
+    for (int y = 0; y < argb.height(); y++) {
+        uint8_t *line = argb.scanLine(y);
+        for (int x = 0; x < argb.bytesPerLine(); x++) line[x] = static_cast<uint8_t>(x ^ y);
+    }
+
+    QImage rgb(SRC_W, SRC_H, QImage::Format_RGB888);
+    std::vector<uint8_t> argbTmp(SRC_W * SRC_H * 4);
+    QImage out;
+    printf("box %dx%d, %d iterations, ms/frame\n", box.width(), box.height(), iterations);
+
+    // YUYV: 旧路径与 YUYV2RGB 相同, 经 ARGB 中间缓冲区
+    double before = timeMs(iterations, [&]() {
+        libyuv::YUY2ToARGB(yuyv.data(), SRC_W * 2, argbTmp.data(), SRC_W * 4, SRC_W, SRC_H);
+        libyuv::ARGBToRAW(argbTmp.data(), SRC_W * 4, rgb.bits(), rgb.bytesPerLine(), SRC_W, SRC_H);
+        out = oldTail(rgb, box);
+    });
+    double after = timeMs(iterations, [&]() {
+        FrameView v = {SourceFormat::YUYV, SRC_W, SRC_H, {yuyv.data(), nullptr}, {SRC_W * 2, 0}};
+        convertRotateScale(v, box, out);
+    });
+    printf("  YUYV %dx%d      : before %7.2f  after %7.2f\n", SRC_W, SRC_H, before, after);
+
+    before = timeMs(iterations, [&]() {
+        libyuv::NV12ToRAW(nv12.data(), SRC_W, nv12.data() + SRC_W * SRC_H, SRC_W,
+                          rgb.bits(), rgb.bytesPerLine(), SRC_W, SRC_H);
+        out = oldTail(rgb, box);
+    });
+    after = timeMs(iterations, [&]() {
+        FrameView v = {SourceFormat::NV12, SRC_W, SRC_H,
+                       {nv12.data(), nv12.data() + SRC_W * SRC_H}, {SRC_W, SRC_W}};
+        convertRotateScale(v, box, out);
+    });
+    printf("  NV12 %dx%d      : before %7.2f  after %7.2f\n", SRC_W, SRC_H, before, after);
+
+    // MJPG 缩放解码后的输出, 旧路径为 RGB888
+    QImage decoded = argb.convertToFormat(QImage::Format_RGB888);
+    before = timeMs(iterations, [&]() {
+        out = oldTail(decoded, box);
+    });
+    after = timeMs(iterations, [&]() {
+        FrameView v = {SourceFormat::ARGB, argb.width(), argb.height(),
+                       {argb.constBits(), nullptr}, {argb.bytesPerLine(), 0}};
+        convertRotateScale(v, box, out);
+    });
+    printf("  decoded JPEG %dx%d : before %7.2f  after %7.2f\n", argb.width(), argb.height(), before, after);
+
+    // 条带并行: 线程数包含调用线程
+    printf("strip-parallel, ms/frame\n");
+    for (int threads = 1; threads <= ThreadPool::defaultThreadCount(); threads++) {
+        std::unique_ptr<ThreadPool> pool;
+        if (threads > 1) pool.reset(new ThreadPool(threads - 1));
+        const double yuyvMs = timeMs(iterations, [&]() {
+            FrameView v = {SourceFormat::YUYV, SRC_W, SRC_H, {yuyv.data(), nullptr}, {SRC_W * 2, 0}};
+            convertRotateScale(v, box, out, QImage::Format_RGB888, pool.get());
+        });
+        const double nv12Ms = timeMs(iterations, [&]() {
+            FrameView v = {SourceFormat::NV12, SRC_W, SRC_H,
+                           {nv12.data(), nv12.data() + SRC_W * SRC_H}, {SRC_W, SRC_W}};
+            convertRotateScale(v, box, out, QImage::Format_RGB888, pool.get());
+        });
+        printf("  %d thread(s)  : YUYV %7.2f  NV12 %7.2f\n", threads, yuyvMs, nv12Ms);
+    }
+    // 输出格式: RGB888 绘制时还要由 Qt 转换为屏幕格式, RGB32/RGB16 可直接绘制
+    printf("output format, ms/frame\n");
+    static const struct { QImage::Format format; const char *name; } formats[] = {
+        {QImage::Format_RGB888, "RGB888"}, {QImage::Format_RGB32, "RGB32 "}, {QImage::Format_RGB16, "RGB16 "}
+    };
+    for (const auto &f : formats) {
+        const double yuyvMs = timeMs(iterations, [&]() {
+            FrameView v = {SourceFormat::YUYV, SRC_W, SRC_H, {yuyv.data(), nullptr}, {SRC_W * 2, 0}};
+            convertRotateScale(v, box, out, f.format);
+        });
+        const double argbMs = timeMs(iterations, [&]() {
+            FrameView v = {SourceFormat::ARGB, argb.width(), argb.height(),
+                           {argb.constBits(), nullptr}, {argb.bytesPerLine(), 0}};
+            convertRotateScale(v, box, out, f.format);
+        });
+        printf("  %s : YUYV %7.2f  decoded JPEG %7.2f\n", f.name, yuyvMs, argbMs);
+    }
+    printf("frame pool: %llu hits, %llu misses\n",
+           static_cast<unsigned long long>(FramePool::instance().hits()),
+           static_cast<unsigned long long>(FramePool::instance().misses()));
+
+    // 埋点开销: 每帧约十几次记录, 与 60fps 的 16.7ms 帧间隔相比
+    printf("trace histograms (all runs above)\n");
+    for (const TraceHistogram &h : Tracer::instance().histograms()) {
+        if (h.count == 0) continue;
+        printf("  %-10s : %7llu samples, avg %8.1f us, p99 <= %6llu us\n", h.name,
+               static_cast<unsigned long long>(h.count), h.avgUs(),
+               static_cast<unsigned long long>(h.percentileUs(0.99)));
+    }
+    const int records = 100000;
+    const double traceMs = timeMs(1, [&]() {
+        for (int i = 0; i < records; i++) TraceScope scope(TraceStage::Paint);
+    });
+    const double perRecordUs = traceMs * 1000.0 / records;
+    printf("trace: %.3f us per record, %.3f%% of a 60fps frame at 16 records/frame\n",
+           perRecordUs, perRecordUs * 16 / 16667.0 * 100);
+    return 0;
+}
@@ -0,0 +1,135 @@
+/*
+ * 帧导出的外部消费者示例, 同时测量导出延迟
+ * 用法: QC_EXPORT_SOCKET=/tmp/qc_frames ./QC_e 打开摄像头后运行 export_client /tmp/qc_frames [帧数]
+ * 每帧: 接收元数据和 fd -> mmap 读取(求和, 模拟消费者访问像素) -> munmap/close -> 回复归还
+ * 输出 采集->收到 的延迟 p50/p99 和序号不连续(导出端跳过)的次数
+ */
+#include "frame_exporter.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+static int64_t monotonicUs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+static double percentile(std::vector<int64_t> v, double p)
+{
+    if (v.empty()) return 0;
+    std::sort(v.begin(), v.end());
+    return static_cast<double>(v[static_cast<size_t>(p * (v.size() - 1))]);
+}
+
+// 收一帧, fds 中为本进程的 fd 副本
+static bool receiveFrame(int sock, ExportFrameMsg &msg, int fds[MAX_PLANES])
+{
+    struct iovec iov;
+    iov.iov_base = &msg;
+    iov.iov_len = sizeof(msg);
+    union {
+        char buf[CMSG_SPACE(sizeof(int) * MAX_PLANES)];
+        struct cmsghdr align;
+    } control;
+    struct msghdr hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.msg_iov = &iov;
+    hdr.msg_iovlen = 1;
+    hdr.msg_control = control.buf;
+    hdr.msg_controllen = sizeof(control.buf);
+    if (recvmsg(sock, &hdr, MSG_CMSG_CLOEXEC) != static_cast<ssize_t>(sizeof(msg))) return false;
+
+    for (int p = 0; p < MAX_PLANES; p++) fds[p] = -1;
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&hdr);
+    if (cmsg && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+        const size_t n = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        memcpy(fds, CMSG_DATA(cmsg), sizeof(int) * std::min<size_t>(n, MAX_PLANES));
+    }
+    return msg.magic == EXPORT_MAGIC && msg.planes <= MAX_PLANES;
+}
+
+// 映射并读取一个平面, 返回字节和
+static uint64_t touchPlane(int fd, uint32_t offset, uint32_t length)
+{
+    const long page = sysconf(_SC_PAGESIZE);
+    const size_t base = offset - offset % page;
+    const size_t size = offset - base + length;
+    void *map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, base);
+    if (map == MAP_FAILED) {
+        perror("mmap");
+        return 0;
+    }
+    const uint8_t *data = static_cast<const uint8_t*>(map) + (offset - base);
+    uint64_t sum = 0;
+    for (uint32_t i = 0; i < length; i += 64) sum += data[i];
+    munmap(map, size);
+    return sum;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *path = argc > 1 ? argv[1] : "/tmp/qc_frames";
+    const int frames = argc > 2 ? std::atoi(argv[2]) : 300;
+
+    int sock = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    if (sock < 0 || connect(sock, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0) {
+        perror("connect");
+        return 1;
+    }
+
+    std::vector<int64_t> latency;
+    uint32_t lastSequence = 0;
+    int gaps = 0;
+    uint64_t checksum = 0;
+    for (int i = 0; i < frames; i++) {
+        ExportFrameMsg msg;
+        int fds[MAX_PLANES];
+        if (!receiveFrame(sock, msg, fds)) {
+            fprintf(stderr, "connection closed after %d frames\n", i);
+            break;
+        }
+        latency.push_back(monotonicUs() - msg.timestampUs);
+        if (i > 0 && msg.sequence != lastSequence + 1) gaps++;
+        lastSequence = msg.sequence;
+        for (uint32_t p = 0; p < msg.planes; p++) {
+            if (fds[p] < 0) continue;
+            checksum += touchPlane(fds[p], msg.offset[p], msg.bytesused[p]);
+            close(fds[p]);
+        }
+        if (i == 0) {
+            printf("%c%c%c%c %ux%u, %u plane(s), %u bytes\n",
+                   msg.fourcc & 0xff, (msg.fourcc >> 8) & 0xff, (msg.fourcc >> 16) & 0xff, (msg.fourcc >> 24) & 0xff,
+                   msg.width, msg.height, msg.planes, msg.bytesused[0]);
+        }
+
+        ExportReleaseMsg release;
+        memset(&release, 0, sizeof(release));
+        release.magic = EXPORT_MAGIC;
+        release.token = msg.token;
+        if (send(sock, &release, sizeof(release), MSG_NOSIGNAL) != static_cast<ssize_t>(sizeof(release))) {
+            perror("send");
+            break;
+        }
+    }
+    close(sock);
+
+    printf("%zu frames, %d sequence gaps, checksum %llx\n",
+           latency.size(), gaps, static_cast<unsigned long long>(checksum));
+    printf("capture -> client latency: p50 %.2f ms  p99 %.2f ms\n",
+           percentile(latency, 0.5) / 1000, percentile(latency, 0.99) / 1000);
+    return 0;
+}
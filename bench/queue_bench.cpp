@@ -0,0 +1,194 @@
+/*
+ * SafeQueue 与 SpscQueue 对比测试
+ * 负载: 1080p RGB888 大小的帧句柄(引用计数共享, 与 QPixmap 的隐式共享相同)
+ *  1. 吞吐: 生产者全速入队, 统计每次 入队+出队 的平均耗时
+ *  2. 60fps: 生产者按 16.7ms 节拍入队, 统计 入队->出队 的延迟 p50/p99 和消费线程占用的 CPU 时间
+ *     SpscQueue 没有阻塞出队, 消费者只能轮询(yield); SafeQueue 分别测阻塞(条件变量)和同样轮询两种,
+ *     轮询的延迟更低但一直占着 CPU, 两者要结合 CPU 一起看
+ */
+#include "queue_.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <thread>
+#include <time.h>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+struct FrameData {
+    std::vector<uint8_t> pixels;
+    Clock::time_point stamp;
+};
+
+// 帧句柄: 拷贝只增减引用计数, 与 QPixmap 的开销特征一致
+typedef std::shared_ptr<FrameData> FrameHandle;
+
+static const int FRAME_W = 1920;
+static const int FRAME_H = 1080;
+static const int POOL_SIZE = 8;
+
+static std::vector<FrameHandle> makePool()
+{
+    std::vector<FrameHandle> pool;
+    for (int i = 0; i < POOL_SIZE; i++) {
+        FrameHandle f = std::make_shared<FrameData>();
+        f->pixels.resize(FRAME_W * FRAME_H * 3);
+        pool.push_back(f);
+    }
+    return pool;
+}
+
+static double percentile(std::vector<double> v, double p)
+{
+    if (v.empty()) return 0.0;
+    std::sort(v.begin(), v.end());
+    size_t idx = static_cast<size_t>(p * (v.size() - 1));
+    return v[idx];
+}
+
+static double nsSince(Clock::time_point t)
+{
+    return std::chrono::duration<double, std::nano>(Clock::now() - t).count();
+}
+
+// 当前线程已用的 CPU 时间(用户态+内核态)
+static double threadCpuMs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+// 节拍测试结果: 每帧延迟(ns), 消费线程 CPU 时间和墙钟时间(ms)
+struct PacedResult {
+    std::vector<double> lat;
+    double cpuMs = 0;
+    double wallMs = 0;
+};
+
+// 全速吞吐
+static double throughputSafe(const std::vector<FrameHandle> &pool, int count)
+{
+    SafeQueue<FrameHandle> q;
+    Clock::time_point start = Clock::now();
+    std::thread producer([&]() {
+        for (int i = 0; i < count; i++) {
+            // 与 processFrame 相同: 有界, 超过长度让出 CPU
+            while (q.size() > 15) std::this_thread::yield();
+            q.enqueue(pool[i % POOL_SIZE]);
+        }
+    });
+    for (int i = 0; i < count; i++) {
+        FrameHandle f = q.dequeue();
+        (void)f;
+    }
+    producer.join();
+    return nsSince(start) / count;
+}
+
+static double throughputSpsc(const std::vector<FrameHandle> &pool, int count)
+{
+    SpscQueue<FrameHandle> q(16);
+    Clock::time_point start = Clock::now();
+    std::thread producer([&]() {
+        for (int i = 0; i < count; i++) {
+            while (!q.try_emplace(pool[i % POOL_SIZE])) std::this_thread::yield();
+        }
+    });
+    FrameHandle f;
+    for (int i = 0; i < count; i++) {
+        while (!q.try_pop(f)) std::this_thread::yield();
+    }
+    producer.join();
+    return nsSince(start) / count;
+}
+
+// 60fps 节拍下的入队->出队延迟, spin 为 true 时消费者用 try_dequeue 轮询, 否则阻塞在 dequeue
+static PacedResult pacedSafe(const std::vector<FrameHandle> &pool, int frames, bool spin)
+{
+    SafeQueue<FrameHandle> q;
+    PacedResult r;
+    std::thread producer([&]() {
+        Clock::time_point next = Clock::now();
+        for (int i = 0; i < frames; i++) {
+            next += std::chrono::microseconds(16667);
+            std::this_thread::sleep_until(next);
+            FrameHandle f = pool[i % POOL_SIZE];
+            f->stamp = Clock::now();
+            q.enqueue(f);
+        }
+    });
+    Clock::time_point start = Clock::now();
+    double cpuStart = threadCpuMs();
+    for (int i = 0; i < frames; i++) {
+        FrameHandle f;
+        if (spin) {
+            while (!q.try_dequeue(f)) std::this_thread::yield();
+        } else {
+            f = q.dequeue();
+        }
+        r.lat.push_back(nsSince(f->stamp));
+    }
+    r.cpuMs = threadCpuMs() - cpuStart;
+    r.wallMs = nsSince(start) / 1e6;
+    producer.join();
+    return r;
+}
+
+// SpscQueue 只有非阻塞出队, 消费者轮询
+static PacedResult pacedSpsc(const std::vector<FrameHandle> &pool, int frames)
+{
+    SpscQueue<FrameHandle> q(16);
+    PacedResult r;
+    std::thread producer([&]() {
+        Clock::time_point next = Clock::now();
+        for (int i = 0; i < frames; i++) {
+            next += std::chrono::microseconds(16667);
+            std::this_thread::sleep_until(next);
+            FrameHandle f = pool[i % POOL_SIZE];
+            f->stamp = Clock::now();
+            q.try_push(std::move(f));
+        }
+    });
+    Clock::time_point start = Clock::now();
+    double cpuStart = threadCpuMs();
+    FrameHandle f;
+    for (int i = 0; i < frames; i++) {
+        while (!q.try_pop(f)) std::this_thread::yield();
+        r.lat.push_back(nsSince(f->stamp));
+    }
+    r.cpuMs = threadCpuMs() - cpuStart;
+    r.wallMs = nsSince(start) / 1e6;
+    producer.join();
+    return r;
+}
+
+static void printPaced(const char *name, const PacedResult &r)
+{
+    printf("  %-18s: p50 %8.1f us  p99 %8.1f us  consumer cpu %8.1f ms (%5.1f%%)\n", name,
+           percentile(r.lat, 0.5) / 1000, percentile(r.lat, 0.99) / 1000,
+           r.cpuMs, r.wallMs > 0 ? r.cpuMs * 100 / r.wallMs : 0.0);
+}
+
+int main(int argc, char *argv[])
+{
+    int count = argc > 1 ? std::atoi(argv[1]) : 1000000;
+    int frames = argc > 2 ? std::atoi(argv[2]) : 180;   // 默认 3 秒
+    std::vector<FrameHandle> pool = makePool();
+
+    printf("handle workload: %dx%d RGB888, %d frames in flight\n", FRAME_W, FRAME_H, POOL_SIZE);
+
+    printf("throughput (%d ops)\n", count);
+    printf("  SafeQueue : %8.1f ns/op\n", throughputSafe(pool, count));
+    printf("  SpscQueue : %8.1f ns/op\n", throughputSpsc(pool, count));
+
+    printf("60fps latency (%d frames)\n", frames);
+    printPaced("SafeQueue (block)", pacedSafe(pool, frames, false));
+    printPaced("SafeQueue (spin)", pacedSafe(pool, frames, true));
+    printPaced("SpscQueue (spin)", pacedSpsc(pool, frames));
+    return 0;
+}
@@ -0,0 +1,86 @@
+/*
+ * yuyvToRgb888(拍照路径的 YUYV 转换)的逐字节检查
+ * 参照为原来的三遍实现: YUY2ToARGB 整帧 -> 逐像素交换 R/B -> ARGBToRGB24
+ * 合成 YUYV 帧覆盖奇数宽高、行数不是条带整数倍的情况, 输出行宽按 QImage 的 4 字节对齐留出填充
+ * 用法: yuyv_check, 全部一致时返回 0, 否则打印第一个不一致的位置并返回 1
+ */
+#include "frame_transform.h"
+#include "libyuv.h"
+
+#include <cstdio>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+struct Size {
+    int width;
+    int height;
+};
+
+static const Size sizes[] = {
+    {2, 1}, {3, 5}, {17, 9}, {64, 8}, {64, 16}, {101, 33}, {640, 480}, {641, 479}, {1280, 720}, {1921, 1081}
+};
+
+static std::vector<uint8_t> syntheticYuyv(int stride, int height, uint32_t seed)
+{
+    std::vector<uint8_t> frame(static_cast<size_t>(stride) * height);
+    for (size_t i = 0; i < frame.size(); i++) {
+        seed = seed * 1103515245 + 12345;
+        frame[i] = static_cast<uint8_t>(seed >> 16);
+    }
+    return frame;
+}
+
+// 原来 Vvideo::YUYV2RGB 的实现
+static void referenceYuyv(const uint8_t *src, int srcStride, uint8_t *dst, int dstStride, int width, int height)
+{
+    std::vector<uint8_t> argb(static_cast<size_t>(width) * height * 4);
+    libyuv::YUY2ToARGB(src, srcStride, argb.data(), width * 4, width, height);
+    for (size_t i = 0; i < static_cast<size_t>(width) * height; ++i) {
+        uint8_t *pixel = &argb[i * 4];
+        std::swap(pixel[0], pixel[2]);
+    }
+    libyuv::ARGBToRGB24(argb.data(), width * 4, dst, dstStride, width, height);
+}
+
+static uint64_t fnv1a(const uint8_t *data, size_t length, uint64_t hash)
+{
+    for (size_t i = 0; i < length; i++) hash = (hash ^ data[i]) * 1099511628211ull;
+    return hash;
+}
+
+int main()
+{
+    bool allOk = true;
+    for (size_t n = 0; n < sizeof(sizes) / sizeof(sizes[0]); n++) {
+        const int width = sizes[n].width;
+        const int height = sizes[n].height;
+        const int srcStride = (width + 1) / 2 * 4;         // 奇数宽度时最后一个像素对仍占 4 字节
+        const int dstStride = (width * 3 + 3) & ~3;        // 与 QImage::Format_RGB888 的行宽一致
+        const std::vector<uint8_t> src = syntheticYuyv(srcStride, height, 12345u + static_cast<uint32_t>(n));
+
+        std::vector<uint8_t> expected(static_cast<size_t>(dstStride) * height, 0);
+        std::vector<uint8_t> actual(static_cast<size_t>(dstStride) * height, 0);
+        referenceYuyv(src.data(), srcStride, expected.data(), dstStride, width, height);
+        yuyvToRgb888(src.data(), srcStride, actual.data(), dstStride, width, height);
+
+        bool ok = true;
+        uint64_t digest = 14695981039346656037ull;
+        for (int y = 0; y < height && ok; y++) {
+            const uint8_t *e = expected.data() + static_cast<size_t>(y) * dstStride;
+            const uint8_t *a = actual.data() + static_cast<size_t>(y) * dstStride;
+            digest = fnv1a(a, static_cast<size_t>(width) * 3, digest);
+            if (memcmp(e, a, static_cast<size_t>(width) * 3) == 0) continue;
+            for (int x = 0; x < width * 3; x++) {
+                if (e[x] == a[x]) continue;
+                printf("%4dx%-4d MISMATCH at row %d byte %d: expected %u, got %u\n",
+                       width, height, y, x, e[x], a[x]);
+                break;
+            }
+            ok = false;
+        }
+        if (ok) printf("%4dx%-4d ok      digest %016llx\n", width, height, static_cast<unsigned long long>(digest));
+        allOk = allOk && ok;
+    }
+    return allOk ? 0 : 1;
+}
@@ -0,0 +1,73 @@
+#ifndef CAPTURE_SOURCE_H
+#define CAPTURE_SOURCE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <memory>
+
+#include <QString>
+
+#define MAX_PLANES 3  // 假设最多支持3个平面
+
+typedef struct __frame {
+    void *start;                // 存储每个平面映射的内存
+    size_t length;               // 每个平面的长度
+    size_t bytesused;            // 当前帧的有效数据长度(驱动填写)
+    bool in_use;                 // 是否正在使用
+    int dmabuf;                  // 导出的 dmabuf fd, -1 表示未导出
+} frame_data;
+
+typedef struct __video_buffer {
+    frame_data fm[MAX_PLANES];
+    int plane_count;            // 平面的数量
+    int64_t timestampUs;        // 采集时间(CLOCK_MONOTONIC, 微秒)
+    int64_t dequeueUs;          // DQBUF 返回的时间
+    uint32_t sequence;          // 驱动帧序号(v4l2_buffer.sequence)
+} video_buf_t;
+
+// 出列的一帧, 对应 VIDIOC_DQBUF 返回的 v4l2_buffer
+struct CapturedFrame {
+    int index;                  // 缓冲区索引
+    uint32_t sequence;          // 帧序号, 不连续表示源侧丢帧
+    uint32_t flags;             // V4L2_BUF_FLAG_*
+    int64_t timestampUs;        // 采集时间(CLOCK_MONOTONIC 微秒), 0 表示没有可用时间戳
+    size_t bytesused[MAX_PLANES];
+};
+
+/*
+ * 采集源: 按 V4L2 的缓冲区/索引协议提供帧
+ * initBuffers 准备好缓冲区并开始出帧, dequeue 取得一个已填好的缓冲区, 用完后 requeue 归还
+ * 实现有 V4L2Source(真实设备)和 ReplaySource(从文件回放), Vvideo 只通过这个接口取帧
+ */
+class CaptureSource {
+public:
+    virtual ~CaptureSource() {}
+
+    virtual int open(const QString &name) = 0;
+    // 设置分辨率和像素格式(V4L2_PIX_FMT_*)
+    virtual int setFormat(uint32_t width, uint32_t height, uint32_t fourcc) = 0;
+    // 准备最多 maxCount 个缓冲区写入 bufs(start/length/plane_count)并开始出帧
+    // 返回实际得到的缓冲区数量(可能少于 maxCount), 失败返回 -1
+    virtual int initBuffers(video_buf_t *bufs, int maxCount) = 0;
+    // 等待一帧, 返回 1 表示取得一帧, 0 表示超时或被信号打断, -1 表示出错
+    virtual int dequeue(CapturedFrame &frame, int timeoutMs) = 0;
+    // 把缓冲区还给源继续填充, 任意线程可调用
+    virtual void requeue(int index) = 0;
+    // 停止出帧并释放缓冲区
+    virtual int close() = 0;
+    // 实际帧间隔 numerator/denominator 秒, 未知时返回 false
+    virtual bool frameInterval(uint32_t &numerator, uint32_t &denominator) = 0;
+    // 是否按多平面(MPLANE)方式提供 YUYV/NV12, 单平面设备只按 MJPG 处理
+    virtual bool multiPlane() const = 0;
+    // setFormat 后一帧所需的缓冲区字节数(各平面之和), 未知时返回 0
+    virtual size_t frameSize() const { return 0; }
+    // 把缓冲区的一个平面导出为 fd(dmabuf 或 memfd), 调用者负责关闭; 不支持时返回 -1
+    virtual int exportBuffer(int index, int plane) { (void)index; (void)plane; return -1; }
+    // 优先让设备写入调用方分配的内存(V4L2_MEMORY_USERPTR), 需在 initBuffers 之前设置; 不支持时忽略
+    virtual void preferUserPtr(bool enable) { (void)enable; }
+    // 把已出列缓冲区 index 的各平面内存交给调用者长期持有(引用释放时回到源的池中), 不拷贝
+    // 缓冲区归还时源换上另一块内存; 不支持或没有备用内存时返回 false, 调用者应自行拷贝
+    virtual bool detachBuffer(int index, std::shared_ptr<void> planes[MAX_PLANES]) { (void)index; (void)planes; return false; }
+};
+
+#endif // CAPTURE_SOURCE_H
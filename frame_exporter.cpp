@@ -0,0 +1,488 @@
+#include "frame_exporter.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <algorithm>
+#include <set>
+
+#include <QDebug>
+
+#include "trace.h"
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#endif
+
+FrameExporter::FrameExporter()
+{
+}
+
+FrameExporter::~FrameExporter()
+{
+    stop();
+    for (int i = 0; i < EXPORT_COPY_SLOTS; i++) {
+        if (slots_[i].data) munmap(slots_[i].data, slots_[i].size);
+        if (slots_[i].fd >= 0) ::close(slots_[i].fd);
+    }
+}
+
+int FrameExporter::createMemfd(const char *name, size_t size)
+{
+#ifdef SYS_memfd_create
+    const int fd = static_cast<int>(syscall(SYS_memfd_create, name, MFD_CLOEXEC));
+#else
+    const int fd = -1;
+    errno = ENOSYS;
+#endif
+    if (fd < 0) {
+        perror("Failed to create memfd");
+        return -1;
+    }
+    if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+        perror("Failed to size memfd");
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool FrameExporter::start(const std::string &socketPath)
+{
+    stop();
+    if (socketPath.empty()) return true;
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(addr.sun_path)) {
+        qDebug() << "Frame export socket path too long:" << socketPath.c_str();
+        return false;
+    }
+    memcpy(addr.sun_path, socketPath.c_str(), socketPath.size());
+
+    // SOCK_SEQPACKET 保留消息边界, 一帧一条消息
+    listenFd_ = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (listenFd_ < 0) {
+        perror("Failed to create frame export socket");
+        return false;
+    }
+    unlink(socketPath.c_str());     // 上次异常退出留下的 socket 文件
+    if (bind(listenFd_, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0
+        || listen(listenFd_, EXPORT_MAX_CLIENTS) != 0
+        || pipe2(wakeFd_, O_CLOEXEC) != 0) {
+        perror("Failed to listen on frame export socket");
+        stop();
+        return false;
+    }
+    socketPath_ = socketPath;
+    server_ = std::thread(&FrameExporter::serverLoop, this);
+    qDebug() << "Exporting frames on" << socketPath.c_str();
+    return true;
+}
+
+void FrameExporter::stop()
+{
+    if (server_.joinable()) {
+        const char byte = 0;
+        if (write(wakeFd_[1], &byte, 1) < 0) perror("Failed to wake frame export thread");
+        server_.join();
+    }
+    std::vector<int> clients;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        clients.swap(clients_);
+    }
+    for (size_t i = 0; i < clients.size(); i++) {
+        releaseConsumer(clients[i]);
+        ::close(clients[i]);
+    }
+    if (listenFd_ >= 0) {
+        ::close(listenFd_);
+        listenFd_ = -1;
+        unlink(socketPath_.c_str());
+        socketPath_.clear();
+    }
+    for (int i = 0; i < 2; i++) {
+        if (wakeFd_[i] >= 0) ::close(wakeFd_[i]);
+        wakeFd_[i] = -1;
+    }
+}
+
+int FrameExporter::addListener(const Listener &listener)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    const int id = nextListener_++;
+    listeners_[id] = listener;
+    return id;
+}
+
+void FrameExporter::removeListener(int id)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        listeners_.erase(id);
+    }
+    releaseConsumer(-id);
+}
+
+void FrameExporter::setBufferCallbacks(const BufferCallback &acquire, const BufferCallback &release)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    acquire_ = acquire;
+    release_ = release;
+}
+
+bool FrameExporter::hasConsumers()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return !listeners_.empty() || !clients_.empty();
+}
+
+void FrameExporter::setMaxHeldBuffers(int count)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    maxHeldBuffers_ = std::max(count, 0);
+}
+
+// 各消费者持有的采集缓冲区(去重), 不含 memfd 槽位
+int FrameExporter::heldBuffers() const
+{
+    std::set<int> indexes;
+    for (std::map<uint64_t, Holding>::const_iterator it = holdings_.begin(); it != holdings_.end(); ++it) {
+        if (it->second.index >= 0) indexes.insert(it->second.index);
+    }
+    return static_cast<int>(indexes.size());
+}
+
+int FrameExporter::consumerHeld(int consumer) const
+{
+    int held = 0;
+    for (std::map<uint64_t, Holding>::const_iterator it = holdings_.begin(); it != holdings_.end(); ++it) {
+        if (it->second.consumer == consumer) held++;
+    }
+    return held;
+}
+
+// 取一个空闲的 memfd 槽位并先占住(refs = 1), 大小不够时重新创建
+int FrameExporter::takeCopySlot(size_t bytes)
+{
+    for (int i = 0; i < EXPORT_COPY_SLOTS; i++) {
+        CopySlot &slot = slots_[i];
+        if (slot.refs > 0) continue;
+        if (slot.size < bytes) {
+            if (slot.data) munmap(slot.data, slot.size);
+            if (slot.fd >= 0) ::close(slot.fd);
+            slot.data = nullptr;
+            slot.size = 0;
+            slot.fd = createMemfd("qc_frame", bytes);
+            if (slot.fd < 0) return -1;
+            void *data = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, slot.fd, 0);
+            if (data == MAP_FAILED) {
+                perror("Failed to map memfd");
+                ::close(slot.fd);
+                slot.fd = -1;
+                return -1;
+            }
+            slot.data = data;
+            slot.size = bytes;
+        }
+        slot.refs = 1;
+        return i;
+    }
+    return -1;
+}
+
+void FrameExporter::publish(ExportedFrame frame, const void *const data[MAX_PLANES])
+{
+    bool zeroCopy = frame.fd[0] >= 0;
+    int slot = -1;
+    if (zeroCopy) {
+        // 本帧的缓冲区刚出列, 不在持有中; 再持有一个就超过上限时改为拷贝
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (heldBuffers() >= maxHeldBuffers_) zeroCopy = false;
+    }
+    if (!zeroCopy) {
+        size_t bytes = 0;
+        for (uint32_t p = 0; p < frame.planes; p++) bytes += frame.bytesused[p];
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            slot = takeCopySlot(bytes);
+        }
+        if (slot < 0) {
+            skipped_++;
+            return;
+        }
+        // 槽位已占住, 拷贝时不持锁; 各平面在 memfd 中依次排列
+        uint8_t *dst = static_cast<uint8_t*>(slots_[slot].data);
+        uint32_t offset = 0;
+        for (uint32_t p = 0; p < frame.planes; p++) {
+            memcpy(dst + offset, data[p], frame.bytesused[p]);
+            frame.fd[p] = slots_[slot].fd;
+            frame.offset[p] = offset;
+            offset += frame.bytesused[p];
+        }
+        frame.index = static_cast<uint32_t>(slot);
+    }
+
+    // 先登记持有并增加引用, 再交给消费者, 消费者立即归还也不会提前入队
+    std::vector<std::pair<Listener, uint64_t> > local;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (std::map<int, Listener>::iterator it = listeners_.begin(); it != listeners_.end(); ++it) {
+            if (consumerHeld(-it->first) >= EXPORT_MAX_HELD) {
+                skipped_++;
+                continue;
+            }
+            Holding holding;
+            holding.consumer = -it->first;
+            holding.index = zeroCopy ? static_cast<int>(frame.index) : -1;
+            holding.slot = slot;
+            const uint64_t token = nextToken_++;
+            holdings_[token] = holding;
+            if (zeroCopy) {
+                if (acquire_) acquire_(holding.index);
+            } else {
+                slots_[slot].refs++;
+            }
+            local.push_back(std::make_pair(it->second, token));
+        }
+        // socket 为非阻塞发送, 在锁内完成, 避免与服务线程关闭连接交错
+        for (size_t i = 0; i < clients_.size(); i++) {
+            const int client = clients_[i];
+            if (consumerHeld(client) >= EXPORT_MAX_HELD) {
+                skipped_++;
+                continue;
+            }
+            frame.token = nextToken_++;
+            if (!sendFrame(client, frame)) {
+                skipped_++;
+                continue;
+            }
+            Holding holding;
+            holding.consumer = client;
+            holding.index = zeroCopy ? static_cast<int>(frame.index) : -1;
+            holding.slot = slot;
+            holdings_[frame.token] = holding;
+            if (zeroCopy) {
+                if (acquire_) acquire_(holding.index);
+            } else {
+                slots_[slot].refs++;
+            }
+            published_++;
+            (zeroCopy ? zeroCopy_ : copied_)++;
+        }
+        if (slot >= 0) slots_[slot].refs--;
+    }
+
+    for (size_t i = 0; i < local.size(); i++) {
+        frame.token = local[i].second;
+        published_++;
+        (zeroCopy ? zeroCopy_ : copied_)++;
+        local[i].first(frame);
+    }
+}
+
+bool FrameExporter::sendFrame(int client, const ExportedFrame &frame)
+{
+    ExportFrameMsg msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.magic = EXPORT_MAGIC;
+    msg.planes = frame.planes;
+    msg.token = frame.token;
+    msg.index = frame.index;
+    msg.sequence = frame.sequence;
+    msg.timestampUs = frame.timestampUs;
+    msg.fourcc = frame.fourcc;
+    msg.width = frame.width;
+    msg.height = frame.height;
+    memcpy(msg.offset, frame.offset, sizeof(msg.offset));
+    memcpy(msg.bytesused, frame.bytesused, sizeof(msg.bytesused));
+    memcpy(msg.stride, frame.stride, sizeof(msg.stride));
+
+    struct iovec iov;
+    iov.iov_base = &msg;
+    iov.iov_len = sizeof(msg);
+    union {
+        char buf[CMSG_SPACE(sizeof(int) * MAX_PLANES)];
+        struct cmsghdr align;
+    } control;
+    memset(&control, 0, sizeof(control));
+    struct msghdr hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.msg_iov = &iov;
+    hdr.msg_iovlen = 1;
+    hdr.msg_control = control.buf;
+    hdr.msg_controllen = CMSG_SPACE(sizeof(int) * frame.planes);
+    // fd 随消息一起复制到对方进程
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&hdr);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int) * frame.planes);
+    memcpy(CMSG_DATA(cmsg), frame.fd, sizeof(int) * frame.planes);
+
+    return sendmsg(client, &hdr, MSG_DONTWAIT | MSG_NOSIGNAL) == static_cast<ssize_t>(sizeof(msg));
+}
+
+// consumer 为 0 时不检查归属(进程内调用)
+void FrameExporter::releaseLocked(uint64_t token, int consumer, std::vector<int> &buffers)
+{
+    std::map<uint64_t, Holding>::iterator it = holdings_.find(token);
+    if (it == holdings_.end()) return;
+    if (consumer != 0 && it->second.consumer != consumer) return;
+    if (it->second.index >= 0) {
+        buffers.push_back(it->second.index);
+    } else if (it->second.slot >= 0) {
+        slots_[it->second.slot].refs--;
+    }
+    holdings_.erase(it);
+}
+
+void FrameExporter::release(uint64_t token)
+{
+    std::vector<int> buffers;
+    BufferCallback release;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        releaseLocked(token, 0, buffers);
+        release = release_;
+    }
+    // 归还采集缓冲区会入队给驱动, 不在锁内进行
+    for (size_t i = 0; i < buffers.size(); i++) {
+        if (release) release(buffers[i]);
+    }
+}
+
+void FrameExporter::releaseConsumer(int consumer)
+{
+    std::vector<int> buffers;
+    BufferCallback release;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::vector<uint64_t> tokens;
+        for (std::map<uint64_t, Holding>::iterator it = holdings_.begin(); it != holdings_.end(); ++it) {
+            if (it->second.consumer == consumer) tokens.push_back(it->first);
+        }
+        for (size_t i = 0; i < tokens.size(); i++) releaseLocked(tokens[i], consumer, buffers);
+        release = release_;
+    }
+    for (size_t i = 0; i < buffers.size(); i++) {
+        if (release) release(buffers[i]);
+    }
+}
+
+void FrameExporter::releaseAll()
+{
+    std::vector<int> buffers;
+    BufferCallback release;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::vector<uint64_t> tokens;
+        for (std::map<uint64_t, Holding>::iterator it = holdings_.begin(); it != holdings_.end(); ++it) {
+            tokens.push_back(it->first);
+        }
+        for (size_t i = 0; i < tokens.size(); i++) releaseLocked(tokens[i], 0, buffers);
+        release = release_;
+    }
+    for (size_t i = 0; i < buffers.size(); i++) {
+        if (release) release(buffers[i]);
+    }
+}
+
+void FrameExporter::serverLoop()
+{
+    Tracer::setThreadName("export");
+    std::vector<struct pollfd> fds;
+    for (;;) {
+        fds.clear();
+        struct pollfd wake = {wakeFd_[0], POLLIN, 0};
+        struct pollfd listener = {listenFd_, POLLIN, 0};
+        fds.push_back(wake);
+        fds.push_back(listener);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (size_t i = 0; i < clients_.size(); i++) {
+                struct pollfd client = {clients_[i], POLLIN, 0};
+                fds.push_back(client);
+            }
+        }
+        if (poll(fds.data(), fds.size(), -1) < 0) {
+            if (errno == EINTR) continue;
+            perror("poll");
+            break;
+        }
+        if (fds[0].revents) break;
+
+        if (fds[1].revents & POLLIN) {
+            const int client = accept4(listenFd_, NULL, NULL, SOCK_CLOEXEC | SOCK_NONBLOCK);
+            if (client >= 0) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (clients_.size() >= EXPORT_MAX_CLIENTS) {
+                    ::close(client);
+                } else {
+                    clients_.push_back(client);
+                    qDebug() << "Frame export client connected";
+                }
+            }
+        }
+
+        for (size_t i = 2; i < fds.size(); i++) {
+            if (!fds[i].revents) continue;
+            const int client = fds[i].fd;
+            bool closed = (fds[i].revents & (POLLHUP | POLLERR)) != 0;
+            // 读完所有归还消息
+            for (;;) {
+                ExportReleaseMsg msg;
+                const ssize_t n = recv(client, &msg, sizeof(msg), MSG_DONTWAIT);
+                if (n == static_cast<ssize_t>(sizeof(msg)) && msg.magic == EXPORT_MAGIC) {
+                    std::vector<int> buffers;
+                    BufferCallback release;
+                    {
+                        std::lock_guard<std::mutex> lock(mutex_);
+                        releaseLocked(msg.token, client, buffers);
+                        release = release_;
+                    }
+                    for (size_t b = 0; b < buffers.size(); b++) {
+                        if (release) release(buffers[b]);
+                    }
+                    continue;
+                }
+                if (n > 0) continue;    // 格式不对的消息忽略
+                if (n < 0 && errno == EINTR) continue;
+                if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) closed = true;
+                break;
+            }
+            if (closed) {
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    clients_.erase(std::remove(clients_.begin(), clients_.end(), client), clients_.end());
+                }
+                // 断开的消费者持有的帧全部归还
+                releaseConsumer(client);
+                ::close(client);
+                qDebug() << "Frame export client disconnected";
+            }
+        }
+    }
+}
+
+ExportStats FrameExporter::stats()
+{
+    ExportStats st;
+    st.published = published_;
+    st.zeroCopy = zeroCopy_;
+    st.copied = copied_;
+    st.skipped = skipped_;
+    std::lock_guard<std::mutex> lock(mutex_);
+    st.clients = static_cast<int>(clients_.size());
+    st.listeners = static_cast<int>(listeners_.size());
+    st.heldBuffers = heldBuffers();
+    return st;
+}
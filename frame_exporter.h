@@ -0,0 +1,158 @@
+#ifndef FRAME_EXPORTER_H
+#define FRAME_EXPORTER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "capture_source.h"
+
+#define EXPORT_MAGIC 0x46435151u        // 'QQCF', 消息头
+#define EXPORT_MAX_HELD 2               // 每个消费者同时持有的帧数上限, 超出时跳过该消费者, 不拖住采集
+                                        // 也是所有消费者合计持有的采集缓冲区的默认上限(见 setMaxHeldBuffers)
+#define EXPORT_COPY_SLOTS 4             // 无法导出 dmabuf 时拷贝用的 memfd 缓冲区数量
+#define EXPORT_MAX_CLIENTS 8
+
+// 导出的一帧: 每个平面一个 fd(dmabuf 或 memfd), 数据从 offset 开始
+// 进程内消费者拿到的 fd 归导出端所有, 不要关闭; 外部进程收到的是 SCM_RIGHTS 复制的 fd, 用完自己关闭
+struct ExportedFrame {
+    uint64_t token;                 // 归还时使用
+    uint32_t index;                 // 采集缓冲区索引, 拷贝导出时为 memfd 槽位
+    uint32_t sequence;
+    int64_t timestampUs;            // 采集时间(CLOCK_MONOTONIC)
+    uint32_t fourcc;                // V4L2_PIX_FMT_*
+    uint32_t width;
+    uint32_t height;
+    uint32_t planes;
+    int fd[MAX_PLANES];
+    uint32_t offset[MAX_PLANES];
+    uint32_t bytesused[MAX_PLANES];
+    uint32_t stride[MAX_PLANES];    // MJPG 为 0
+};
+
+// socket 上的消息: 导出端发送 ExportFrameMsg(附带 planes 个 fd), 消费者用完后回 ExportReleaseMsg
+struct ExportFrameMsg {
+    uint32_t magic;
+    uint32_t planes;
+    uint64_t token;
+    uint32_t index;
+    uint32_t sequence;
+    int64_t timestampUs;
+    uint32_t fourcc;
+    uint32_t width;
+    uint32_t height;
+    uint32_t offset[MAX_PLANES];
+    uint32_t bytesused[MAX_PLANES];
+    uint32_t stride[MAX_PLANES];
+};
+
+struct ExportReleaseMsg {
+    uint32_t magic;
+    uint32_t reserved;
+    uint64_t token;
+};
+
+// 导出统计
+struct ExportStats {
+    uint64_t published;         // 送出的帧数(按消费者计)
+    uint64_t zeroCopy;          // 其中直接导出采集缓冲区的帧数
+    uint64_t copied;            // 其中拷贝到 memfd 的帧数
+    uint64_t skipped;           // 消费者持有帧太多或 socket 写满而跳过的次数
+    int clients;                // 当前连接的外部进程数
+    int listeners;              // 进程内消费者数
+    int heldBuffers;            // 消费者正在持有的采集缓冲区数
+};
+
+/*
+ * 帧导出: 把采集缓冲区以 fd + 元数据交给进程内和进程外的消费者, 不拷贝像素
+ * 采集缓冲区能导出 dmabuf(VIDIOC_EXPBUF)时直接共享, 每个消费者持有期间通过 acquire/release 回调
+ * 增减 Vvideo 中该缓冲区的引用, 全部归还后才重新入队给驱动
+ * 不能导出时拷贝到 memfd 缓冲区再共享, 采集缓冲区立即可以归还
+ * 所有消费者合计持有的采集缓冲区数有上限, 达到上限后新帧改为拷贝到 memfd, 慢消费者不会占光驱动的缓冲区
+ * 外部进程通过 SOCK_SEQPACKET Unix socket 连接, fd 经 SCM_RIGHTS 传递, 断开时自动归还其持有的帧
+ */
+class FrameExporter {
+public:
+    typedef std::function<void(const ExportedFrame&)> Listener;
+    typedef std::function<void(int index)> BufferCallback;
+
+    FrameExporter();
+    ~FrameExporter();
+
+    FrameExporter(const FrameExporter&) = delete;
+    FrameExporter& operator=(const FrameExporter&) = delete;
+
+    // 在 socketPath 上监听外部进程, 为空时只服务进程内消费者
+    bool start(const std::string &socketPath);
+    void stop();
+
+    // 进程内消费者, 回调在处理线程中调用, 不能阻塞; 每帧用完后必须调用 release(frame.token)
+    int addListener(const Listener &listener);
+    void removeListener(int id);
+    void release(uint64_t token);
+
+    // 以下由 Vvideo 调用
+    void setBufferCallbacks(const BufferCallback &acquire, const BufferCallback &release);
+    // 消费者合计最多同时持有的采集缓冲区数, 0 表示全部拷贝导出
+    void setMaxHeldBuffers(int count);
+    bool hasConsumers();
+    // frame.fd 有效且未达到持有上限时直接导出采集缓冲区, 否则把 data 中各平面拷贝到 memfd 后导出
+    void publish(ExportedFrame frame, const void *const data[MAX_PLANES]);
+    // 停止采集前调用: 忘掉所有持有记录, 之后迟到的归还被忽略
+    void releaseAll();
+
+    ExportStats stats();
+
+    // memfd_create 的封装, 老版本 glibc 没有该函数
+    static int createMemfd(const char *name, size_t size);
+
+private:
+    struct Holding {
+        int consumer;               // >0 为外部进程(socket fd), <0 为进程内消费者(-id)
+        int index;                  // 采集缓冲区索引, -1 表示拷贝槽位
+        int slot;
+    };
+    struct CopySlot {
+        int fd = -1;
+        void *data = nullptr;
+        size_t size = 0;
+        int refs = 0;
+    };
+
+    int consumerHeld(int consumer) const;
+    int heldBuffers() const;
+    int takeCopySlot(size_t bytes);
+    void releaseLocked(uint64_t token, int consumer, std::vector<int> &buffers);
+    void releaseConsumer(int consumer);
+    void serverLoop();
+    bool sendFrame(int client, const ExportedFrame &frame);
+
+    std::mutex mutex_;
+    std::map<int, Listener> listeners_;
+    int nextListener_ = 1;
+    std::vector<int> clients_;
+    std::map<uint64_t, Holding> holdings_;
+    uint64_t nextToken_ = 1;
+    CopySlot slots_[EXPORT_COPY_SLOTS];
+    BufferCallback acquire_;
+    BufferCallback release_;
+    int maxHeldBuffers_ = EXPORT_MAX_HELD;
+
+    std::string socketPath_;
+    int listenFd_ = -1;
+    int wakeFd_[2] = {-1, -1};
+    std::thread server_;
+
+    std::atomic<uint64_t> published_{0};
+    std::atomic<uint64_t> zeroCopy_{0};
+    std::atomic<uint64_t> copied_{0};
+    std::atomic<uint64_t> skipped_{0};
+};
+
+#endif // FRAME_EXPORTER_H
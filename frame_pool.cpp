@@ -0,0 +1,188 @@
+#include "frame_pool.h"
+
+#include <stdlib.h>
+
+#include <deque>
+#include <mutex>
+
+namespace {
+
+const size_t ALIGNMENT = 64;
+// instance() 的上限: 预览/解码帧在各队列中同时存在的数量不超过十几帧
+const size_t DEFAULT_MAX_FREE_BUFFERS = 16;
+const size_t DEFAULT_MAX_FREE_BYTES = 32 * 1024 * 1024;
+
+int bytesPerPixel(QImage::Format format)
+{
+    switch (format) {
+    case QImage::Format_RGB888:
+        return 3;
+    case QImage::Format_RGB16:
+        return 2;
+    default:
+        return 4;
+    }
+}
+
+} // namespace
+
+struct FramePool::Block {
+    uint8_t *data;
+    size_t size;
+    std::shared_ptr<State> owner;   // 仅在被 QImage 使用期间持有, 空闲时置空, 避免循环引用
+};
+
+struct FramePool::State {
+    mutable std::mutex mutex;
+    std::deque<Block*> free;        // 尾部为最近归还的缓冲区
+    size_t freeBytes = 0;
+    size_t maxFreeBuffers;
+    size_t maxFreeBytes;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    bool closed = false;
+
+    // 超出上限时释放最早归还的缓冲区, 调用者持有锁
+    void enforceLimits()
+    {
+        while (!free.empty() && (free.size() > maxFreeBuffers || freeBytes > maxFreeBytes)) {
+            Block *b = free.front();
+            free.pop_front();
+            freeBytes -= b->size;
+            ::free(b->data);
+            delete b;
+        }
+    }
+
+    void releaseAll()
+    {
+        for (Block *b : free) {
+            ::free(b->data);
+            delete b;
+        }
+        free.clear();
+        freeBytes = 0;
+    }
+};
+
+FramePool::FramePool(size_t maxFreeBuffers, size_t maxFreeBytes)
+    : state_(std::make_shared<State>())
+{
+    state_->maxFreeBuffers = maxFreeBuffers;
+    state_->maxFreeBytes = maxFreeBytes;
+}
+
+FramePool::~FramePool()
+{
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    state_->closed = true;
+    state_->releaseAll();
+}
+
+FramePool& FramePool::instance()
+{
+    static FramePool pool(DEFAULT_MAX_FREE_BUFFERS, DEFAULT_MAX_FREE_BYTES);
+    return pool;
+}
+
+int FramePool::strideFor(int width, QImage::Format format)
+{
+    const size_t bytes = static_cast<size_t>(width) * bytesPerPixel(format);
+    return static_cast<int>((bytes + ALIGNMENT - 1) & ~(ALIGNMENT - 1));
+}
+
+// 优先取最近归还的同尺寸缓冲区(更可能仍在缓存中), 没有则新分配
+FramePool::Block *FramePool::take(size_t size, bool countStats)
+{
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        for (auto it = state_->free.rbegin(); it != state_->free.rend(); ++it) {
+            if ((*it)->size == size) {
+                Block *b = *it;
+                state_->free.erase(std::next(it).base());
+                state_->freeBytes -= size;
+                if (countStats) state_->hits++;
+                return b;
+            }
+        }
+        if (countStats) state_->misses++;
+    }
+
+    void *data = nullptr;
+    if (posix_memalign(&data, ALIGNMENT, size) != 0) return nullptr;
+    Block *b = new Block;
+    b->data = static_cast<uint8_t*>(data);
+    b->size = size;
+    return b;
+}
+
+QImage FramePool::acquire(int width, int height, QImage::Format format)
+{
+    if (width <= 0 || height <= 0) return QImage();
+    const int stride = strideFor(width, format);
+    Block *b = take(static_cast<size_t>(stride) * height, true);
+    if (!b) return QImage(width, height, format);
+
+    b->owner = state_;
+    return QImage(b->data, width, height, stride, format, &FramePool::release, b);
+}
+
+void FramePool::preallocate(int width, int height, QImage::Format format, int count)
+{
+    const size_t size = static_cast<size_t>(strideFor(width, format)) * height;
+    for (int i = 0; i < count; i++) {
+        Block *b = take(size, false);
+        if (!b) return;
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        state_->free.push_front(b);
+        state_->freeBytes += size;
+        state_->enforceLimits();
+    }
+}
+
+void FramePool::trim()
+{
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    state_->releaseAll();
+}
+
+// QImage 的 cleanup 回调, 在最后一个引用释放的线程中调用
+void FramePool::release(void *info)
+{
+    Block *b = static_cast<Block*>(info);
+    // 先取出持有的 State, 保证解锁之后才可能析构它
+    std::shared_ptr<State> state = std::move(b->owner);
+    std::lock_guard<std::mutex> lock(state->mutex);
+    if (state->closed) {
+        ::free(b->data);
+        delete b;
+        return;
+    }
+    state->free.push_back(b);
+    state->freeBytes += b->size;
+    state->enforceLimits();
+}
+
+uint64_t FramePool::hits() const
+{
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    return state_->hits;
+}
+
+uint64_t FramePool::misses() const
+{
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    return state_->misses;
+}
+
+size_t FramePool::freeBuffers() const
+{
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    return state_->free.size();
+}
+
+size_t FramePool::freeBytes() const
+{
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    return state_->freeBytes;
+}
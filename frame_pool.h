@@ -0,0 +1,53 @@
+#ifndef FRAME_POOL_H
+#define FRAME_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <memory>
+
+#include <QImage>
+
+/*
+ * 输出帧缓冲区池
+ * acquire() 返回的 QImage 直接建立在池中 64 字节对齐的缓冲区上(行宽也按 64 字节对齐), 不做拷贝;
+ * 最后一个引用释放时通过 QImage 的 cleanup 回调把缓冲区还给池, 稳定运行时不再有每帧 malloc/free
+ * 空闲缓冲区的数量和总字节数有上限, 超出时先释放最早归还的, 分辨率切换后旧尺寸的缓冲区会逐渐被淘汰
+ * 池析构后仍在使用的缓冲区在释放时直接 free
+ */
+class FramePool {
+public:
+    FramePool(size_t maxFreeBuffers, size_t maxFreeBytes);
+    ~FramePool();
+
+    FramePool(const FramePool&) = delete;
+    FramePool& operator=(const FramePool&) = delete;
+
+    // 解码/显示路径共用的池
+    static FramePool& instance();
+
+    // 取一块缓冲区包装为 QImage, 池中没有同样大小的空闲缓冲区时新分配
+    QImage acquire(int width, int height, QImage::Format format);
+    // 预先分配 count 块放入空闲列表(受上限约束)
+    void preallocate(int width, int height, QImage::Format format, int count);
+    // 释放全部空闲缓冲区
+    void trim();
+
+    uint64_t hits() const;
+    uint64_t misses() const;
+    size_t freeBuffers() const;
+    size_t freeBytes() const;
+
+    // 池分配的行宽
+    static int strideFor(int width, QImage::Format format);
+
+private:
+    struct Block;
+    struct State;
+
+    static void release(void *info);
+    Block *take(size_t size, bool countStats);
+
+    std::shared_ptr<State> state_;
+};
+
+#endif // FRAME_POOL_H
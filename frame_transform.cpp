@@ -0,0 +1,253 @@
+#include "frame_transform.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "libyuv.h"
+#include "frame_pool.h"
+#include "trace.h"
+#include "thread_pool.h"
+
+namespace {
+
+// 小于该像素数的帧串行处理, 条带调度开销大于收益
+const int PARALLEL_MIN_PIXELS = 640 * 480;
+// 每个条带的最少行数
+const int MIN_STRIP_ROWS = 16;
+
+// 每个线程一份中间缓冲区, 只增不减
+struct Scratch {
+    std::vector<uint8_t> a;
+    std::vector<uint8_t> b;
+    std::vector<uint8_t> c;
+};
+
+Scratch &scratch()
+{
+    static thread_local Scratch s;
+    return s;
+}
+
+uint8_t *reserve(std::vector<uint8_t> &buf, size_t size)
+{
+    if (buf.size() < size) buf.resize(size);
+    return buf.data();
+}
+
+// I420 三个平面在一块连续内存中的布局
+struct I420Planes {
+    uint8_t *y, *u, *v;
+    int strideY, strideUV;
+};
+
+I420Planes layoutI420(std::vector<uint8_t> &buf, int width, int height)
+{
+    const int cw = (width + 1) / 2;
+    const int ch = (height + 1) / 2;
+    uint8_t *base = reserve(buf, static_cast<size_t>(width) * height + 2 * cw * ch);
+    I420Planes p;
+    p.y = base;
+    p.u = base + width * height;
+    p.v = p.u + cw * ch;
+    p.strideY = width;
+    p.strideUV = cw;
+    return p;
+}
+
+// 把 [0, rows) 切成偶数行对齐的条带并行执行 fn(r0, r1), 4:2:0 的色度行不会跨条带
+// 整个步骤的耗时按 stage 计入 trace
+template <typename Fn>
+void forStrips(TraceStage stage, ThreadPool *pool, int rows, Fn fn)
+{
+    TraceScope trace(stage);
+    const int maxStrips = pool ? pool->size() + 1 : 1;
+    const int strips = std::max(1, std::min(maxStrips, rows / MIN_STRIP_ROWS));
+    if (strips <= 1) {
+        fn(0, rows);
+        return;
+    }
+    const int step = ((rows + strips - 1) / strips + 1) & ~1;
+    pool->parallelFor(strips, [&](int i) {
+        const int r0 = i * step;
+        const int r1 = std::min(rows, r0 + step);
+        if (r0 < r1) fn(r0, r1);
+    });
+}
+
+// ARGB 行转换为输出格式, RGB32 不经过这里
+void argbToOutput(const uint8_t *src, int srcStride, uint8_t *dst, int dstStride,
+                  int width, int rows, QImage::Format format)
+{
+    if (format == QImage::Format_RGB16) {
+        libyuv::ARGBToRGB565(src, srcStride, dst, dstStride, width, rows);
+    } else {
+        // libyuv 的 RAW 内存顺序为 R,G,B, 与 QImage::Format_RGB888 一致
+        libyuv::ARGBToRAW(src, srcStride, dst, dstStride, width, rows);
+    }
+}
+
+void i420ToOutput(const uint8_t *y, int strideY, const uint8_t *u, const uint8_t *v, int strideUV,
+                  uint8_t *dst, int dstStride, int width, int rows, QImage::Format format)
+{
+    if (format == QImage::Format_RGB32) {
+        // libyuv 的 ARGB 内存顺序为 B,G,R,A(A=0xFF), 与小端的 QImage::Format_RGB32 一致
+        libyuv::I420ToARGB(y, strideY, u, strideUV, v, strideUV, dst, dstStride, width, rows);
+    } else if (format == QImage::Format_RGB16) {
+        libyuv::I420ToRGB565(y, strideY, u, strideUV, v, strideUV, dst, dstStride, width, rows);
+    } else {
+        libyuv::I420ToRAW(y, strideY, u, strideUV, v, strideUV, dst, dstStride, width, rows);
+    }
+}
+
+} // namespace
+
+bool isOutputFormatSupported(QImage::Format format)
+{
+    return format == QImage::Format_RGB888 || format == QImage::Format_RGB32
+           || format == QImage::Format_RGB16;
+}
+
+bool convertRotateScale(const FrameView &src, const QSize &box, QImage &dst,
+                        QImage::Format format, ThreadPool *pool)
+{
+    if (src.width <= 0 || src.height <= 0 || !src.data[0]) return false;
+    if (!isOutputFormatSupported(format)) return false;
+
+    // 旋转后宽高互换, 再等比适配显示区域
+    const QSize out = QSize(src.height, src.width).scaled(box, Qt::KeepAspectRatio);
+    if (out.isEmpty()) return false;
+    const int outW = out.width();
+    const int outH = out.height();
+    // 旋转前的目标尺寸
+    const int preW = outH;
+    const int preH = outW;
+
+    if (dst.width() != outW || dst.height() != outH || dst.format() != format) {
+        dst = FramePool::instance().acquire(outW, outH, format);
+    }
+    Scratch &s = scratch();
+    // 中间缓冲区属于调用线程, 各条带只写互不重叠的区域
+    ThreadPool *strips = src.width * src.height >= PARALLEL_MIN_PIXELS ? pool : nullptr;
+    // bits() 会 detach, 只在调用线程取一次, 各条带只使用取到的指针
+    uint8_t *dstBits = dst.bits();
+    const int dstStride = dst.bytesPerLine();
+
+    if (src.format == SourceFormat::ARGB) {
+        uint8_t *scaled = reserve(s.a, static_cast<size_t>(preW) * preH * 4);
+        // 各条带按整帧的比例缩放, 只写自己的目标行, 结果与不分条带时逐字节相同
+        forStrips(TraceStage::Scale, strips, preH, [&](int d0, int d1) {
+            libyuv::ARGBScaleClip(src.data[0], src.stride[0], src.width, src.height,
+                                  scaled, preW * 4, preW, preH, 0, d0, preW, d1 - d0, libyuv::kFilterBox);
+        });
+        // 旋转 270 度: 源图第 r 行变为目标图第 r 列
+        // 输出为 RGB32 时直接旋转进 dst, 省去一次整帧转换
+        const bool direct = format == QImage::Format_RGB32;
+        uint8_t *rotated = direct ? dstBits : reserve(s.b, static_cast<size_t>(outW) * outH * 4);
+        const int rotatedStride = direct ? dstStride : outW * 4;
+        forStrips(TraceStage::Rotate, strips, preH, [&](int r0, int r1) {
+            libyuv::ARGBRotate(scaled + static_cast<size_t>(r0) * preW * 4, preW * 4,
+                               rotated + r0 * 4, rotatedStride, preW, r1 - r0, libyuv::kRotate270);
+        });
+        if (direct) return true;
+        forStrips(TraceStage::Convert, strips, outH, [&](int r0, int r1) {
+            argbToOutput(rotated + static_cast<size_t>(r0) * rotatedStride, rotatedStride,
+                         dstBits + static_cast<size_t>(r0) * dstStride, dstStride,
+                         outW, r1 - r0, format);
+        });
+        return true;
+    }
+
+    // YUV 输入先统一为 I420
+    FrameView i420 = src;
+    if (src.format != SourceFormat::I420 && !convertToI420(src, s.a, i420, pool)) return false;
+
+    // Y/U/V 三个平面各自整帧缩放(与 I420Scale 的做法相同), 并行时结果与串行逐字节相同
+    I420Planes scaled = layoutI420(s.b, preW, preH);
+    {
+        TraceScope trace(TraceStage::Scale);
+        uint8_t *const planes[3] = {scaled.y, scaled.u, scaled.v};
+        const auto scalePlane = [&](int plane) {
+            const int sub = plane == 0 ? 0 : 1;
+            libyuv::ScalePlane(i420.data[plane], i420.stride[plane],
+                               (src.width + sub) >> sub, (src.height + sub) >> sub,
+                               planes[plane], plane == 0 ? scaled.strideY : scaled.strideUV,
+                               (preW + sub) >> sub, (preH + sub) >> sub, libyuv::kFilterBox);
+        };
+        if (strips) {
+            strips->parallelFor(3, scalePlane);
+        } else {
+            for (int plane = 0; plane < 3; plane++) scalePlane(plane);
+        }
+    }
+
+    // 旋转 270 度: 源图第 r 行变为目标图第 r 列
+    I420Planes rotated = layoutI420(s.c, outW, outH);
+    forStrips(TraceStage::Rotate, strips, preH, [&](int r0, int r1) {
+        const size_t c0 = static_cast<size_t>(r0 / 2);
+        libyuv::I420Rotate(scaled.y + static_cast<size_t>(r0) * scaled.strideY, scaled.strideY,
+                           scaled.u + c0 * scaled.strideUV, scaled.strideUV,
+                           scaled.v + c0 * scaled.strideUV, scaled.strideUV,
+                           rotated.y + r0, rotated.strideY,
+                           rotated.u + c0, rotated.strideUV,
+                           rotated.v + c0, rotated.strideUV,
+                           preW, r1 - r0, libyuv::kRotate270);
+    });
+
+    forStrips(TraceStage::Convert, strips, outH, [&](int r0, int r1) {
+        const size_t c0 = static_cast<size_t>(r0 / 2);
+        i420ToOutput(rotated.y + static_cast<size_t>(r0) * rotated.strideY, rotated.strideY,
+                     rotated.u + c0 * rotated.strideUV, rotated.v + c0 * rotated.strideUV, rotated.strideUV,
+                     dstBits + static_cast<size_t>(r0) * dstStride, dstStride,
+                     outW, r1 - r0, format);
+    });
+    return true;
+}
+
+bool convertToI420(const FrameView &src, std::vector<uint8_t> &buf, FrameView &out, ThreadPool *pool)
+{
+    if (src.width <= 0 || src.height <= 0 || !src.data[0]) return false;
+    if (src.format != SourceFormat::YUYV && src.format != SourceFormat::NV12) return false;
+    if (src.format == SourceFormat::NV12 && !src.data[1]) return false;
+
+    ThreadPool *strips = src.width * src.height >= PARALLEL_MIN_PIXELS ? pool : nullptr;
+    I420Planes full = layoutI420(buf, src.width, src.height);
+    forStrips(TraceStage::Convert, strips, src.height, [&](int r0, int r1) {
+        const size_t c0 = static_cast<size_t>(r0 / 2);
+        uint8_t *y = full.y + static_cast<size_t>(r0) * full.strideY;
+        uint8_t *u = full.u + c0 * full.strideUV;
+        uint8_t *v = full.v + c0 * full.strideUV;
+        if (src.format == SourceFormat::YUYV) {
+            libyuv::YUY2ToI420(src.data[0] + static_cast<size_t>(r0) * src.stride[0], src.stride[0],
+                               y, full.strideY, u, full.strideUV, v, full.strideUV,
+                               src.width, r1 - r0);
+        } else {
+            libyuv::NV12ToI420(src.data[0] + static_cast<size_t>(r0) * src.stride[0], src.stride[0],
+                               src.data[1] + c0 * src.stride[1], src.stride[1],
+                               y, full.strideY, u, full.strideUV, v, full.strideUV,
+                               src.width, r1 - r0);
+        }
+    });
+
+    out.format = SourceFormat::I420;
+    out.width = src.width;
+    out.height = src.height;
+    out.data[0] = full.y;
+    out.data[1] = full.u;
+    out.data[2] = full.v;
+    out.stride[0] = full.strideY;
+    out.stride[1] = full.strideUV;
+    out.stride[2] = full.strideUV;
+    return true;
+}
+
+void yuyvToRgb888(const uint8_t *src, int srcStride, uint8_t *dst, int dstStride, int width, int height)
+{
+    const int STRIP_ROWS = 8;
+    static thread_local std::vector<uint8_t> strip;
+    uint8_t *argb = reserve(strip, static_cast<size_t>(width) * 4 * STRIP_ROWS);
+    for (int y = 0; y < height; y += STRIP_ROWS) {
+        const int rows = std::min(STRIP_ROWS, height - y);
+        libyuv::YUY2ToARGB(src + static_cast<size_t>(y) * srcStride, srcStride, argb, width * 4, width, rows);
+        libyuv::ARGBToRAW(argb, width * 4, dst + static_cast<size_t>(y) * dstStride, dstStride, width, rows);
+    }
+}
@@ -0,0 +1,55 @@
+#ifndef FRAME_TRANSFORM_H
+#define FRAME_TRANSFORM_H
+
+#include <stdint.h>
+
+#include <vector>
+
+#include <QImage>
+#include <QSize>
+
+class ThreadPool;
+
+// 输入帧的像素格式
+enum class SourceFormat {
+    YUYV,   // 打包 YUV422
+    NV12,   // Y 平面 + UV 交错平面
+    I420,   // Y/U/V 三个平面
+    ARGB    // libyuv ARGB(内存顺序 B,G,R,A), 即 QImage::Format_RGB32, 用于 MJPG 解码结果
+};
+
+// 输入帧描述, 不持有数据
+struct FrameView {
+    SourceFormat format;
+    int width;
+    int height;
+    const uint8_t *data[3];     // NV12 为 Y/UV, I420 为 Y/U/V, 其他格式只用 data[0]
+    int stride[3];
+};
+
+/*
+ * 显示路径的合并处理: 颜色转换 + 旋转 270 度 + 等比缩放
+ * 输出尺寸为旋转后的图像等比适配 box 的大小, dst 尺寸/格式一致时复用其缓冲区, 否则从 FramePool 取
+ * format 为输出格式, 应与屏幕一致以免 Qt 绘制时再转换一遍(见 isOutputFormatSupported)
+ * 先在旋转前缩放, 旋转只作用于缩小后的小图; 中间缓冲区按线程复用, 不产生每帧分配
+ * pool 非空且帧足够大时, 每一步按水平条带(I420 缩放按平面)分给线程池并行处理, 结果与串行处理逐字节相同
+ */
+bool convertRotateScale(const FrameView &src, const QSize &box, QImage &dst,
+                        QImage::Format format = QImage::Format_RGB888, ThreadPool *pool = nullptr);
+
+// 支持的输出格式: Format_RGB888(libyuv RAW), Format_RGB32(libyuv ARGB), Format_RGB16(libyuv RGB565)
+bool isOutputFormatSupported(QImage::Format format);
+
+/*
+ * YUYV/NV12 转换为 I420, 三个平面连续存放在 buf 中(按需扩容, 不缩小), out 指向 buf
+ * 流水线中解码阶段用它把帧从驱动缓冲区转出, 旋转缩放阶段再以 out 调用 convertRotateScale
+ */
+bool convertToI420(const FrameView &src, std::vector<uint8_t> &buf, FrameView &out, ThreadPool *pool = nullptr);
+
+/*
+ * YUYV 转换为 RGB888(内存顺序 R,G,B, 与 QImage::Format_RGB888 一致), 全分辨率拍照路径使用
+ * 按行条带: YUY2 -> ARGB(每线程的条带缓冲区, 留在缓存中) -> RAW, 不分配整帧中间缓冲区
+ */
+void yuyvToRgb888(const uint8_t *src, int srcStride, uint8_t *dst, int dstStride, int width, int height);
+
+#endif // FRAME_TRANSFORM_H
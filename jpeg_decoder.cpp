@@ -0,0 +1,109 @@
+#include "jpeg_decoder.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <QDebug>
+
+#include "frame_pool.h"
+
+JpegDecoder::JpegDecoder()
+{
+    handle_ = tjInitDecompress();
+    if (!handle_) {
+        qWarning() << "Failed to initialize TurboJPEG decompressor";
+    }
+}
+
+JpegDecoder::~JpegDecoder()
+{
+    if (handle_) {
+        tjDestroy(handle_);
+        handle_ = nullptr;
+    }
+}
+
+JpegDecoder& JpegDecoder::forThread()
+{
+    static thread_local JpegDecoder decoder;
+    return decoder;
+}
+
+// 保持宽高比缩放到 fitSize 内所需的比例为 s, 选 1/8, 1/4, 1/2 中不小于 s 的最小因子
+int JpegDecoder::pickScaleDenom(int width, int height, const QSize &fitSize)
+{
+    if (fitSize.isEmpty() || width <= 0 || height <= 0) return 1;
+
+    const double s = std::min(static_cast<double>(fitSize.width()) / width,
+                              static_cast<double>(fitSize.height()) / height);
+    if (s >= 1.0) return 1;
+
+    static const int denoms[] = {8, 4, 2};
+    int count = 0;
+    const tjscalingfactor *factors = tjGetScalingFactors(&count);
+    for (int denom : denoms) {
+        // 确认库支持该缩放因子
+        bool supported = false;
+        for (int i = 0; i < count; i++) {
+            if (factors[i].num * denom == factors[i].denom) {
+                supported = true;
+                break;
+            }
+        }
+        if (!supported) continue;
+        const int sw = (width + denom - 1) / denom;
+        const int sh = (height + denom - 1) / denom;
+        if (sw >= std::ceil(width * s - 1e-6) && sh >= std::ceil(height * s - 1e-6)) {
+            return denom;
+        }
+    }
+    return 1;
+}
+
+bool JpegDecoder::decode(const void *data, size_t length, QImage &image, const QSize &fitSize,
+                         QImage::Format format)
+{
+    if (!handle_) return false;
+    int pixelFormat;
+    if (format == QImage::Format_RGB888) {
+        pixelFormat = TJPF_RGB;
+    } else if (format == QImage::Format_RGB32) {
+        pixelFormat = TJPF_BGRX;    // 小端下 RGB32 的内存顺序为 B,G,R,X
+    } else {
+        qWarning() << "Unsupported decode format" << format;
+        return false;
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    unsigned char *src = static_cast<unsigned char*>(const_cast<void*>(data));
+    int width, height, subsamp, colorspace;
+    if (tjDecompressHeader3(handle_, src, length, &width, &height, &subsamp, &colorspace) != 0) {
+        qWarning() << "Failed to read MJPEG header:" << tjGetErrorStr();
+        return false;
+    }
+
+    lastDenom_ = pickScaleDenom(width, height, fitSize);
+    if (lastDenom_ > 1) {
+        tjscalingfactor factor = {1, lastDenom_};
+        width = TJSCALED(width, factor);
+        height = TJSCALED(height, factor);
+    }
+
+    // 尺寸或格式不符时才从缓冲区池重新取
+    if (image.width() != width || image.height() != height
+        || image.format() != format) {
+        image = FramePool::instance().acquire(width, height, format);
+    }
+    if (tjDecompress2(handle_, src, length, image.bits(), width, image.bytesPerLine(), height,
+                      pixelFormat, TJFLAG_FASTDCT) != 0) {
+        qWarning() << "Failed to decompress MJPEG frame:" << tjGetErrorStr();
+        return false;
+    }
+
+    lastUs_ = std::chrono::duration_cast<std::chrono::microseconds>(
+                  std::chrono::steady_clock::now() - start).count();
+    totalUs_ += lastUs_;
+    frames_++;
+    return true;
+}
@@ -0,0 +1,53 @@
+#ifndef JPEG_DECODER_H
+#define JPEG_DECODER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <QImage>
+#include <QSize>
+
+#include <turbojpeg.h>
+
+/*
+ * TurboJPEG 解码上下文
+ * tjhandle 只在创建时初始化一次, 每个线程通过 forThread() 持有一份, 避免每帧 tjInitDecompress/tjDestroy
+ * 解码结果直接写入调用者提供的 QImage, 尺寸/格式一致时复用其缓冲区, 否则从 FramePool 取
+ */
+class JpegDecoder {
+public:
+    JpegDecoder();
+    ~JpegDecoder();
+
+    JpegDecoder(const JpegDecoder&) = delete;
+    JpegDecoder& operator=(const JpegDecoder&) = delete;
+
+    // 当前线程的解码器
+    static JpegDecoder& forThread();
+
+    // 解码到 image, 失败返回 false
+    // fitSize 非空时选用能覆盖 fitSize(保持宽高比)的最小缩放因子(1/2, 1/4, 1/8), 在解码阶段直接缩小
+    // format 支持 Format_RGB888 和 Format_RGB32(内存顺序 BGRX, 即 libyuv 的 ARGB)
+    bool decode(const void *data, size_t length, QImage &image, const QSize &fitSize = QSize(),
+                QImage::Format format = QImage::Format_RGB888);
+
+    // 选出的缩放分母(1 表示全分辨率)
+    int lastScaleDenom() const { return lastDenom_; }
+
+    static int pickScaleDenom(int width, int height, const QSize &fitSize);
+
+    // 耗时统计(微秒)
+    int64_t lastDecodeUs() const { return lastUs_; }
+    int64_t avgDecodeUs() const { return frames_ ? totalUs_ / frames_ : 0; }
+    uint64_t decodedFrames() const { return frames_; }
+    void resetStats() { lastUs_ = 0; totalUs_ = 0; frames_ = 0; }
+
+private:
+    tjhandle handle_ = nullptr;
+    int lastDenom_ = 1;
+    int64_t lastUs_ = 0;
+    int64_t totalUs_ = 0;
+    uint64_t frames_ = 0;
+};
+
+#endif // JPEG_DECODER_H
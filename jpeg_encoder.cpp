@@ -0,0 +1,94 @@
+#include "jpeg_encoder.h"
+
+#include <chrono>
+#include <QDebug>
+
+JpegEncoder::JpegEncoder()
+{
+    handle_ = tjInitCompress();
+    if (!handle_) {
+        qWarning() << "Failed to initialize TurboJPEG compressor";
+    }
+}
+
+JpegEncoder::~JpegEncoder()
+{
+    if (buf_) {
+        tjFree(buf_);
+        buf_ = nullptr;
+    }
+    if (handle_) {
+        tjDestroy(handle_);
+        handle_ = nullptr;
+    }
+}
+
+JpegEncoder& JpegEncoder::forThread()
+{
+    static thread_local JpegEncoder encoder;
+    return encoder;
+}
+
+// 输出缓冲区不够大时按该尺寸的最坏情况重新分配
+unsigned char *JpegEncoder::reserve(int width, int height, int subsamp)
+{
+    const unsigned long need = tjBufSize(width, height, subsamp);
+    if (need == static_cast<unsigned long>(-1)) return nullptr;
+    if (bufSize_ < need) {
+        if (buf_) tjFree(buf_);
+        buf_ = tjAlloc(static_cast<int>(need));
+        bufSize_ = buf_ ? need : 0;
+    }
+    return buf_;
+}
+
+void JpegEncoder::finish(std::chrono::steady_clock::time_point start, unsigned long size,
+                         std::vector<uint8_t> &out)
+{
+    out.assign(buf_, buf_ + size);
+    lastUs_ = std::chrono::duration_cast<std::chrono::microseconds>(
+                  std::chrono::steady_clock::now() - start).count();
+    totalUs_ += lastUs_;
+    frames_++;
+}
+
+bool JpegEncoder::encode(const QImage &image, int quality, std::vector<uint8_t> &out)
+{
+    if (!handle_ || image.isNull()) return false;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    QImage src = image;
+    int pixelFormat = TJPF_RGB;
+    if (src.format() == QImage::Format_RGB32 || src.format() == QImage::Format_ARGB32) {
+        pixelFormat = TJPF_BGRX;    // 小端下 RGB32 的内存顺序为 B,G,R,X
+    } else if (src.format() != QImage::Format_RGB888) {
+        src = src.convertToFormat(QImage::Format_RGB888);
+    }
+
+    unsigned char *dst = reserve(src.width(), src.height(), TJSAMP_420);
+    if (!dst) return false;
+    unsigned long size = bufSize_;
+    if (tjCompress2(handle_, src.constBits(), src.width(), src.bytesPerLine(), src.height(), pixelFormat,
+                    &dst, &size, TJSAMP_420, quality, TJFLAG_FASTDCT | TJFLAG_NOREALLOC) != 0) {
+        qWarning() << "Failed to encode JPEG:" << tjGetErrorStr();
+        return false;
+    }
+    finish(start, size, out);
+    return true;
+}
+
+bool JpegEncoder::encodeI420(const FrameView &src, int quality, std::vector<uint8_t> &out)
+{
+    if (!handle_ || src.format != SourceFormat::I420 || !src.data[0]) return false;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    unsigned char *dst = reserve(src.width, src.height, TJSAMP_420);
+    if (!dst) return false;
+    unsigned long size = bufSize_;
+    const unsigned char *planes[3] = {src.data[0], src.data[1], src.data[2]};
+    if (tjCompressFromYUVPlanes(handle_, planes, src.width, src.stride, src.height, TJSAMP_420,
+                                &dst, &size, quality, TJFLAG_FASTDCT | TJFLAG_NOREALLOC) != 0) {
+        qWarning() << "Failed to encode JPEG:" << tjGetErrorStr();
+        return false;
+    }
+    finish(start, size, out);
+    return true;
+}
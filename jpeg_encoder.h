@@ -0,0 +1,53 @@
+#ifndef JPEG_ENCODER_H
+#define JPEG_ENCODER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <chrono>
+#include <vector>
+
+#include <QImage>
+
+#include <turbojpeg.h>
+
+#include "frame_transform.h"
+
+/*
+ * TurboJPEG 编码上下文
+ * 与 JpegDecoder 一样 tjhandle 只创建一次, 每个线程通过 forThread() 持有一份
+ * 输出缓冲区按最大可能大小(tjBufSize)预先分配并复用(TJFLAG_NOREALLOC), 每帧只拷贝一次结果
+ */
+class JpegEncoder {
+public:
+    JpegEncoder();
+    ~JpegEncoder();
+
+    JpegEncoder(const JpegEncoder&) = delete;
+    JpegEncoder& operator=(const JpegEncoder&) = delete;
+
+    // 当前线程的编码器
+    static JpegEncoder& forThread();
+
+    // 编码 QImage, 支持 Format_RGB888 和 Format_RGB32(BGRX), 其余格式先转换为 RGB888
+    bool encode(const QImage &image, int quality, std::vector<uint8_t> &out);
+    // 编码 I420 平面(SourceFormat::I420), 不经过 RGB, 色度直接使用 4:2:0
+    bool encodeI420(const FrameView &src, int quality, std::vector<uint8_t> &out);
+
+    // 耗时统计(微秒)
+    int64_t lastEncodeUs() const { return lastUs_; }
+    int64_t avgEncodeUs() const { return frames_ ? totalUs_ / frames_ : 0; }
+    uint64_t encodedFrames() const { return frames_; }
+
+private:
+    unsigned char *reserve(int width, int height, int subsamp);
+    void finish(std::chrono::steady_clock::time_point start, unsigned long size, std::vector<uint8_t> &out);
+
+    tjhandle handle_ = nullptr;
+    unsigned char *buf_ = nullptr;
+    unsigned long bufSize_ = 0;
+    int64_t lastUs_ = 0;
+    int64_t totalUs_ = 0;
+    uint64_t frames_ = 0;
+};
+
+#endif // JPEG_ENCODER_H
@@ -0,0 +1,136 @@
+#include "jpeg_still.h"
+
+#include <cstring>
+#include <QDebug>
+
+namespace {
+
+// JPEG 标准附录 K.3 的默认霍夫曼表: DC 亮度/色度, AC 亮度/色度, 共一个 DHT 段
+const uint8_t defaultDht[] = {
+    0xFF, 0xC4, 0x01, 0xA2,
+    // DC 亮度
+    0x00,
+    0x00, 0x01, 0x05, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B,
+    // DC 色度
+    0x01,
+    0x00, 0x03, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B,
+    // AC 亮度
+    0x10,
+    0x00, 0x02, 0x01, 0x03, 0x03, 0x02, 0x04, 0x03, 0x05, 0x05, 0x04, 0x04, 0x00, 0x00, 0x01, 0x7D,
+    0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+    0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xA1, 0x08, 0x23, 0x42, 0xB1, 0xC1, 0x15, 0x52, 0xD1, 0xF0,
+    0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0A, 0x16, 0x17, 0x18, 0x19, 0x1A, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2A, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+    0x4A, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+    0x6A, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+    0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0xA2, 0xA3, 0xA4, 0xA5, 0xA6, 0xA7,
+    0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3, 0xC4, 0xC5,
+    0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA, 0xE1, 0xE2,
+    0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xF1, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8,
+    0xF9, 0xFA,
+    // AC 色度
+    0x11,
+    0x00, 0x02, 0x01, 0x02, 0x04, 0x04, 0x03, 0x04, 0x07, 0x05, 0x04, 0x04, 0x00, 0x01, 0x02, 0x77,
+    0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+    0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xA1, 0xB1, 0xC1, 0x09, 0x23, 0x33, 0x52, 0xF0,
+    0x15, 0x62, 0x72, 0xD1, 0x0A, 0x16, 0x24, 0x34, 0xE1, 0x25, 0xF1, 0x17, 0x18, 0x19, 0x1A, 0x26,
+    0x27, 0x28, 0x29, 0x2A, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+    0x49, 0x4A, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+    0x69, 0x6A, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+    0x88, 0x89, 0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0xA2, 0xA3, 0xA4, 0xA5,
+    0xA6, 0xA7, 0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3,
+    0xC4, 0xC5, 0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA,
+    0xE2, 0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8,
+    0xF9, 0xFA
+};
+
+// 按段遍历到 SOS(扫描数据开始), 返回其偏移, 同时检查之前是否出现过 DHT; 格式错误返回 0
+size_t findScanStart(const uint8_t *data, size_t length, bool &hasDht)
+{
+    hasDht = false;
+    if (length < 4 || data[0] != 0xFF || data[1] != 0xD8) return 0;
+    size_t pos = 2;
+    while (pos + 4 <= length) {
+        if (data[pos] != 0xFF) return 0;
+        const uint8_t marker = data[pos + 1];
+        if (marker == 0xFF) {       // 段之间的填充字节
+            pos++;
+            continue;
+        }
+        if (marker == 0xDA) return pos;
+        if (marker == 0xC4) hasDht = true;
+        // TEM 和 RSTn 没有长度字段
+        if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7)) {
+            pos += 2;
+            continue;
+        }
+        const size_t segment = (static_cast<size_t>(data[pos + 2]) << 8) | data[pos + 3];
+        if (segment < 2) return 0;
+        pos += 2 + segment;
+    }
+    return 0;
+}
+
+} // namespace
+
+bool completeMjpegFrame(const uint8_t *data, size_t length, std::vector<uint8_t> &out)
+{
+    bool hasDht = false;
+    const size_t sos = findScanStart(data, length, hasDht);
+    if (sos == 0) return false;
+    if (hasDht) {
+        out.assign(data, data + length);
+        return true;
+    }
+    // DHT 插在 SOS 之前, 其余字节不变
+    out.clear();
+    out.reserve(length + sizeof(defaultDht));
+    out.insert(out.end(), data, data + sos);
+    out.insert(out.end(), defaultDht, defaultDht + sizeof(defaultDht));
+    out.insert(out.end(), data + sos, data + length);
+    return true;
+}
+
+JpegTransformer::JpegTransformer()
+{
+    handle_ = tjInitTransform();
+    if (!handle_) {
+        qWarning() << "Failed to initialize TurboJPEG transformer";
+    }
+}
+
+JpegTransformer::~JpegTransformer()
+{
+    if (handle_) {
+        tjDestroy(handle_);
+        handle_ = nullptr;
+    }
+}
+
+JpegTransformer& JpegTransformer::forThread()
+{
+    static thread_local JpegTransformer transformer;
+    return transformer;
+}
+
+bool JpegTransformer::rotate270(const uint8_t *data, size_t length, std::vector<uint8_t> &out)
+{
+    if (!handle_) return false;
+    tjtransform xform;
+    memset(&xform, 0, sizeof(xform));
+    xform.op = TJXOP_ROT270;
+    xform.options = TJXOPT_TRIM;
+
+    unsigned char *dst = nullptr;
+    unsigned long dstSize = 0;
+    if (tjTransform(handle_, data, length, 1, &dst, &dstSize, &xform, 0) != 0) {
+        qWarning() << "Failed to rotate JPEG:" << tjGetErrorStr();
+        tjFree(dst);
+        return false;
+    }
+    out.assign(dst, dst + dstSize);
+    tjFree(dst);
+    return true;
+}
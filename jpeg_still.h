@@ -0,0 +1,40 @@
+#ifndef JPEG_STILL_H
+#define JPEG_STILL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include <turbojpeg.h>
+
+/*
+ * MJPG 拍照直通: 保存摄像头输出的 JPEG 数据, 不解码也不重新编码
+ * 很多 UVC 摄像头的 MJPG 帧省略 DHT(霍夫曼表), 约定使用 JPEG 标准附录 K 的默认表, 单独保存为文件前需补上
+ */
+
+// 检查是否为 JPEG 并补全霍夫曼表, 结果写入 out; 已有 DHT 时原样复制, 数据不完整返回 false
+bool completeMjpegFrame(const uint8_t *data, size_t length, std::vector<uint8_t> &out);
+
+/*
+ * TurboJPEG 无损变换上下文, 在 DCT 域旋转, 不解码像素
+ * 与 JpegDecoder 一样每个线程通过 forThread() 持有一份 tjhandle
+ */
+class JpegTransformer {
+public:
+    JpegTransformer();
+    ~JpegTransformer();
+
+    JpegTransformer(const JpegTransformer&) = delete;
+    JpegTransformer& operator=(const JpegTransformer&) = delete;
+
+    static JpegTransformer& forThread();
+
+    // 与预览一致旋转 270 度(逆时针 90 度), 结果写入 out, 失败返回 false
+    // 图像尺寸不是 MCU 整数倍时裁掉边缘不完整的 MCU(TJXOPT_TRIM), 这是无损旋转的限制
+    bool rotate270(const uint8_t *data, size_t length, std::vector<uint8_t> &out);
+
+private:
+    tjhandle handle_ = nullptr;
+};
+
+#endif // JPEG_STILL_H
@@ -1,6 +1,9 @@
 #include "mainwindow.h"
 
 #include <QApplication>
+#include <cstring>
+
+#include "pipeline_bench.h"
 
 #ifdef RV1126
 #include <iostream>
@@ -49,6 +52,14 @@ void startService(const std::string& serviceName) {
 
 int main(int argc, char *argv[])
 {
+	// 性能测试模式: 不打开摄像头和界面, 参数见 pipeline_bench.h
+	if (argc > 1 && strcmp(argv[1], "--bench") == 0) {
+		// 没有屏幕时使用离屏平台
+		if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) qputenv("QT_QPA_PLATFORM", "offscreen");
+		QApplication bench(argc, argv);
+		return runPipelineBench(argc, argv);
+	}
+
 	#ifdef RV1126
 	
 	std::string serviceName = "ispserver"; // 替换为你的服务名
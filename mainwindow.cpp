@@ -1,12 +1,13 @@
 ﻿#include "mainwindow.h"
 #include "albumwindow.h"
 #include "./ui_mainwindow.h"
+#include "trace.h"
+#include <QDateTime>
 #include <QDir>
+#include <QKeyEvent>
 #include <QString>
 #include <QDebug>
 #include <QMessageBox>
-#include <QDateTime>
-#include <QImageWriter>
 #include <QScreen>
 
 #include <sys/stat.h>
@@ -34,6 +35,18 @@ MainWindow::MainWindow(QWidget *parent)
     // UI基础图标初始化
 	ui->takepic->setIconSize(QSize(40, 40)); // 设置图标大小
 	ui->takepic->setIcon(QIcon(":/icon/icon/takepic_1.svg")); // 设置SVG图标
+    // 照片在后台编码保存, 完成后用内存中的缩略图更新相册按钮
+    photoWriter = std::unique_ptr<PhotoWriter>(
+        new PhotoWriter(QCoreApplication::applicationDirPath() + "/photos/"));
+    photoWriter->setThumbnailSize(ui->showimg->size());
+    connect(photoWriter.get(), &PhotoWriter::photoSaved,
+            this, &MainWindow::photoSaved, Qt::QueuedConnection);
+    // 性能埋点: F9 或 kill -USR1 <pid> 把最近几秒的处理过程写成 trace JSON
+    const QString traceDir = QCoreApplication::applicationDirPath() + "/trace";
+    QDir().mkpath(traceDir);
+    Tracer::instance().setDumpDirectory(traceDir.toLocal8Bit().toStdString());
+    Tracer::instance().installSignalHandler();
+    Tracer::setThreadName("ui");
 
     // 获取主屏幕
     QScreen *screen = QGuiApplication::primaryScreen();
@@ -43,7 +56,7 @@ MainWindow::MainWindow(QWidget *parent)
     }
 
     ui->Display->setSizePolicy(QSizePolicy::Ignored, QSizePolicy::Ignored);
-    ui->Display->setAlignment(Qt::AlignCenter);  // 图像居中显示
+    ui->Display->setPlaceholderText("VIDEO EMPTY");  // 未打开摄像头时居中显示
     // 更新相册按钮
     QString fileName = findOldestImage(QCoreApplication::applicationDirPath() + "/photos/");
     setIcon(fileName);
@@ -51,11 +64,7 @@ MainWindow::MainWindow(QWidget *parent)
 	devicesComboBox = ui->devices;
 	pixFormatComboBox = ui->pixformat;
 	resolutionsComboBox = ui->resolutions;
-    displayLabel = ui->Display;
-    // 创建QTimer对象
-    timer = new QTimer(this);
-    // 设置定时器的超时时间为33毫秒
-    timer->setInterval(66);
+    previewWidget = ui->Display;
     // 更新设备信息
 	fillComboBoxWithV4L2Devices();
 
@@ -269,8 +278,10 @@ void MainWindow::fillComboBoxWithResolutions(int a) {
 void MainWindow::on_open_pb_released()
 {   
     killThread();
+    ui->record_pb->setText("Rec");
+    ui->record_pb->setEnabled(true);
     // 创建新的 Vvideo 对象
-    m_captureThread = std::unique_ptr<Vvideo>(new Vvideo(global_M, displayLabel));
+    m_captureThread = std::unique_ptr<Vvideo>(new Vvideo(global_M, previewWidget));
 
     // 初始化V4L2设备
     if (m_captureThread->openDevice(devicesComboBox->currentText()) < 0) {
@@ -289,18 +300,87 @@ void MainWindow::on_open_pb_released()
         return;
     }
     
+    // 设置了 QC_EXPORT_SOCKET 时把每帧导出给外部进程(dmabuf/memfd)
+    const QByteArray exportSocket = qgetenv("QC_EXPORT_SOCKET");
+    if (!exportSocket.isEmpty() && !m_captureThread->enableFrameExport(exportSocket.toStdString())) {
+        qDebug() << "Frame export disabled";
+    }
+
     // 初始化缓冲区
     if (m_captureThread->initBuffers() < 0) {
         QMessageBox::critical(this, "error", "initial map failed.");
         return;
     }
     
+    // 有新帧时由处理线程通知 UI 线程显示, 不再定时轮询
+    connect(m_captureThread.get(), &Vvideo::frameReady,
+            m_captureThread.get(), &Vvideo::updateImage, Qt::QueuedConnection);
+    connect(m_captureThread.get(), &Vvideo::stillReady,
+            this, &MainWindow::saveStill, Qt::QueuedConnection);
+    connect(m_captureThread.get(), &Vvideo::recordingFinished,
+            this, &MainWindow::recordingFinished, Qt::QueuedConnection);
+    // 照片交给后台保存; MJPG 直接保存摄像头输出的 JPEG, 不解码也不重新编码
+    m_captureThread->setPhotoWriter(photoWriter.get());
+    m_captureThread->setJpegPassthrough(true);
+    // 连拍: QC_BURST=快门前帧数,快门起帧数[,内存上限MB], 如 QC_BURST=5,5; 未设置时单张
+    const QByteArray burst = qgetenv("QC_BURST");
+    if (!burst.isEmpty()) {
+        const QList<QByteArray> parts = burst.split(',');
+        bool preOk = false, postOk = false, budgetOk = true;
+        const int pre = parts.value(0).toInt(&preOk);
+        const int post = parts.value(1).toInt(&postOk);
+        const int budgetMb = parts.size() > 2 ? parts.at(2).toInt(&budgetOk) : int(DEFAULT_BURST_BUDGET >> 20);
+        if (preOk && postOk && budgetOk && budgetMb > 0) {
+            m_captureThread->setBurst(pre, post, static_cast<size_t>(budgetMb) << 20);
+        } else {
+            qDebug() << "Invalid QC_BURST" << burst << ", expected pre,post[,MB]";
+        }
+    }
     // 开始视频流
     threadHandle = std::thread(&Vvideo::run, m_captureThread.get());
-    // 连接定时器的timeout信号到up()槽函数
-    connect(timer, &QTimer::timeout, m_captureThread.get(), &Vvideo::updateImage);
-    // 启动定时器
-    timer->start();
+}
+// 录像开关: MJPG 直接写入摄像头输出的 JPEG, 其他格式在后台编码, 写盘在录像线程中进行
+void MainWindow::on_record_pb_released()
+{
+    if(!m_captureThread){ //检查线程是否启用
+        qDebug() << "Failed to record: Thread not working.";
+        return;
+    }
+    if (m_captureThread->isRecording()) {
+        // 剩余帧和索引在写入线程中写完, 收尾完成前不能开始新的录像
+        m_captureThread->stopRecording();
+        ui->record_pb->setText("Saving");
+        ui->record_pb->setEnabled(false);
+        return;
+    }
+    const QString dir = QCoreApplication::applicationDirPath() + "/videos/";
+    if (!QDir().mkpath(dir)) {
+        qDebug() << "Failed to create video directory" << dir;
+    }
+    const QString fileName = dir + QDateTime::currentDateTime().toString("yyyyMMddhhmmss") + ".avi";
+    if (!m_captureThread->startRecording(fileName)) {
+        QMessageBox::critical(this, "error", "Start recording failed.");
+        return;
+    }
+    ui->record_pb->setText("Stop");
+}
+// 录像文件收尾完成
+void MainWindow::recordingFinished(const QString &fileName, bool ok)
+{
+    ui->record_pb->setText("Rec");
+    ui->record_pb->setEnabled(true);
+    if (!ok) {
+        QMessageBox::warning(this, "warning", "Recording was not fully written: " + fileName);
+    }
+}
+// F9: 写出 trace
+void MainWindow::keyPressEvent(QKeyEvent *event)
+{
+    if (event->key() == Qt::Key_F9) {
+        Tracer::instance().requestDump();
+        return;
+    }
+    QWidget::keyPressEvent(event);
 }
 // 美化UI用(按钮图标更新)
 void MainWindow::on_takepic_pressed()
@@ -315,38 +395,18 @@ void MainWindow::on_takepic_released()
         qDebug() << "Failed to save image: Thread not working.";
         return;
     }
-    QImage img;
-    m_captureThread->takePic(img);
+    // 全分辨率解码和保存都在后台完成, 结果由 photoSaved 送回, 不阻塞 UI
+    m_captureThread->requestStill();
+}
+// 拍照线程没有交给 PhotoWriter 的照片: 解码失败、请求被丢弃或保存队列已满
+void MainWindow::saveStill(const QImage &img, qint64 captureUs)
+{
+    Q_UNUSED(captureUs);
     if (img.isNull()){
         qDebug() << "QImage is null.";
         return;
     }
-    // 获取当前时间
-    QDateTime currentDateTime = QDateTime::currentDateTime();
-    // 获取当前的时间戳（精确到毫秒）
-    QString dateTimeString = currentDateTime.toString("yyyyMMddhhmmsszzz");  // 添加毫秒（zzz）
-    QString path = QCoreApplication::applicationDirPath() + "/photos/";
-    // 创建文件名
-    QString fileName = path + dateTimeString + ".png";
-
-    QImageWriter writer;
-    writer.setFileName(fileName); // 使用基于当前时间的文件名
-    writer.setFormat("png"); // 设置保存格式为PNG
-
-    QDir saveDir(path);
-    if (!saveDir.exists()) {
-        if (!saveDir.mkpath(path)) {
-            qDebug() << "Failed to create directory ./save/";
-            return; // 如果无法创建目录，则退出函数
-        }
-    }
-    // 保存图像
-    if (!writer.write(img)) {
-        qDebug() << "Failed to save image:" << writer.errorString();
-    } else {
-        qDebug() << "Image saved successfully to" << fileName;
-        setIcon(fileName);
-    }
+    photoWriter->submitImage(img);
 }
 // 相册
 void MainWindow::on_showimg_released()
@@ -358,6 +418,20 @@ void MainWindow::on_showimg_released()
         setIcon(fileName);
     });
 }
+// 照片落盘后用缩略图更新相册按钮, 不从磁盘读回
+void MainWindow::photoSaved(const QString &fileName, const QImage &thumbnail, double shutterToReadyMs)
+{
+    if (fileName.isEmpty()) {
+        qDebug() << "Failed to save image.";
+        return;
+    }
+    const PhotoWriterStats st = photoWriter->stats();
+    qDebug() << "Image saved successfully to" << fileName << "shutter-to-ready" << shutterToReadyMs
+             << "ms, avg" << st.avgShutterToReadyMs << "ms, queue" << st.queued << "/" << st.capacity;
+    if (thumbnail.isNull()) return;
+    ui->showimg->setIcon(QIcon(QPixmap::fromImage(thumbnail)));
+    ui->showimg->setIconSize(thumbnail.size());
+}
 // 用于展示最新保存的图片
 QString MainWindow::findOldestImage(const QString &folderPath) {
     QDir dir(folderPath);
@@ -368,7 +442,7 @@ QString MainWindow::findOldestImage(const QString &folderPath) {
 
     // 列出目录中的所有文件，并过滤出图片文件
     QStringList filters;
-    filters << "*.png"; // 添加更多图片格式如果需要
+    filters << "*.png" << "*.jpg"; // 添加更多图片格式如果需要
     dir.setNameFilters(filters);
 
     QFileInfoList list = dir.entryInfoList();
@@ -393,9 +467,6 @@ QString MainWindow::findOldestImage(const QString &folderPath) {
 }
 // 关闭线程
 void MainWindow::killThread(){
-    if(timer->isActive()){
-        timer->stop();
-    }
     if(m_captureThread){
         m_captureThread->stop();
         // 等待线程退出
@@ -3,7 +3,6 @@
 
 #include <QWidget>
 #include <QComboBox>
-#include <QTimer>
 
 #include "v4l2_video.h"
 
@@ -23,14 +22,21 @@ public:
 	MainWindow(QWidget *parent = nullptr);
 	~MainWindow();
 
+protected:
+    void keyPressEvent(QKeyEvent *event) override;
+
 private slots:
     void on_takepic_pressed();
     void on_takepic_released();
     void on_open_pb_released();
+    void on_record_pb_released();
     void on_showimg_released();
 
     void on_devices_currentIndexChanged(int index);
     void fillComboBoxWithResolutions(int a);
+    void saveStill(const QImage &img, qint64 captureUs);
+    void photoSaved(const QString &fileName, const QImage &thumbnail, double shutterToReadyMs);
+    void recordingFinished(const QString &fileName, bool ok);
 
 private:
     QString fourccToString(__u32 fourcc) {
@@ -54,12 +60,12 @@ private:
     QComboBox *devicesComboBox = nullptr;
     QComboBox *pixFormatComboBox = nullptr;
     QComboBox *resolutionsComboBox = nullptr;
-    QLabel *displayLabel = nullptr;
+    PreviewWidget *previewWidget = nullptr;
+    std::unique_ptr<PhotoWriter> photoWriter;   // 照片保存服务, 比采集对象后析构
     std::unique_ptr<Vvideo> m_captureThread;    // Vvideo 对象指针
     std::thread threadHandle;                   // 标准库线程对象
 
     QImage frame_;
-    QTimer *timer = nullptr;
 
 	int fd = -1;
 
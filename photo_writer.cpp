@@ -0,0 +1,245 @@
+#include "photo_writer.h"
+
+#include <cstdio>
+#include <cstring>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+
+#include "jpeg_decoder.h"
+#include "jpeg_encoder.h"
+#include "trace.h"
+
+#define FSYNC_BATCH 8   // 一批最多提交的照片数
+
+int64_t PhotoWriter::nowUs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+PhotoWriter::PhotoWriter(const QString &directory, int queueLen, QObject *parent)
+    : QObject(parent), directory_(directory),
+      jobs_(queueLen > 0 ? queueLen : 1, OverflowPolicy::Block)
+{
+    if (!QDir().mkpath(directory_)) {
+        qDebug() << "Failed to create photo directory" << directory_;
+    }
+    thread_ = std::thread(&PhotoWriter::writerLoop, this);
+}
+
+PhotoWriter::~PhotoWriter()
+{
+    // 关闭队列后写入线程把剩余照片写完再退出
+    jobs_.close();
+    if (thread_.joinable()) thread_.join();
+}
+
+bool PhotoWriter::submitImage(const QImage &image, int64_t shutterUs, int timeoutMs)
+{
+    if (image.isNull()) return false;
+    Job job;
+    job.image = image;
+    job.shutterUs = shutterUs;
+    return submit(std::move(job), timeoutMs);
+}
+
+bool PhotoWriter::submitJpeg(std::vector<uint8_t> &&jpeg, int64_t shutterUs, int timeoutMs)
+{
+    if (jpeg.empty()) return false;
+    Job job;
+    job.jpeg = std::move(jpeg);
+    job.shutterUs = shutterUs;
+    return submit(std::move(job), timeoutMs);
+}
+
+bool PhotoWriter::submit(Job &&job, int timeoutMs)
+{
+    if (jobs_.push(std::move(job), nullptr, timeoutMs) != QueueStatus::Ok) {
+        dropped_++;
+        qDebug() << "Photo dropped: writer queue full," << jobs_.capacity() << "pending";
+        return false;
+    }
+    return true;
+}
+
+void PhotoWriter::setQuality(int quality)
+{
+    quality_ = quality < 1 ? 1 : (quality > 100 ? 100 : quality);
+}
+
+void PhotoWriter::setThumbnailSize(const QSize &size)
+{
+    std::lock_guard<std::mutex> lock(thumbMutex_);
+    thumbnailSize_ = size;
+}
+
+PhotoWriterStats PhotoWriter::stats()
+{
+    PhotoWriterStats st;
+    st.queued = jobs_.size();
+    st.capacity = jobs_.capacity();
+    st.dropped = dropped_;
+    std::lock_guard<std::mutex> lock(statsMutex_);
+    st.written = written_;
+    st.failed = failed_;
+    st.lastShutterToReadyMs = lastShutterToReadyUs_ / 1000.0;
+    st.avgShutterToReadyMs = timedPhotos_ ? totalShutterToReadyUs_ / 1000.0 / timedPhotos_ : 0;
+    return st;
+}
+
+// 写入线程: 队列里还有照片时继续写临时文件, 取空或攒满一批后统一提交
+void PhotoWriter::writerLoop()
+{
+    Tracer::setThreadName("photo");
+    std::vector<Pending> batch;
+    Job job;
+    while (true) {
+        const QueueStatus status = jobs_.pop(job, batch.empty() ? -1 : 0);
+        if (status == QueueStatus::Ok) {
+            Pending pending;
+            if (writeTemp(job, pending)) {
+                batch.push_back(std::move(pending));
+            } else {
+                finish(pending, false);
+            }
+            job = Job();
+            if (batch.size() < FSYNC_BATCH) continue;
+        } else if (status == QueueStatus::Closed && batch.empty()) {
+            break;
+        }
+        commit(batch);
+    }
+}
+
+QImage PhotoWriter::makeThumbnail(const Job &job)
+{
+    QSize size;
+    {
+        std::lock_guard<std::mutex> lock(thumbMutex_);
+        size = thumbnailSize_;
+    }
+    if (size.isEmpty()) return QImage();
+    if (!job.image.isNull()) {
+        return job.image.scaled(size, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    }
+    // 已编码的照片按 TurboJPEG 缩放因子解码, 只解出接近缩略图大小的图像
+    QImage decoded;
+    if (!JpegDecoder::forThread().decode(job.jpeg.data(), job.jpeg.size(), decoded, size,
+                                         QImage::Format_RGB32)) {
+        return QImage();
+    }
+    return decoded.scaled(size, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+}
+
+QString PhotoWriter::uniqueFileName()
+{
+    const QString base = QDateTime::currentDateTime().toString("yyyyMMddhhmmsszzz");
+    if (base == lastName_) {
+        return base + "_" + QString::number(++sameNameCount_) + ".jpg";
+    }
+    lastName_ = base;
+    sameNameCount_ = 0;
+    return base + ".jpg";
+}
+
+bool PhotoWriter::writeTemp(const Job &job, Pending &pending)
+{
+    pending.shutterUs = job.shutterUs;
+    std::vector<uint8_t> encoded;
+    const std::vector<uint8_t> *jpeg = &job.jpeg;
+    if (jpeg->empty()) {
+        if (!JpegEncoder::forThread().encode(job.image, quality_, encoded)) return false;
+        jpeg = &encoded;
+    }
+    pending.thumbnail = makeThumbnail(job);
+
+    const QString name = uniqueFileName();
+    pending.fileName = QDir(directory_).filePath(name);
+    pending.path = pending.fileName.toLocal8Bit().toStdString();
+    // 隐藏的临时文件, 相册和 findOldestImage 的过滤规则都不会匹配
+    pending.tempPath = QDir(directory_).filePath("." + name + ".tmp").toLocal8Bit().toStdString();
+
+    pending.fd = open(pending.tempPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (pending.fd < 0) {
+        perror("Failed to create photo file");
+        return false;
+    }
+    const uint8_t *data = jpeg->data();
+    size_t left = jpeg->size();
+    while (left > 0) {
+        const ssize_t n = write(pending.fd, data, left);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("Failed to write photo file");
+            close(pending.fd);
+            pending.fd = -1;
+            unlink(pending.tempPath.c_str());
+            return false;
+        }
+        data += n;
+        left -= static_cast<size_t>(n);
+    }
+    pending.bytes = jpeg->size();
+    return true;
+}
+
+// 提交一批: 文件内容落盘后再 rename, 最后 fsync 目录使 rename 本身落盘
+void PhotoWriter::commit(std::vector<Pending> &batch)
+{
+    if (batch.empty()) return;
+    std::vector<bool> ok(batch.size(), true);
+    for (size_t i = 0; i < batch.size(); i++) {
+        Pending &p = batch[i];
+        if (fdatasync(p.fd) != 0) {
+            perror("Failed to sync photo file");
+            ok[i] = false;
+        }
+        if (close(p.fd) != 0) ok[i] = false;
+        p.fd = -1;
+        if (ok[i] && rename(p.tempPath.c_str(), p.path.c_str()) != 0) {
+            perror("Failed to rename photo file");
+            ok[i] = false;
+        }
+        if (!ok[i]) unlink(p.tempPath.c_str());
+    }
+    const int dirFd = open(directory_.toLocal8Bit().constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirFd >= 0) {
+        if (fsync(dirFd) != 0) perror("Failed to sync photo directory");
+        close(dirFd);
+    }
+    for (size_t i = 0; i < batch.size(); i++) finish(batch[i], ok[i]);
+    batch.clear();
+}
+
+void PhotoWriter::finish(const Pending &pending, bool ok)
+{
+    const int64_t shutterToReadyUs = pending.shutterUs > 0 ? nowUs() - pending.shutterUs : 0;
+    {
+        std::lock_guard<std::mutex> lock(statsMutex_);
+        if (ok) {
+            written_++;
+            if (pending.shutterUs > 0) {
+                lastShutterToReadyUs_ = shutterToReadyUs;
+                totalShutterToReadyUs_ += shutterToReadyUs;
+                timedPhotos_++;
+            }
+        } else {
+            failed_++;
+        }
+    }
+    if (!ok) {
+        qDebug() << "Failed to save photo" << pending.fileName;
+        emit photoSaved(QString(), QImage(), 0);
+        return;
+    }
+    qDebug() << "Photo saved to" << pending.fileName << pending.bytes << "bytes, shutter-to-ready"
+             << shutterToReadyUs / 1000.0 << "ms, queue depth" << jobs_.size();
+    emit photoSaved(pending.fileName, pending.thumbnail, shutterToReadyUs / 1000.0);
+}
@@ -0,0 +1,109 @@
+#ifndef PHOTO_WRITER_H
+#define PHOTO_WRITER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <QObject>
+#include <QImage>
+#include <QSize>
+#include <QString>
+
+#include "queue_.h"
+
+// 保存照片的统计
+struct PhotoWriterStats {
+    size_t queued;              // 等待编码/写入的照片数
+    size_t capacity;
+    uint64_t dropped;           // 队列满时拒绝的照片数
+    uint64_t written;
+    uint64_t failed;
+    double lastShutterToReadyMs; // 最近一张从按下快门到文件落盘的时间
+    double avgShutterToReadyMs;
+};
+
+/*
+ * 后台照片保存服务
+ * 照片进入有界队列(满时按调用者给的超时等待), 由写入线程用 TurboJPEG 编码(已是 JPEG 的直接写), 先写临时文件再 rename, 不会留下写了一半的照片
+ * 连续多张时攒成一批: 先逐个写临时文件, 队列空了或攒满 FSYNC_BATCH 张后统一 fsync, rename, 再 fsync 一次目录
+ * 完成后发出 photoSaved, 附带内存中生成的缩略图, UI 不必再从磁盘读回
+ */
+class PhotoWriter : public QObject {
+    Q_OBJECT
+public:
+    explicit PhotoWriter(const QString &directory, int queueLen = 4, QObject *parent = nullptr);
+    ~PhotoWriter();
+
+    // 编码保存一张照片, 支持 RGB888/RGB32, 其余格式先转换
+    // shutterUs 为按下快门的时间(CLOCK_MONOTONIC 微秒), 0 表示不统计
+    // 队列满时最多等待 timeoutMs(小于 0 一直等待), 仍然满则返回 false
+    bool submitImage(const QImage &image, int64_t shutterUs = 0, int timeoutMs = 0);
+    // 直接保存已编码的 JPEG
+    bool submitJpeg(std::vector<uint8_t> &&jpeg, int64_t shutterUs = 0, int timeoutMs = 0);
+
+    // JPEG 质量(1-100), 对之后编码的照片生效
+    void setQuality(int quality);
+    int quality() const { return quality_; }
+    // 缩略图尺寸(保持宽高比适配), 为空时不生成
+    void setThumbnailSize(const QSize &size);
+
+    QString directory() const { return directory_; }
+    size_t queueDepth() { return jobs_.size(); }
+    PhotoWriterStats stats();
+
+    // 当前时间(CLOCK_MONOTONIC 微秒), 与 shutterUs 同一时钟
+    static int64_t nowUs();
+
+signals:
+    // 照片已落盘; 失败时 fileName 为空
+    void photoSaved(const QString &fileName, const QImage &thumbnail, double shutterToReadyMs);
+
+private:
+    struct Job {
+        QImage image;
+        std::vector<uint8_t> jpeg;
+        int64_t shutterUs = 0;
+    };
+    // 已写入临时文件, 等待 fsync 和 rename
+    struct Pending {
+        int fd = -1;
+        std::string tempPath;
+        std::string path;
+        QString fileName;
+        QImage thumbnail;
+        int64_t shutterUs = 0;
+        size_t bytes = 0;
+    };
+
+    void writerLoop();
+    bool submit(Job &&job, int timeoutMs);
+    QImage makeThumbnail(const Job &job);
+    bool writeTemp(const Job &job, Pending &pending);
+    void commit(std::vector<Pending> &batch);
+    void finish(const Pending &pending, bool ok);
+    QString uniqueFileName();
+
+    QString directory_;
+    RingQueue<Job> jobs_;
+    std::thread thread_;
+    std::atomic<uint64_t> dropped_{0};
+    std::atomic<int> quality_{90};
+    std::mutex thumbMutex_;
+    QSize thumbnailSize_;
+    QString lastName_;               // 同一毫秒内多张照片时加序号, 只在写入线程使用
+    int sameNameCount_ = 0;
+
+    std::mutex statsMutex_;
+    uint64_t written_ = 0;
+    uint64_t failed_ = 0;
+    int64_t lastShutterToReadyUs_ = 0;
+    int64_t totalShutterToReadyUs_ = 0;
+    uint64_t timedPhotos_ = 0;
+};
+
+#endif // PHOTO_WRITER_H
@@ -0,0 +1,521 @@
+#include "pipeline_bench.h"
+
+#include <ctype.h>
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <QDebug>
+#include <QDir>
+#include <QEventLoop>
+#include <QTimer>
+
+#include "libyuv.h"
+#include "jpeg_encoder.h"
+#include "replay_source.h"
+#include "thread_pool.h"
+#include "trace.h"
+#include "v4l2_video.h"
+
+#define BENCH_SYNTH_QUALITY 85  // 合成 MJPG 帧的 JPEG 质量, 与常见 USB 摄像头输出相近
+#define BENCH_BURST_TIMEOUT_MS 3000     // 等待连拍照片全部送出的上限
+
+#if defined(__aarch64__)
+#define BENCH_ARCH "aarch64"
+#elif defined(__arm__)
+#define BENCH_ARCH "arm"
+#elif defined(__x86_64__)
+#define BENCH_ARCH "x86_64"
+#elif defined(__i386__)
+#define BENCH_ARCH "x86"
+#else
+#define BENCH_ARCH "unknown"
+#endif
+
+namespace {
+
+struct BenchOptions {
+    int seconds = 5;
+    int warmup = 1;
+    double fps = 0;
+    int threads = ThreadPool::defaultThreadCount();
+    std::vector<uint32_t> formats;
+    std::vector<QSize> sizes;
+    QSize box = QSize(800, 480);
+    int frames = 30;
+    int depthMs = DEFAULT_CAPTURE_DEPTH_MS;
+    size_t budget = DEFAULT_CAPTURE_BUDGET;
+    int burstPre = -1;          // 小于 0 时不测连拍
+    int burstPost = 0;
+    std::string replay;
+    std::string out;
+};
+
+struct ThreadTime {
+    std::string name;
+    uint64_t ticks;
+};
+
+struct CaseResult {
+    uint32_t fourcc;
+    QSize size;
+    bool ok;
+    double elapsedS;
+    uint64_t displayed;
+    uint64_t dequeued;
+    uint64_t lost;
+    uint64_t replaced;
+    uint64_t overflow;
+    uint64_t starved;
+    int buffers;
+    size_t bufferBytes;
+    std::vector<uint32_t> latencyUs;    // 已排序
+    std::vector<StageStats> stages;
+    std::map<std::string, double> cpuPercent;
+    long peakRssKb;
+    int burstPhotos;        // 一次 requestStill 送出的照片数, 不测连拍时为 -1
+    int burstFailed;
+};
+
+const char *formatName(uint32_t fourcc)
+{
+    switch (fourcc) {
+    case V4L2_PIX_FMT_MJPEG: return "MJPG";
+    case V4L2_PIX_FMT_YUYV: return "YUYV";
+    case V4L2_PIX_FMT_NV12: return "NV12";
+    default: return "unknown";
+    }
+}
+
+std::vector<std::string> splitList(const char *text)
+{
+    std::vector<std::string> items;
+    std::string item;
+    for (const char *p = text; ; p++) {
+        if (*p == ',' || *p == '\0') {
+            if (!item.empty()) items.push_back(item);
+            item.clear();
+            if (*p == '\0') break;
+        } else {
+            item += static_cast<char>(tolower(static_cast<unsigned char>(*p)));
+        }
+    }
+    return items;
+}
+
+bool parseSize(const std::string &text, QSize &size)
+{
+    int width = 0, height = 0;
+    char tail = 0;
+    if (sscanf(text.c_str(), "%dx%d%c", &width, &height, &tail) != 2) return false;
+    // YUYV/NV12 的色度按 2 像素对齐
+    if (width <= 0 || height <= 0 || width % 2 != 0 || height % 2 != 0) return false;
+    size = QSize(width, height);
+    return true;
+}
+
+bool parseOptions(int argc, char *argv[], BenchOptions &opt)
+{
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "--bench") continue;
+        if (i + 1 >= argc) {
+            fprintf(stderr, "Missing value for %s\n", arg.c_str());
+            return false;
+        }
+        const char *value = argv[++i];
+        if (arg == "--seconds") {
+            opt.seconds = std::max(1, atoi(value));
+        } else if (arg == "--warmup") {
+            opt.warmup = std::max(0, atoi(value));
+        } else if (arg == "--fps") {
+            opt.fps = std::max(0.0, atof(value));
+        } else if (arg == "--threads") {
+            opt.threads = std::max(1, atoi(value));
+        } else if (arg == "--frames") {
+            opt.frames = std::max(1, atoi(value));
+        } else if (arg == "--depth") {
+            opt.depthMs = std::max(0, atoi(value));
+        } else if (arg == "--budget") {
+            opt.budget = static_cast<size_t>(std::max(1, atoi(value))) << 20;
+        } else if (arg == "--burst") {
+            char tail = 0;
+            if (sscanf(value, "%d,%d%c", &opt.burstPre, &opt.burstPost, &tail) != 2
+                || opt.burstPre < 0 || opt.burstPost < 1) {
+                fprintf(stderr, "Invalid burst %s\n", value);
+                return false;
+            }
+        } else if (arg == "--replay") {
+            opt.replay = value;
+        } else if (arg == "--out") {
+            opt.out = value;
+        } else if (arg == "--box") {
+            if (!parseSize(value, opt.box)) {
+                fprintf(stderr, "Invalid box size %s\n", value);
+                return false;
+            }
+        } else if (arg == "--formats") {
+            opt.formats.clear();
+            for (const std::string &name : splitList(value)) {
+                if (name == "mjpg" || name == "mjpeg") opt.formats.push_back(V4L2_PIX_FMT_MJPEG);
+                else if (name == "yuyv") opt.formats.push_back(V4L2_PIX_FMT_YUYV);
+                else if (name == "nv12") opt.formats.push_back(V4L2_PIX_FMT_NV12);
+                else {
+                    fprintf(stderr, "Unknown format %s\n", name.c_str());
+                    return false;
+                }
+            }
+        } else if (arg == "--sizes") {
+            opt.sizes.clear();
+            for (const std::string &text : splitList(value)) {
+                QSize size;
+                if (!parseSize(text, size)) {
+                    fprintf(stderr, "Invalid size %s\n", text.c_str());
+                    return false;
+                }
+                opt.sizes.push_back(size);
+            }
+        } else {
+            fprintf(stderr, "Unknown option %s\n", arg.c_str());
+            return false;
+        }
+    }
+    if (opt.formats.empty()) {
+        opt.formats.push_back(V4L2_PIX_FMT_MJPEG);
+        opt.formats.push_back(V4L2_PIX_FMT_YUYV);
+        opt.formats.push_back(V4L2_PIX_FMT_NV12);
+    }
+    if (opt.sizes.empty()) {
+        opt.sizes.push_back(QSize(640, 480));
+        opt.sizes.push_back(QSize(1280, 720));
+        opt.sizes.push_back(QSize(1920, 1080));
+    }
+    // 录像只有一种格式和分辨率
+    if (!opt.replay.empty()) {
+        opt.formats.resize(1);
+        opt.sizes.resize(1);
+    }
+    return true;
+}
+
+// 合成帧: 斜向渐变叠加方格纹理, 每帧平移, 让 JPEG 大小和解码耗时接近真实画面
+void fillI420(int index, int width, int height, std::vector<uint8_t> &i420)
+{
+    i420.resize(static_cast<size_t>(width) * height * 3 / 2);
+    uint8_t *y = i420.data();
+    uint8_t *u = y + width * height;
+    uint8_t *v = u + width * height / 4;
+    const int shift = index * 8;
+    for (int row = 0; row < height; row++) {
+        for (int col = 0; col < width; col++) {
+            const int x = col + shift;
+            y[row * width + col] = static_cast<uint8_t>((x + row) / 8 + (((x >> 4) ^ (row >> 4)) & 1) * 48);
+        }
+    }
+    for (int row = 0; row < height / 2; row++) {
+        for (int col = 0; col < width / 2; col++) {
+            u[row * (width / 2) + col] = static_cast<uint8_t>(64 + (col * 2 + shift) % 128);
+            v[row * (width / 2) + col] = static_cast<uint8_t>(64 + row * 128 / (height / 2));
+        }
+    }
+}
+
+// 生成合成帧文件: MJPG 为拼接的 JPEG, YUYV/NV12 为紧密排列的原始帧
+std::string writeSynthetic(uint32_t fourcc, const QSize &size, int frames)
+{
+    const int w = size.width();
+    const int h = size.height();
+    char name[64];
+    snprintf(name, sizeof(name), "/qc_bench_%s_%dx%d.%s", formatName(fourcc), w, h,
+             fourcc == V4L2_PIX_FMT_MJPEG ? "mjpg" : "raw");
+    const std::string path = QDir::tempPath().toLocal8Bit().constData() + std::string(name);
+    FILE *file = fopen(path.c_str(), "wb");
+    if (!file) {
+        perror("Failed to create synthetic frames");
+        return std::string();
+    }
+
+    std::vector<uint8_t> i420, out;
+    bool ok = true;
+    for (int i = 0; i < frames && ok; i++) {
+        fillI420(i, w, h, i420);
+        const uint8_t *y = i420.data();
+        const uint8_t *u = y + w * h;
+        const uint8_t *v = u + w * h / 4;
+        if (fourcc == V4L2_PIX_FMT_MJPEG) {
+            FrameView view = {SourceFormat::I420, w, h, {y, u, v}, {w, w / 2, w / 2}};
+            ok = JpegEncoder::forThread().encodeI420(view, BENCH_SYNTH_QUALITY, out);
+        } else if (fourcc == V4L2_PIX_FMT_YUYV) {
+            out.resize(static_cast<size_t>(w) * h * 2);
+            libyuv::I420ToYUY2(y, w, u, w / 2, v, w / 2, out.data(), w * 2, w, h);
+        } else {
+            out.resize(static_cast<size_t>(w) * h * 3 / 2);
+            libyuv::I420ToNV12(y, w, u, w / 2, v, w / 2, out.data(), w, out.data() + w * h, w, w, h);
+        }
+        if (ok) ok = fwrite(out.data(), 1, out.size(), file) == out.size();
+    }
+    if (fclose(file) != 0) ok = false;
+    if (!ok) {
+        fprintf(stderr, "Failed to write synthetic frames to %s\n", path.c_str());
+        unlink(path.c_str());
+        return std::string();
+    }
+    return path;
+}
+
+// 各线程累计的 CPU 时间(时钟滴答), 以 tid 为键; 线程名由 Tracer::setThreadName 设置
+std::map<int, ThreadTime> threadTimes()
+{
+    std::map<int, ThreadTime> times;
+    DIR *dir = opendir("/proc/self/task");
+    if (!dir) return times;
+    while (struct dirent *entry = readdir(dir)) {
+        if (entry->d_name[0] == '.') continue;
+        const int tid = atoi(entry->d_name);
+        char path[64];
+        snprintf(path, sizeof(path), "/proc/self/task/%d/stat", tid);
+        FILE *file = fopen(path, "r");
+        if (!file) continue;
+        char line[512];
+        const bool ok = fgets(line, sizeof(line), file) != nullptr;
+        fclose(file);
+        if (!ok) continue;
+        // tid (comm) state ppid ...: comm 可能含空格, 从最后一个 ')' 之后解析, 第 14/15 项为 utime/stime
+        const char *open = strchr(line, '(');
+        const char *close = strrchr(line, ')');
+        if (!open || !close || close < open) continue;
+        unsigned long utime = 0, stime = 0;
+        if (sscanf(close + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu", &utime, &stime) != 2) continue;
+        ThreadTime t;
+        t.name.assign(open + 1, close);
+        t.ticks = utime + stime;
+        times[tid] = t;
+    }
+    closedir(dir);
+    return times;
+}
+
+// 两次采样之间各线程的 CPU 占用(单核百分比), 同名线程(如 worker)合计
+std::map<std::string, double> cpuPercent(const std::map<int, ThreadTime> &before,
+                                         const std::map<int, ThreadTime> &after, double seconds)
+{
+    std::map<std::string, double> percent;
+    const double ticksPerSecond = static_cast<double>(sysconf(_SC_CLK_TCK));
+    for (std::map<int, ThreadTime>::const_iterator it = after.begin(); it != after.end(); ++it) {
+        std::map<int, ThreadTime>::const_iterator old = before.find(it->first);
+        const uint64_t start = old != before.end() ? old->second.ticks : 0;
+        const uint64_t ticks = it->second.ticks > start ? it->second.ticks - start : 0;
+        percent[it->second.name] += ticks * 100.0 / ticksPerSecond / seconds;
+    }
+    return percent;
+}
+
+// 清零 VmHWM(Linux 4.0+), 每项单独统计峰值; 不支持时结果为进程启动以来的峰值
+void resetPeakRss()
+{
+    FILE *file = fopen("/proc/self/clear_refs", "w");
+    if (!file) return;
+    fputs("5", file);
+    fclose(file);
+}
+
+long peakRssKb()
+{
+    FILE *file = fopen("/proc/self/status", "r");
+    if (!file) return -1;
+    char line[256];
+    long kb = -1;
+    while (fgets(line, sizeof(line), file)) {
+        if (sscanf(line, "VmHWM: %ld", &kb) == 1) break;
+    }
+    fclose(file);
+    return kb;
+}
+
+// 运行 UI 线程的事件循环, 期间 frameReady 照常送到 updateImage
+void spin(int ms)
+{
+    QEventLoop loop;
+    QTimer::singleShot(ms, &loop, &QEventLoop::quit);
+    loop.exec();
+}
+
+uint32_t percentile(const std::vector<uint32_t> &sorted, double p)
+{
+    if (sorted.empty()) return 0;
+    const size_t index = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+bool runCase(const BenchOptions &opt, uint32_t fourcc, const QSize &size, const std::string &path, CaseResult &result)
+{
+    result.fourcc = fourcc;
+    result.size = size;
+    result.ok = false;
+    result.burstPhotos = -1;
+    result.burstFailed = 0;
+
+    ReplaySource *replay = new ReplaySource();
+    replay->setFrameRate(opt.fps);
+    replay->setLoop(true);
+    Vvideo video(std::unique_ptr<CaptureSource>(replay), nullptr);
+    video.setTargetSize(opt.box);
+    video.setWorkerThreads(opt.threads);
+    video.setCaptureBudget(opt.depthMs, opt.budget);
+    if (video.openDevice(QString::fromLocal8Bit(path.c_str())) < 0
+        || video.setFormat(size.width(), size.height(), fourcc) < 0
+        || video.initBuffers() < 0) {
+        return false;
+    }
+    QObject::connect(&video, &Vvideo::frameReady, &video, &Vvideo::updateImage, Qt::QueuedConnection);
+    // 连拍: 预录环在预热和测量期间填满, 测量结束后按一次快门, 统计送出的照片
+    int burstPhotos = 0;
+    int burstFailed = 0;
+    if (opt.burstPre >= 0) {
+        video.setBurst(opt.burstPre, opt.burstPost);
+        QObject::connect(&video, &Vvideo::stillReady, &video, [&](const QImage &image, qint64) {
+            if (image.isNull()) burstFailed++;
+            else burstPhotos++;
+        }, Qt::QueuedConnection);
+    }
+
+    resetPeakRss();
+    std::thread runner(&Vvideo::run, &video);
+    spin(opt.warmup * 1000);
+
+    // 预热结束后开始计数
+    video.setLatencySampling(true);
+    const DisplayStats display0 = video.displayStats();
+    const CaptureStats capture0 = video.captureStats();
+    const std::map<int, ThreadTime> cpu0 = threadTimes();
+    const int64_t start = Tracer::nowUs();
+
+    spin(opt.seconds * 1000);
+
+    const std::map<int, ThreadTime> cpu1 = threadTimes();
+    const int64_t end = Tracer::nowUs();
+    result.latencyUs = video.takeLatencySamples();
+    const DisplayStats display1 = video.displayStats();
+    const CaptureStats capture1 = video.captureStats();
+    result.stages = video.stageStats();
+    if (opt.burstPre >= 0) {
+        video.requestStill();
+        const int64_t deadline = Tracer::nowUs() + BENCH_BURST_TIMEOUT_MS * 1000;
+        while (burstPhotos + burstFailed < opt.burstPre + opt.burstPost && Tracer::nowUs() < deadline) spin(20);
+        result.burstPhotos = burstPhotos;
+        result.burstFailed = burstFailed;
+    }
+    video.stop();
+    runner.join();
+
+    result.elapsedS = (end - start) / 1e6;
+    result.displayed = display1.displayedFrames - display0.displayedFrames;
+    result.replaced = display1.replacedFrames - display0.replacedFrames;
+    result.dequeued = capture1.dequeued - capture0.dequeued;
+    result.lost = capture1.lostFrames - capture0.lostFrames;
+    result.overflow = capture1.overflowDropped - capture0.overflowDropped;
+    result.starved = capture1.starvation - capture0.starvation;
+    result.buffers = capture1.buffers;
+    result.bufferBytes = capture1.bufferBytes;
+    result.cpuPercent = cpuPercent(cpu0, cpu1, result.elapsedS);
+    result.peakRssKb = peakRssKb();
+    std::sort(result.latencyUs.begin(), result.latencyUs.end());
+    result.ok = true;
+    return true;
+}
+
+void writeCase(FILE *file, const CaseResult &r)
+{
+    fprintf(file, "    {\"format\":\"%s\",\"width\":%d,\"height\":%d", formatName(r.fourcc), r.size.width(), r.size.height());
+    if (!r.ok) {
+        fprintf(file, ",\"error\":\"failed to start pipeline\"}");
+        return;
+    }
+    const std::vector<uint32_t> &lat = r.latencyUs;
+    double mean = 0;
+    for (size_t i = 0; i < lat.size(); i++) mean += lat[i];
+    if (!lat.empty()) mean /= lat.size();
+    fprintf(file, ",\"seconds\":%.3f,\"fps\":%.2f,\"frames\":%llu,\"captured\":%llu,"
+                  "\"lost\":%llu,\"overflow_dropped\":%llu,\"replaced\":%llu",
+            r.elapsedS, r.elapsedS > 0 ? r.displayed / r.elapsedS : 0.0,
+            static_cast<unsigned long long>(r.displayed), static_cast<unsigned long long>(r.dequeued),
+            static_cast<unsigned long long>(r.lost), static_cast<unsigned long long>(r.overflow),
+            static_cast<unsigned long long>(r.replaced));
+    fprintf(file, ",\"capture_buffers\":%d,\"capture_buffer_kb\":%zu,\"starved\":%llu",
+            r.buffers, r.bufferBytes / 1024, static_cast<unsigned long long>(r.starved));
+    if (r.burstPhotos >= 0) {
+        fprintf(file, ",\"burst_photos\":%d,\"burst_failed\":%d", r.burstPhotos, r.burstFailed);
+    }
+    fprintf(file, ",\"latency_ms\":{\"mean\":%.3f,\"p50\":%.3f,\"p90\":%.3f,\"p99\":%.3f,\"max\":%.3f}",
+            mean / 1000.0, percentile(lat, 0.50) / 1000.0, percentile(lat, 0.90) / 1000.0,
+            percentile(lat, 0.99) / 1000.0, lat.empty() ? 0.0 : lat.back() / 1000.0);
+    fprintf(file, ",\"stages\":[");
+    for (size_t i = 0; i < r.stages.size(); i++) {
+        fprintf(file, "%s{\"name\":\"%s\",\"avg_wait_us\":%.1f,\"avg_process_us\":%.1f}", i ? "," : "",
+                r.stages[i].name, r.stages[i].avgWaitUs, r.stages[i].avgProcessUs);
+    }
+    fprintf(file, "],\"cpu_percent\":{");
+    double total = 0;
+    for (std::map<std::string, double>::const_iterator it = r.cpuPercent.begin(); it != r.cpuPercent.end(); ++it) {
+        fprintf(file, "\"%s\":%.1f,", it->first.c_str(), it->second);
+        total += it->second;
+    }
+    fprintf(file, "\"total\":%.1f},\"peak_rss_kb\":%ld}", total, r.peakRssKb);
+}
+
+} // namespace
+
+int runPipelineBench(int argc, char *argv[])
+{
+    BenchOptions opt;
+    if (!parseOptions(argc, argv, opt)) return 2;
+    Tracer::setThreadName("ui");
+
+    std::vector<CaseResult> results;
+    for (size_t f = 0; f < opt.formats.size(); f++) {
+        for (size_t s = 0; s < opt.sizes.size(); s++) {
+            const uint32_t fourcc = opt.formats[f];
+            const QSize size = opt.sizes[s];
+            const std::string path = opt.replay.empty() ? writeSynthetic(fourcc, size, opt.frames) : opt.replay;
+            qDebug() << "Bench" << formatName(fourcc) << size.width() << "x" << size.height();
+            CaseResult result;
+            if (path.empty() || !runCase(opt, fourcc, size, path, result)) {
+                result.fourcc = fourcc;
+                result.size = size;
+                result.ok = false;
+            }
+            if (opt.replay.empty() && !path.empty()) unlink(path.c_str());
+            results.push_back(result);
+        }
+    }
+
+    FILE *file = opt.out.empty() ? stdout : fopen(opt.out.c_str(), "w");
+    if (!file) {
+        perror("Failed to create bench output");
+        return 1;
+    }
+    fprintf(file, "{\n  \"arch\":\"%s\",\"compiler\":\"%s\",\"qt\":\"%s\",\"cpus\":%u,\n",
+            BENCH_ARCH, __VERSION__, qVersion(), std::thread::hardware_concurrency());
+    fprintf(file, "  \"options\":{\"seconds\":%d,\"warmup\":%d,\"fps\":%.2f,\"threads\":%d,\"box\":[%d,%d],"
+                  "\"burst\":[%d,%d],\"source\":\"%s\"},\n  \"cases\":[\n",
+            opt.seconds, opt.warmup, opt.fps, opt.threads, opt.box.width(), opt.box.height(),
+            std::max(opt.burstPre, 0), opt.burstPre >= 0 ? opt.burstPost : 1,
+            opt.replay.empty() ? "synthetic" : "replay");
+    bool allOk = true;
+    for (size_t i = 0; i < results.size(); i++) {
+        writeCase(file, results[i]);
+        fprintf(file, "%s\n", i + 1 < results.size() ? "," : "");
+        allOk = allOk && results[i].ok;
+    }
+    fprintf(file, "  ]\n}\n");
+    if (file != stdout) fclose(file);
+    return allOk ? 0 : 1;
+}
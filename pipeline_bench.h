@@ -0,0 +1,27 @@
+#ifndef PIPELINE_BENCH_H
+#define PIPELINE_BENCH_H
+
+/*
+ * 流水线性能测试(QC_e --bench), 不需要摄像头和屏幕
+ * 用 ReplaySource 把合成帧(或 --replay 指定的录像)送进 Vvideo, 不创建预览控件, UI 线程只取帧做统计
+ * 每种格式/分辨率运行一段时间, 输出 JSON: 显示帧率, 采集到显示延迟的分位数, 各线程 CPU 占用, 峰值 RSS,
+ * 采集缓冲区数量/内存和缓冲区耗尽次数, 指定 --burst 时还有一次快门送出的照片数
+ *
+ * 参数:
+ *   --seconds N       每项测量时长, 默认 5
+ *   --warmup N        每项预热时长(不计入结果), 默认 1
+ *   --fps F           回放帧率, 0 表示尽快送帧(默认, 测最大吞吐), 30 等表示按摄像头帧率测延迟
+ *   --threads N       转换线程数, 默认与 CPU 核数相同
+ *   --formats LIST    mjpg,yuyv,nv12 的子集, 默认全部
+ *   --sizes LIST      如 640x480,1920x1080, 默认 640x480,1280x720,1920x1080
+ *   --box WxH         显示区域大小, 默认 800x480
+ *   --frames N        合成帧数, 默认 30
+ *   --depth MS        采集缓冲区覆盖的流水线深度, 默认 150(见 Vvideo::setCaptureBudget)
+ *   --budget MB       采集缓冲区内存上限, 默认 48
+ *   --burst PRE,POST  测量结束后按一次快门, 按 Vvideo::setBurst(PRE, POST) 连拍, 输出送出的照片数(应为 PRE+POST)
+ *   --replay FILE     使用录像代替合成帧, 格式和分辨率取 --formats/--sizes 的第一项
+ *   --out FILE        JSON 写入文件, 默认写到标准输出(日志在标准错误)
+ */
+int runPipelineBench(int argc, char *argv[]);
+
+#endif // PIPELINE_BENCH_H
@@ -0,0 +1,143 @@
+#include "preview_widget.h"
+
+#include <QGuiApplication>
+#include <QScreen>
+#include <QPainter>
+#include <QPaintEvent>
+#include <QResizeEvent>
+#include <QMouseEvent>
+#include <QStyle>
+#include <QStyleOption>
+
+#include "trace.h"
+
+PreviewWidget::PreviewWidget(QWidget *parent)
+    : QWidget(parent)
+{
+    // 所有像素都由 paintEvent 绘制, Qt 不必先擦除背景
+    setAttribute(Qt::WA_OpaquePaintEvent);
+    targetWidth_ = width();
+    targetHeight_ = height();
+}
+
+void PreviewWidget::setFrame(const QImage &image)
+{
+    const QRect rect = imageRect(image.size());
+    frame_ = image;
+    if (rect != frameRect_) {
+        // 图像位置或尺寸变化, 留白区域也要重绘
+        frameRect_ = rect;
+        update();
+        return;
+    }
+    update(overlayVisible_ ? rect | overlayRect() : rect);
+}
+
+void PreviewWidget::clearFrame()
+{
+    frame_ = QImage();
+    frameRect_ = QRect();
+    update();
+}
+
+void PreviewWidget::setPlaceholderText(const QString &text)
+{
+    placeholder_ = text;
+    if (frame_.isNull()) update();
+}
+
+QSize PreviewWidget::targetSize() const
+{
+    return QSize(targetWidth_, targetHeight_);
+}
+
+void PreviewWidget::setOverlayVisible(bool visible)
+{
+    if (overlayVisible_ == visible) return;
+    overlayVisible_ = visible;
+    update();
+}
+
+void PreviewWidget::setOverlayStats(double fps, double latencyMs, const QString &details)
+{
+    overlayFps_ = fps;
+    overlayLatencyMs_ = latencyMs;
+    if (details.isEmpty() != overlayDetails_.isEmpty()) {
+        // 叠加层行数变化, 旧区域也要重绘
+        update(QRect(8, 8, 300, 44));
+    }
+    overlayDetails_ = details;
+}
+
+QImage::Format PreviewWidget::nativeFormat()
+{
+    QScreen *screen = QGuiApplication::primaryScreen();
+    if (screen && screen->depth() == 16) return QImage::Format_RGB16;
+    return QImage::Format_RGB32;
+}
+
+QRect PreviewWidget::imageRect(const QSize &imageSize) const
+{
+    if (imageSize.isEmpty()) return QRect();
+    return QRect((width() - imageSize.width()) / 2, (height() - imageSize.height()) / 2,
+                 imageSize.width(), imageSize.height());
+}
+
+QRect PreviewWidget::overlayRect() const
+{
+    return overlayDetails_.isEmpty() ? QRect(8, 8, 220, 24) : QRect(8, 8, 300, 44);
+}
+
+void PreviewWidget::paintEvent(QPaintEvent *event)
+{
+    TraceScope trace(TraceStage::Paint);
+    QPainter painter(this);
+
+    // 图像以外的区域按样式表绘制背景
+    const QRegion background = event->region() - frameRect_;
+    if (!background.isEmpty()) {
+        painter.save();
+        painter.setClipRegion(background);
+        painter.fillRect(rect(), palette().window());
+        QStyleOption opt;
+        opt.initFrom(this);
+        style()->drawPrimitive(QStyle::PE_Widget, &opt, &painter, this);
+        painter.restore();
+    }
+
+    // 不缩放, 不做平滑处理
+    if (!frame_.isNull()) {
+        painter.drawImage(frameRect_.topLeft(), frame_);
+    } else if (!placeholder_.isEmpty()) {
+        QFont font = painter.font();
+        font.setPointSize(20);
+        font.setBold(true);
+        painter.setFont(font);
+        painter.drawText(rect(), Qt::AlignCenter, placeholder_);
+    }
+
+    if (overlayVisible_) {
+        const QRect box = overlayRect();
+        painter.fillRect(box, QColor(0, 0, 0, 160));
+        painter.setPen(Qt::white);
+        QString text = QString("%1 fps  latency %2 ms")
+                           .arg(overlayFps_, 0, 'f', 1)
+                           .arg(overlayLatencyMs_, 0, 'f', 1);
+        if (!overlayDetails_.isEmpty()) text += "\n" + overlayDetails_;
+        painter.drawText(box.adjusted(6, 0, -6, 0), Qt::AlignVCenter | Qt::AlignLeft, text);
+    }
+}
+
+void PreviewWidget::resizeEvent(QResizeEvent *event)
+{
+    targetWidth_ = event->size().width();
+    targetHeight_ = event->size().height();
+    frameRect_ = imageRect(frame_.size());
+    QWidget::resizeEvent(event);
+}
+
+void PreviewWidget::mouseDoubleClickEvent(QMouseEvent *event)
+{
+    setOverlayVisible(!overlayVisible_);
+    QWidget::mouseDoubleClickEvent(event);
+}
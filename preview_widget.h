@@ -0,0 +1,61 @@
+#ifndef PREVIEW_WIDGET_H
+#define PREVIEW_WIDGET_H
+
+#include <atomic>
+
+#include <QWidget>
+#include <QImage>
+#include <QSize>
+#include <QRect>
+#include <QString>
+
+/*
+ * 预览控件, 替代 QLabel::setPixmap
+ * 直接绘制 QImage(来自 FramePool, 与处理线程共享同一块缓冲区), 不创建 QPixmap
+ * 图像已由处理线程缩放到控件大小, 这里只居中拷贝, 格式与屏幕一致时为一次内存块拷贝
+ * 每帧只重绘图像区域, 四周留白区域和子控件只在尺寸变化时重绘
+ * 双击切换帧率/延迟/丢帧信息的显示
+ */
+class PreviewWidget : public QWidget {
+    Q_OBJECT
+public:
+    explicit PreviewWidget(QWidget *parent = nullptr);
+
+    // 显示一帧, 只能在 UI 线程调用
+    void setFrame(const QImage &image);
+    void clearFrame();
+    // 没有图像时居中显示的文字
+    void setPlaceholderText(const QString &text);
+
+    // 图像需要适配的区域大小, 任意线程可调用
+    QSize targetSize() const;
+
+    void setOverlayVisible(bool visible);
+    bool overlayVisible() const { return overlayVisible_; }
+    // details 非空时在第二行显示(丢帧计数等)
+    void setOverlayStats(double fps, double latencyMs, const QString &details = QString());
+
+    // 屏幕的原生像素格式: 16 位屏为 RGB16, 其余为 RGB32
+    static QImage::Format nativeFormat();
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
+    void mouseDoubleClickEvent(QMouseEvent *event) override;
+
+private:
+    QRect imageRect(const QSize &imageSize) const;
+    QRect overlayRect() const;
+
+    QImage frame_;
+    QRect frameRect_;
+    QString placeholder_;
+    std::atomic<int> targetWidth_{0};
+    std::atomic<int> targetHeight_{0};
+    bool overlayVisible_ = false;
+    double overlayFps_ = 0;
+    double overlayLatencyMs_ = 0;
+    QString overlayDetails_;
+};
+
+#endif // PREVIEW_WIDGET_H
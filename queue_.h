@@ -1,7 +1,20 @@
+#ifndef QUEUE__H
+#define QUEUE__H
+
 #include <queue>
+#include <vector>
 #include <mutex>
+#include <chrono>
+#include <utility>
+#include <cstdint>
+#include <atomic>
+#include <memory>
+#include <new>
+#include <type_traits>
 #include <condition_variable>
 
+#define QUEUE_CACHE_LINE 64
+
 template <typename T>
 class SafeQueue {
 private:
@@ -42,3 +55,257 @@ public:
         return queue_.size();
     }
 };
+
+// 队列写满时的处理策略
+enum class OverflowPolicy {
+    Block,      // 阻塞生产者, 直到有空位(或超时/关闭)
+    DropOldest, // 挤掉队首最旧的元素
+    DropNewest  // 丢弃本次入队的元素
+};
+
+enum class QueueStatus {
+    Ok,
+    Dropped,    // 发生了丢弃, 被丢弃的元素通过 evicted 返回
+    Timeout,
+    Closed
+};
+
+/*
+ * 有界环形队列(单生产者/单消费者场景使用)
+ * 生产者/消费者都通过条件变量等待, 数据到达即唤醒, 不再依赖 sleep 轮询
+ * close() 后唤醒所有等待者: push 直接返回 Closed, pop 取完剩余元素后返回 Closed
+ */
+template <typename T>
+class RingQueue {
+public:
+    explicit RingQueue(size_t capacity, OverflowPolicy policy = OverflowPolicy::Block)
+        : buf_(capacity > 0 ? capacity : 1), policy_(policy) {}
+
+    RingQueue(const RingQueue&) = delete;
+    RingQueue& operator=(const RingQueue&) = delete;
+
+    // timeout_ms < 0 表示一直等待(仅 Block 策略下会等待)
+    // 发生丢弃时返回 Dropped, 被丢弃的元素(旧元素或本次元素)写入 evicted, 便于调用者回收
+    QueueStatus push(T item, T *evicted = nullptr, int timeout_ms = -1) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (closed_) return QueueStatus::Closed;
+
+        QueueStatus status = QueueStatus::Ok;
+        if (count_ == buf_.size()) {
+            if (policy_ == OverflowPolicy::DropNewest) {
+                ++dropped_;
+                if (evicted) *evicted = std::move(item);
+                return QueueStatus::Dropped;
+            } else if (policy_ == OverflowPolicy::DropOldest) {
+                ++dropped_;
+                if (evicted) *evicted = std::move(buf_[head_]);
+                head_ = (head_ + 1) % buf_.size();
+                --count_;
+                status = QueueStatus::Dropped;
+            } else {
+                if (!waitFor(notFull_, lock, timeout_ms,
+                        [this]() { return closed_ || count_ < buf_.size(); })) {
+                    return QueueStatus::Timeout;
+                }
+                if (closed_) return QueueStatus::Closed;
+            }
+        }
+
+        buf_[(head_ + count_) % buf_.size()] = std::move(item);
+        ++count_;
+        lock.unlock();
+        notEmpty_.notify_one();
+        return status;
+    }
+
+    // 队列为空时等待数据到达; 关闭且取空后返回 Closed
+    QueueStatus pop(T &item, int timeout_ms = -1) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (!waitFor(notEmpty_, lock, timeout_ms,
+                [this]() { return closed_ || count_ > 0; })) {
+            return QueueStatus::Timeout;
+        }
+        if (count_ == 0) return QueueStatus::Closed;
+
+        takeFront(item);
+        lock.unlock();
+        notFull_.notify_one();
+        return QueueStatus::Ok;
+    }
+
+    bool try_pop(T &item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (count_ == 0) return false;
+        takeFront(item);
+        lock.unlock();
+        notFull_.notify_one();
+        return true;
+    }
+
+    // 关闭队列并唤醒所有等待的线程
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            closed_ = true;
+        }
+        notEmpty_.notify_all();
+        notFull_.notify_all();
+    }
+
+    // 清空并重新打开, 用于重新开始采集
+    void reset() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        clearLocked();
+        closed_ = false;
+        dropped_ = 0;
+    }
+
+    void clear() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            clearLocked();
+        }
+        notFull_.notify_all();
+    }
+
+    bool closed() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return closed_;
+    }
+
+    size_t size() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return count_;
+    }
+
+    size_t capacity() const { return buf_.size(); }
+
+    uint64_t dropped() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return dropped_;
+    }
+
+private:
+    std::vector<T> buf_;
+    size_t head_ = 0;
+    size_t count_ = 0;
+    bool closed_ = false;
+    uint64_t dropped_ = 0;
+    const OverflowPolicy policy_;
+    std::mutex mutex_;
+    std::condition_variable notEmpty_;
+    std::condition_variable notFull_;
+
+    template <typename Pred>
+    static bool waitFor(std::condition_variable &cond, std::unique_lock<std::mutex> &lock,
+                        int timeout_ms, Pred pred) {
+        if (timeout_ms < 0) {
+            cond.wait(lock, pred);
+            return true;
+        }
+        return cond.wait_for(lock, std::chrono::milliseconds(timeout_ms), pred);
+    }
+
+    void takeFront(T &item) {
+        item = std::move(buf_[head_]);
+        buf_[head_] = T();  // 释放元素持有的资源(如 QPixmap 引用)
+        head_ = (head_ + 1) % buf_.size();
+        --count_;
+    }
+
+    void clearLocked() {
+        while (count_ > 0) {
+            buf_[head_] = T();
+            head_ = (head_ + 1) % buf_.size();
+            --count_;
+        }
+        head_ = 0;
+    }
+};
+
+/*
+ * 无锁单生产者/单消费者队列
+ * 读写索引分别独占缓存行, 避免生产者与消费者互相使缓存失效(伪共享)
+ * 元素原地构造(try_emplace), 出队时移动取出, QPixmap 之类的句柄不产生引用计数往返
+ * 只能有一个线程调用 try_emplace/try_push, 一个线程调用 try_pop
+ */
+template <typename T>
+class SpscQueue {
+public:
+    // 容量向上取整为 2 的幂
+    explicit SpscQueue(size_t capacity)
+        : capacity_(roundUpPow2(capacity)), mask_(capacity_ - 1),
+          slots_(new Slot[capacity_]) {}
+
+    ~SpscQueue() {
+        // 析构残留元素
+        size_t head = head_.load(std::memory_order_relaxed);
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        for (; head != tail; ++head) {
+            reinterpret_cast<T*>(&slots_[head & mask_])->~T();
+        }
+    }
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    template <typename... Args>
+    bool try_emplace(Args&&... args) {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - cachedHead_ == capacity_) {
+            // 只有看起来满了才去读消费者的索引
+            cachedHead_ = head_.load(std::memory_order_acquire);
+            if (tail - cachedHead_ == capacity_) return false;
+        }
+        new (&slots_[tail & mask_]) T(std::forward<Args>(args)...);
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool try_push(T&& item) { return try_emplace(std::move(item)); }
+    bool try_push(const T& item) { return try_emplace(item); }
+
+    bool try_pop(T &item) {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        if (head == cachedTail_) {
+            cachedTail_ = tail_.load(std::memory_order_acquire);
+            if (head == cachedTail_) return false;
+        }
+        T *slot = reinterpret_cast<T*>(&slots_[head & mask_]);
+        item = std::move(*slot);
+        slot->~T();
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // 近似值, 仅用于统计
+    size_t size() const {
+        return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+    }
+
+    bool empty() const { return size() == 0; }
+    size_t capacity() const { return capacity_; }
+
+private:
+    typedef typename std::aligned_storage<sizeof(T), alignof(T)>::type Slot;
+
+    static size_t roundUpPow2(size_t n) {
+        size_t cap = 2;
+        while (cap < n) cap <<= 1;
+        return cap;
+    }
+
+    const size_t capacity_;
+    const size_t mask_;
+    std::unique_ptr<Slot[]> slots_;
+
+    // 消费者独占: 读索引 + 缓存的写索引
+    alignas(QUEUE_CACHE_LINE) std::atomic<size_t> head_{0};
+    size_t cachedTail_ = 0;
+    // 生产者独占: 写索引 + 缓存的读索引
+    alignas(QUEUE_CACHE_LINE) std::atomic<size_t> tail_{0};
+    size_t cachedHead_ = 0;
+    char pad_[QUEUE_CACHE_LINE - sizeof(std::atomic<size_t>) - sizeof(size_t)];
+};
+
+#endif // QUEUE__H
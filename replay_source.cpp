@@ -0,0 +1,439 @@
+#include "replay_source.h"
+
+#include <linux/videodev2.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <QDebug>
+
+#include "frame_exporter.h"
+
+#define REPLAY_SCAN_BLOCK (1u << 20)    // 切分 MJPEG 文件时每次读取的大小
+#define REPLAY_MAX_LAG_US 1000000       // 取帧停顿超过这么久后重新对齐帧位置, 不再追赶
+
+namespace {
+
+int64_t monotonicUs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+uint32_t le32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+} // namespace
+
+ReplaySource::ReplaySource()
+{
+    for (int i = 0; i < REPLAY_MAX_BUFFERS; i++) memfds_[i] = -1;
+}
+
+ReplaySource::~ReplaySource()
+{
+    close();
+}
+
+int ReplaySource::open(const QString &fileName)
+{
+    close();
+    fd_ = ::open(fileName.toLocal8Bit().constData(), O_RDONLY | O_CLOEXEC);
+    if (fd_ < 0) {
+        qDebug() << "Failed to open replay file" << fileName;
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd_, &st) != 0) {
+        perror("Failed to stat replay file");
+        ::close(fd_);
+        fd_ = -1;
+        return -1;
+    }
+    fileSize_ = static_cast<uint64_t>(st.st_size);
+    frames_.clear();
+    fileFps_ = 0;
+    fileWidth_ = 0;
+    fileHeight_ = 0;
+
+    // 按文件内容识别格式, 其余一律当作原始帧
+    uint8_t head[12] = {0};
+    const size_t headBytes = fileSize_ < sizeof(head) ? static_cast<size_t>(fileSize_) : sizeof(head);
+    bool ok = readAt(0, head, headBytes);
+    compressed_ = false;
+    if (ok && headBytes >= 12 && memcmp(head, "RIFF", 4) == 0 && memcmp(head + 8, "AVI ", 4) == 0) {
+        compressed_ = true;
+        ok = indexAvi();
+    } else if (ok && headBytes >= 2 && head[0] == 0xFF && head[1] == 0xD8) {
+        compressed_ = true;
+        ok = indexMjpeg();
+    }
+    // 只有丢帧占位块(长度为 0)的录像同样无帧可放, 循环回放时会一直找不到帧
+    if (!ok || (compressed_ && frameSize() == 0)) {
+        qDebug() << "No frames found in replay file" << fileName;
+        ::close(fd_);
+        fd_ = -1;
+        return -1;
+    }
+    if (compressed_) {
+        qDebug() << "Replay file" << fileName << "has" << frames_.size() << "MJPG frames";
+    }
+    return 0;
+}
+
+bool ReplaySource::readAt(uint64_t offset, void *data, size_t length)
+{
+    uint8_t *dst = static_cast<uint8_t*>(data);
+    while (length > 0) {
+        const ssize_t n = pread(fd_, dst, length, static_cast<off_t>(offset));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("Failed to read replay file");
+            return false;
+        }
+        if (n == 0) return false;
+        dst += n;
+        offset += n;
+        length -= n;
+    }
+    return true;
+}
+
+// RIFF 'AVI ' 之后依次是 LIST hdrl, LIST movi, idx1; 直接遍历 movi 中的块, 不依赖 idx1
+bool ReplaySource::indexAvi()
+{
+    uint64_t pos = 12;
+    while (pos + 12 <= fileSize_) {
+        uint8_t head[12];
+        if (!readAt(pos, head, sizeof(head))) return false;
+        const uint32_t size = le32(head + 4);
+        if (memcmp(head, "LIST", 4) == 0 && memcmp(head + 8, "hdrl", 4) == 0) {
+            // hdrl 的第一个块是 avih: dwMicroSecPerFrame 在最前, 宽高在第 32/36 字节
+            uint8_t avih[8 + 40];
+            if (size >= 4 + sizeof(avih) && readAt(pos + 12, avih, sizeof(avih)) && memcmp(avih, "avih", 4) == 0) {
+                const uint32_t usPerFrame = le32(avih + 8);
+                if (usPerFrame > 0) fileFps_ = 1000000.0 / usPerFrame;
+                fileWidth_ = le32(avih + 8 + 32);
+                fileHeight_ = le32(avih + 8 + 36);
+            }
+        } else if (memcmp(head, "LIST", 4) == 0 && memcmp(head + 8, "movi", 4) == 0) {
+            // 录像中断时列表长度还没有回写, 一直扫到文件末尾
+            uint64_t end = pos + 8 + size;
+            if (size <= 4 || end > fileSize_) end = fileSize_;
+            uint64_t p = pos + 12;
+            while (p + 8 <= end) {
+                uint8_t chunk[8];
+                if (!readAt(p, chunk, sizeof(chunk))) return false;
+                const uint32_t length = le32(chunk + 4);
+                if (memcmp(chunk, "LIST", 4) == 0) {
+                    // 'rec ' 列表, 进入其中继续遍历
+                    p += 12;
+                    continue;
+                }
+                if (p + 8 + length > end) break;    // 截断的最后一块
+                // '00dc'/'00db' 为视频帧, 空块是录像时补的丢帧位置
+                if (chunk[2] == 'd' && (chunk[3] == 'c' || chunk[3] == 'b')) {
+                    Entry entry;
+                    entry.offset = p + 8;
+                    entry.length = length;
+                    frames_.push_back(entry);
+                }
+                p += 8 + length + (length & 1);
+            }
+            return true;
+        }
+        pos += 8 + static_cast<uint64_t>(size) + (size & 1);
+    }
+    return true;
+}
+
+// 连续拼接的 JPEG: 从 SOI(FFD8) 到其后第一个 EOI(FFD9) 为一帧
+// 摄像头输出的 MJPG 不带缩略图, 不会出现嵌套的 SOI/EOI
+bool ReplaySource::indexMjpeg()
+{
+    std::vector<uint8_t> block(REPLAY_SCAN_BLOCK);
+    uint64_t pos = 0;
+    uint64_t start = 0;
+    bool inFrame = false;
+    uint8_t prev = 0;
+    while (pos < fileSize_) {
+        const size_t want = static_cast<size_t>(std::min<uint64_t>(block.size(), fileSize_ - pos));
+        if (!readAt(pos, block.data(), want)) return false;
+        for (size_t i = 0; i < want; i++) {
+            const uint8_t c = block[i];
+            if (prev == 0xFF) {
+                if (!inFrame && c == 0xD8) {
+                    inFrame = true;
+                    start = pos + i - 1;
+                } else if (inFrame && c == 0xD9) {
+                    inFrame = false;
+                    Entry entry;
+                    entry.offset = start;
+                    entry.length = static_cast<uint32_t>(pos + i + 1 - start);
+                    frames_.push_back(entry);
+                }
+            }
+            prev = c;
+        }
+        pos += want;
+    }
+    return true;
+}
+
+int ReplaySource::setFormat(uint32_t width, uint32_t height, uint32_t fourcc)
+{
+    if (fd_ < 0) return -1;
+    const bool mjpg = fourcc == V4L2_PIX_FMT_MJPEG || fourcc == V4L2_PIX_FMT_JPEG;
+    if (compressed_) {
+        if (!mjpg) {
+            qDebug() << "Replay file only contains MJPG frames";
+            return -1;
+        }
+        if (fileWidth_ != 0 && (fileWidth_ != width || fileHeight_ != height)) {
+            qDebug() << "Replay file is" << fileWidth_ << "x" << fileHeight_ << ", requested" << width << "x" << height;
+        }
+        return 0;
+    }
+
+    // 原始帧紧密排列, 帧大小由格式决定
+    uint64_t frameBytes = 0;
+    if (fourcc == V4L2_PIX_FMT_YUYV) {
+        frameBytes = static_cast<uint64_t>(width) * height * 2;
+    } else if (fourcc == V4L2_PIX_FMT_NV12) {
+        frameBytes = static_cast<uint64_t>(width) * height * 3 / 2;
+    } else {
+        qDebug() << "Unsupported replay format";
+        return -1;
+    }
+    if (frameBytes == 0 || fileSize_ < frameBytes) {
+        qDebug() << "Replay file is smaller than one frame";
+        return -1;
+    }
+    frames_.clear();
+    for (uint64_t offset = 0; offset + frameBytes <= fileSize_; offset += frameBytes) {
+        Entry entry;
+        entry.offset = offset;
+        entry.length = static_cast<uint32_t>(frameBytes);
+        frames_.push_back(entry);
+    }
+    qDebug() << "Replay file has" << frames_.size() << "raw frames of" << width << "x" << height;
+    return 0;
+}
+
+double ReplaySource::playbackFps() const
+{
+    if (requestedFps_ >= 0) return requestedFps_;
+    return fileFps_ > 0 ? fileFps_ : REPLAY_DEFAULT_FPS;
+}
+
+bool ReplaySource::frameInterval(uint32_t &numerator, uint32_t &denominator)
+{
+    const double fps = playbackFps();
+    if (fps <= 0) return false;
+    numerator = 1000;
+    denominator = static_cast<uint32_t>(std::lround(fps * 1000));
+    return denominator > 0;
+}
+
+// 缓冲区按最大的一帧分配
+size_t ReplaySource::frameSize() const
+{
+    uint32_t maxBytes = 0;
+    for (size_t i = 0; i < frames_.size(); i++) maxBytes = std::max(maxBytes, frames_[i].length);
+    return maxBytes;
+}
+
+int ReplaySource::exportBuffer(int index, int plane)
+{
+    if (index < 0 || index >= count_ || plane != 0 || memfds_[index] < 0) return -1;
+    const int fd = fcntl(memfds_[index], F_DUPFD_CLOEXEC, 0);
+    if (fd < 0) perror("Failed to export replay buffer");
+    return fd;
+}
+
+int ReplaySource::initBuffers(video_buf_t *bufs, int maxCount)
+{
+    if (fd_ < 0 || frames_.empty()) {
+        qDebug() << "Replay file has no frames";
+        return -1;
+    }
+    freeBuffers();
+
+    // 每个缓冲区按最大的一帧分配, 原始格式时正好是一帧
+    const size_t maxBytes = frameSize();
+    framebuf_ = bufs;
+    count_ = std::min(maxCount, REPLAY_MAX_BUFFERS);
+    std::memset(framebuf_, 0, sizeof(video_buf_t) * count_);
+    for (int i = 0; i < count_; i++) memfds_[i] = -1;
+    for (int i = 0; i < count_; i++) {
+        void *p = nullptr;
+        // memfd 映射按页对齐, 不可用时退回普通内存(不能导出)
+        memfds_[i] = FrameExporter::createMemfd("qc_replay", maxBytes);
+        if (memfds_[i] >= 0) {
+            p = mmap(NULL, maxBytes, PROT_READ | PROT_WRITE, MAP_SHARED, memfds_[i], 0);
+            if (p == MAP_FAILED) {
+                ::close(memfds_[i]);
+                memfds_[i] = -1;
+                p = nullptr;
+            }
+        }
+        if (p == nullptr && posix_memalign(&p, 64, maxBytes) != 0) {
+            qDebug() << "Failed to allocate replay buffers";
+            freeBuffers();
+            return -1;
+        }
+        framebuf_[i].plane_count = 1;
+        framebuf_[i].fm[0].start = p;
+        framebuf_[i].fm[0].length = maxBytes;
+    }
+
+    const double fps = playbackFps();
+    std::lock_guard<std::mutex> lock(mutex_);
+    free_.clear();
+    for (int i = 0; i < count_; i++) free_.push_back(i);
+    intervalUs_ = fps > 0 ? std::llround(1000000.0 / fps) : 0;
+    next_ = 0;
+    sequence_ = 0;
+    slot_ = 0;
+    startUs_ = monotonicUs();
+    starvedFromUs_ = 0;
+    starvedUntilUs_ = 0;
+    finished_ = false;
+    streaming_ = true;
+    qDebug() << "Replaying" << frames_.size() << "frames with" << count_ << "buffers at"
+             << (fps > 0 ? QString::number(fps) : QString("max")) << "fps";
+    return count_;
+}
+
+int ReplaySource::dequeue(CapturedFrame &frame, int timeoutMs)
+{
+    const int64_t deadlineUs = monotonicUs() + static_cast<int64_t>(timeoutMs) * 1000;
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        if (!streaming_) return -1;
+        const int64_t nowUs = monotonicUs();
+
+        if (next_ >= frames_.size()) {
+            if (loop_) {
+                next_ = 0;
+            } else {
+                // 播完后像没有信号的摄像头一样一直超时
+                if (!finished_.exchange(true)) qDebug() << "Replay finished after" << sequence_ << "frames";
+                if (nowUs < deadlineUs) cond_.wait_for(lock, std::chrono::microseconds(deadlineUs - nowUs));
+                return streaming_ ? 0 : -1;
+            }
+        }
+
+        int64_t dueUs = nowUs;
+        if (intervalUs_ > 0) {
+            dueUs = startUs_ + static_cast<int64_t>(slot_) * intervalUs_;
+            if (nowUs - dueUs > REPLAY_MAX_LAG_US) {
+                startUs_ = nowUs - static_cast<int64_t>(slot_) * intervalUs_;
+                dueUs = nowUs;
+            }
+            if (dueUs > nowUs) {
+                if (dueUs > deadlineUs) {
+                    if (nowUs < deadlineUs) cond_.wait_for(lock, std::chrono::microseconds(deadlineUs - nowUs));
+                    return streaming_ ? 0 : -1;
+                }
+                // 可能被 requeue 或 close 提前唤醒, 回到开头重新检查
+                cond_.wait_for(lock, std::chrono::microseconds(dueUs - nowUs));
+                continue;
+            }
+        } else if (free_.empty()) {
+            // 尽快出帧时等待缓冲区归还, 不丢帧
+            if (nowUs >= deadlineUs) return 0;
+            cond_.wait_for(lock, std::chrono::microseconds(deadlineUs - nowUs));
+            continue;
+        }
+
+        // 帧位置到了: 没有空闲缓冲区或录像时已丢的帧只消耗一个序号
+        // 取帧来迟时, 到点那一刻缓冲区全被占用的帧同样算丢失
+        const Entry entry = frames_[next_++];
+        slot_++;
+        const uint32_t sequence = sequence_++;
+        const bool starved = free_.empty() || (dueUs >= starvedFromUs_ && dueUs < starvedUntilUs_);
+        if (entry.length == 0 || starved) {
+            // 连续跳过的帧也要遵守超时, 不能持锁一直循环
+            if (nowUs >= deadlineUs) return 0;
+            continue;
+        }
+        const int index = free_.front();
+        free_.pop_front();
+        if (free_.empty()) {
+            starvedFromUs_ = dueUs;
+            starvedUntilUs_ = INT64_MAX;
+        }
+        lock.unlock();
+
+        // 缓冲区已经出队, 由本线程独占, 读文件时不持锁
+        video_buf_t &vb = framebuf_[index];
+        if (!readAt(entry.offset, vb.fm[0].start, entry.length)) {
+            requeue(index);
+            return -1;
+        }
+        frame.index = index;
+        frame.sequence = sequence;
+        frame.flags = V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC;
+        frame.timestampUs = dueUs;
+        std::memset(frame.bytesused, 0, sizeof(frame.bytesused));
+        frame.bytesused[0] = entry.length;
+        return 1;
+    }
+}
+
+void ReplaySource::requeue(int index)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!streaming_ || index < 0 || index >= count_) return;
+        if (free_.empty()) starvedUntilUs_ = monotonicUs();
+        free_.push_back(index);
+    }
+    cond_.notify_all();
+}
+
+void ReplaySource::freeBuffers()
+{
+    if (framebuf_ == nullptr) return;
+    for (int i = 0; i < count_; i++) {
+        if (memfds_[i] >= 0) {
+            if (framebuf_[i].fm[0].start) munmap(framebuf_[i].fm[0].start, framebuf_[i].fm[0].length);
+            ::close(memfds_[i]);
+            memfds_[i] = -1;
+        } else {
+            free(framebuf_[i].fm[0].start);
+        }
+        framebuf_[i].fm[0].start = nullptr;
+        framebuf_[i].fm[0].length = 0;
+    }
+    framebuf_ = nullptr;
+    count_ = 0;
+}
+
+int ReplaySource::close()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        streaming_ = false;
+        free_.clear();
+    }
+    cond_.notify_all();
+    freeBuffers();
+    if (fd_ < 0) return -1;
+    ::close(fd_);
+    fd_ = -1;
+    return 0;
+}
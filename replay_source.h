@@ -0,0 +1,93 @@
+#ifndef REPLAY_SOURCE_H
+#define REPLAY_SOURCE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+#include "capture_source.h"
+
+#define REPLAY_MAX_BUFFERS 8        // 回放缓冲区数量上限, 原始格式每个缓冲区是一整帧
+#define REPLAY_DEFAULT_FPS 30       // 文件中没有帧率信息时的回放帧率
+
+/*
+ * 文件回放采集源: 把录下来的帧按 V4L2 的缓冲区/索引协议送出, 用于没有摄像头时测试和性能测试
+ * 支持的文件按内容识别:
+ *   MJPEG-AVI(本程序录像, '00dc' 块, 空块按丢帧处理), 帧率取 avih
+ *   连续拼接的 JPEG(.mjpg), 按 SOI/EOI 切分
+ *   原始 YUYV/NV12 帧, 帧大小由 setFormat 的分辨率和格式决定
+ * 每帧像驱动一样 pread 到自己的缓冲区里, 出列时间戳为 CLOCK_MONOTONIC
+ * 缓冲区用 memfd 分配, 可以像 dmabuf 一样通过 exportBuffer 导出给其它进程
+ * 按帧率回放时按绝对时间排布帧位置: 到点时没有空闲缓冲区就丢掉这一帧并跳过一个序号, 与真实设备一致
+ * 帧率为 0 时不等待, 只要有空闲缓冲区就立即出帧, 用于测量流水线的最大吞吐
+ */
+class ReplaySource : public CaptureSource {
+public:
+    ReplaySource();
+    ~ReplaySource() override;
+
+    // 回放帧率, 0 表示尽快出帧; 小于 0 时使用文件记录的帧率(默认); 需在 initBuffers 之前设置
+    void setFrameRate(double fps) { requestedFps_ = fps; }
+    // 播放到文件末尾后从头开始, 默认开启; 关闭时播完后 dequeue 一直超时, finished() 返回 true
+    void setLoop(bool loop) { loop_ = loop; }
+    bool finished() const { return finished_; }
+    // 文件中的帧数(含空块)
+    size_t frameCount() const { return frames_.size(); }
+
+    int open(const QString &fileName) override;
+    int setFormat(uint32_t width, uint32_t height, uint32_t fourcc) override;
+    int initBuffers(video_buf_t *bufs, int maxCount) override;
+    int dequeue(CapturedFrame &frame, int timeoutMs) override;
+    void requeue(int index) override;
+    int close() override;
+    bool frameInterval(uint32_t &numerator, uint32_t &denominator) override;
+    bool multiPlane() const override { return !compressed_; }
+    int exportBuffer(int index, int plane) override;
+    size_t frameSize() const override;
+
+private:
+    // 一帧在文件中的位置, length 为 0 表示录像时丢掉的帧
+    struct Entry {
+        uint64_t offset;
+        uint32_t length;
+    };
+
+    double playbackFps() const;
+    bool readAt(uint64_t offset, void *data, size_t length);
+    bool indexAvi();
+    bool indexMjpeg();
+    void freeBuffers();
+
+    int fd_ = -1;
+    uint64_t fileSize_ = 0;
+    bool compressed_ = false;               // AVI/MJPEG 文件, 只能按 MJPG 格式回放
+    double fileFps_ = 0;                    // 文件记录的帧率, 没有时为 0
+    uint32_t fileWidth_ = 0;                // AVI 记录的分辨率
+    uint32_t fileHeight_ = 0;
+    double requestedFps_ = -1;
+    std::atomic<bool> loop_{true};
+    std::atomic<bool> finished_{false};
+    std::vector<Entry> frames_;
+
+    video_buf_t *framebuf_ = nullptr;
+    int count_ = 0;
+    int memfds_[REPLAY_MAX_BUFFERS];        // 缓冲区对应的 memfd, -1 表示 memfd 不可用时的普通内存
+
+    std::mutex mutex_;
+    std::condition_variable cond_;          // 有缓冲区归还或停止
+    std::deque<int> free_;                  // 等待填充的缓冲区, 相当于驱动的输入队列
+    bool streaming_ = false;
+    size_t next_ = 0;                       // 下一帧在 frames_ 中的位置
+    uint32_t sequence_ = 0;
+    int64_t intervalUs_ = 0;                // 0 表示尽快出帧
+    int64_t startUs_ = 0;                   // 第 0 个帧位置的时间
+    uint64_t slot_ = 0;                     // 已经过的帧位置数
+    int64_t starvedFromUs_ = 0;             // 最近一次缓冲区全部被占用的时间段, 落在其中的帧位置丢帧
+    int64_t starvedUntilUs_ = 0;
+};
+
+#endif // REPLAY_SOURCE_H
@@ -0,0 +1,93 @@
+#include "thread_pool.h"
+
+#include <atomic>
+#include <memory>
+
+#include "trace.h"
+
+ThreadPool::ThreadPool(int threads)
+{
+    for (int i = 0; i < threads; i++) {
+        workers_.push_back(std::thread(&ThreadPool::workerLoop, this));
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cond_.notify_all();
+    // 已投递的任务执行完才退出
+    for (std::thread &t : workers_) {
+        if (t.joinable()) t.join();
+    }
+}
+
+int ThreadPool::defaultThreadCount()
+{
+    const unsigned n = std::thread::hardware_concurrency();
+    return n > 0 ? static_cast<int>(n) : 2;
+}
+
+void ThreadPool::submit(std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tasks_.push_back(std::move(task));
+    }
+    cond_.notify_one();
+}
+
+void ThreadPool::workerLoop()
+{
+    Tracer::setThreadName("worker");
+    for (;;) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cond_.wait(lock, [this]() { return stop_ || !tasks_.empty(); });
+            if (tasks_.empty()) return;  // stop_ 且没有剩余任务
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+        }
+        task();
+    }
+}
+
+void ThreadPool::parallelFor(int count, const std::function<void(int)> &fn)
+{
+    if (count <= 0) return;
+    if (count == 1 || workers_.empty()) {
+        for (int i = 0; i < count; i++) fn(i);
+        return;
+    }
+
+    // 状态由共享指针持有: 所有条带完成后才开始执行的辅助任务只会取到越界索引, 不会再访问 fn
+    struct State {
+        std::atomic<int> next{0};
+        int remaining = 0;
+        std::mutex mutex;
+        std::condition_variable done;
+    };
+    std::shared_ptr<State> state = std::make_shared<State>();
+    state->remaining = count;
+
+    const std::function<void(int)> *body = &fn;
+    std::function<void()> run = [state, body, count]() {
+        int i;
+        while ((i = state->next.fetch_add(1)) < count) {
+            (*body)(i);
+            std::lock_guard<std::mutex> lock(state->mutex);
+            if (--state->remaining == 0) state->done.notify_all();
+        }
+    };
+
+    const int helpers = std::min(count - 1, size());
+    for (int i = 0; i < helpers; i++) submit(run);
+    run();
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->done.wait(lock, [&state]() { return state->remaining == 0; });
+}
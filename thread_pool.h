@@ -0,0 +1,43 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <functional>
+#include <condition_variable>
+
+/*
+ * 常驻工作线程池
+ * submit 投递独立任务(按帧并行), parallelFor 把一帧拆成条带并行处理, 调用线程也参与计算
+ */
+class ThreadPool {
+public:
+    explicit ThreadPool(int threads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int size() const { return static_cast<int>(workers_.size()); }
+
+    void submit(std::function<void()> task);
+
+    // 执行 fn(0) ... fn(count - 1), 全部完成后返回
+    void parallelFor(int count, const std::function<void(int)> &fn);
+
+    // 默认线程数: CPU 核数
+    static int defaultThreadCount();
+
+private:
+    void workerLoop();
+
+    std::vector<std::thread> workers_;
+    std::deque<std::function<void()>> tasks_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    bool stop_ = false;
+};
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,373 @@
+#include "trace.h"
+
+#include <cstdio>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#include <thread>
+
+#include <QDebug>
+
+#define TRACE_MAX_DEAD_THREADS 16   // 已退出线程的计数区保留数量, 超出后合并进汇总并释放
+
+namespace {
+
+const int STAGE_COUNT = static_cast<int>(TraceStage::Count);
+
+// 桶上界(微秒), 最后一个桶不设上界; 16.7/33.3ms 对应 60/30fps 的帧间隔
+const int64_t bucketLimits[TRACE_BUCKETS] = {
+    100, 250, 500, 1000, 2000, 5000, 10000, 16667, 33333, 50000, 100000, INT64_MAX
+};
+
+const char *stageNames[STAGE_COUNT] = {
+    "dqbuf_wait", "decode", "convert", "rotate", "scale", "queue_wait", "paint"
+};
+
+// 只有所属线程写入, 用普通的读加写代替原子读改写
+inline void relaxedAdd(std::atomic<uint64_t> &counter, uint64_t value)
+{
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+// 信号处理函数只能使用这个描述符
+std::atomic<int> signalWakeFd{-1};
+
+} // namespace
+
+struct TraceEvent {
+    std::atomic<int64_t> startUs;
+    std::atomic<uint32_t> durUs;
+    std::atomic<uint8_t> stage;
+};
+
+// 线程的计数区, 只由所属线程写; 以 new ThreadData() 值初始化, 原子变量全部为 0
+struct Tracer::ThreadData {
+    int tid;
+    std::string name;                       // 受 mutex_ 保护
+    std::atomic<bool> exited;
+    std::atomic<uint64_t> count[STAGE_COUNT];
+    std::atomic<uint64_t> totalUs[STAGE_COUNT];
+    std::atomic<uint64_t> maxUs[STAGE_COUNT];
+    std::atomic<uint64_t> buckets[STAGE_COUNT][TRACE_BUCKETS];
+    std::atomic<TraceEvent*> events;        // 第一次记录事件时分配
+    std::atomic<uint64_t> written;          // 已写入的事件总数
+};
+
+uint64_t TraceHistogram::percentileUs(double p) const
+{
+    if (count == 0) return 0;
+    const uint64_t target = static_cast<uint64_t>(p * count + 0.5);
+    uint64_t seen = 0;
+    for (int b = 0; b < TRACE_BUCKETS - 1; b++) {
+        seen += buckets[b];
+        if (seen >= target && seen > 0) {
+            const uint64_t limit = static_cast<uint64_t>(Tracer::bucketLimitUs(b));
+            return limit < maxUs ? limit : maxUs;
+        }
+    }
+    return maxUs;
+}
+
+Tracer& Tracer::instance()
+{
+    static Tracer *tracer = new Tracer();
+    return *tracer;
+}
+
+Tracer::Tracer()
+{
+    for (int s = 0; s < STAGE_COUNT; s++) {
+        retired_[s] = TraceHistogram();
+        retired_[s].name = stageNames[s];
+    }
+}
+
+int64_t Tracer::nowUs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+const char *Tracer::stageName(TraceStage stage)
+{
+    const int s = static_cast<int>(stage);
+    return s >= 0 && s < STAGE_COUNT ? stageNames[s] : "unknown";
+}
+
+int64_t Tracer::bucketLimitUs(int bucket)
+{
+    return bucket >= 0 && bucket < TRACE_BUCKETS ? bucketLimits[bucket] : INT64_MAX;
+}
+
+Tracer::ThreadData *Tracer::threadData()
+{
+    // 线程退出时只做标记, 计数区留给汇总和写出使用, 之后登记新线程时再回收
+    struct Holder {
+        ThreadData *data = nullptr;
+        ~Holder() {
+            if (data) data->exited.store(true, std::memory_order_release);
+        }
+    };
+    static thread_local Holder holder;
+    if (!holder.data) {
+        ThreadData *data = new ThreadData();
+        data->tid = static_cast<int>(syscall(SYS_gettid));
+        std::lock_guard<std::mutex> lock(mutex_);
+        reclaimLocked();
+        threads_.push_back(data);
+        holder.data = data;
+    }
+    return holder.data;
+}
+
+// 已退出的线程过多时, 把最早的几个合并进 retired_ 并释放
+void Tracer::reclaimLocked()
+{
+    size_t dead = 0;
+    for (ThreadData *d : threads_) {
+        if (d->exited.load(std::memory_order_acquire)) dead++;
+    }
+    for (auto it = threads_.begin(); it != threads_.end() && dead > TRACE_MAX_DEAD_THREADS;) {
+        ThreadData *d = *it;
+        if (!d->exited.load(std::memory_order_acquire)) {
+            ++it;
+            continue;
+        }
+        for (int s = 0; s < STAGE_COUNT; s++) {
+            TraceHistogram &h = retired_[s];
+            h.count += d->count[s].load(std::memory_order_relaxed);
+            h.totalUs += d->totalUs[s].load(std::memory_order_relaxed);
+            const uint64_t maxUs = d->maxUs[s].load(std::memory_order_relaxed);
+            if (maxUs > h.maxUs) h.maxUs = maxUs;
+            for (int b = 0; b < TRACE_BUCKETS; b++) h.buckets[b] += d->buckets[s][b].load(std::memory_order_relaxed);
+        }
+        delete[] d->events.load(std::memory_order_acquire);
+        delete d;
+        it = threads_.erase(it);
+        dead--;
+    }
+}
+
+void Tracer::record(TraceStage stage, int64_t startUs, int64_t durUs)
+{
+    const int s = static_cast<int>(stage);
+    if (s < 0 || s >= STAGE_COUNT) return;
+    const uint64_t dur = durUs > 0 ? static_cast<uint64_t>(durUs) : 0;
+    Tracer &tracer = instance();
+    ThreadData *d = tracer.threadData();
+
+    relaxedAdd(d->count[s], 1);
+    relaxedAdd(d->totalUs[s], dur);
+    if (dur > d->maxUs[s].load(std::memory_order_relaxed)) d->maxUs[s].store(dur, std::memory_order_relaxed);
+    int b = 0;
+    while (b < TRACE_BUCKETS - 1 && static_cast<int64_t>(dur) > bucketLimits[b]) b++;
+    relaxedAdd(d->buckets[s][b], 1);
+
+    if (!tracer.eventsEnabled_.load(std::memory_order_relaxed)) return;
+    TraceEvent *events = d->events.load(std::memory_order_relaxed);
+    if (!events) {
+        events = new TraceEvent[TRACE_EVENTS_PER_THREAD]();
+        d->events.store(events, std::memory_order_release);
+    }
+    // 先写事件再发布计数; 写出时正被覆盖的最旧事件可能前后不一致, 只影响诊断数据
+    const uint64_t n = d->written.load(std::memory_order_relaxed);
+    TraceEvent &e = events[n % TRACE_EVENTS_PER_THREAD];
+    e.startUs.store(startUs, std::memory_order_relaxed);
+    e.durUs.store(static_cast<uint32_t>(dur), std::memory_order_relaxed);
+    e.stage.store(static_cast<uint8_t>(s), std::memory_order_relaxed);
+    d->written.store(n + 1, std::memory_order_release);
+}
+
+void Tracer::setThreadName(const char *name)
+{
+    Tracer &tracer = instance();
+    ThreadData *d = tracer.threadData();
+    {
+        std::lock_guard<std::mutex> lock(tracer.mutex_);
+        d->name = name;
+    }
+    // 主线程的名字就是 /proc/<pid>/comm, 改掉后 ps/pidof/killall 按程序名找不到进程, 只记录在 trace 中
+    if (syscall(SYS_gettid) == getpid()) return;
+    // 线程名最长 15 个字符, 同时便于 top/perf 区分
+    char shortName[16];
+    snprintf(shortName, sizeof(shortName), "%s", name);
+    pthread_setname_np(pthread_self(), shortName);
+}
+
+std::vector<TraceHistogram> Tracer::histograms()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<TraceHistogram> result(retired_, retired_ + STAGE_COUNT);
+    for (ThreadData *d : threads_) {
+        for (int s = 0; s < STAGE_COUNT; s++) {
+            TraceHistogram &h = result[s];
+            h.count += d->count[s].load(std::memory_order_relaxed);
+            h.totalUs += d->totalUs[s].load(std::memory_order_relaxed);
+            const uint64_t maxUs = d->maxUs[s].load(std::memory_order_relaxed);
+            if (maxUs > h.maxUs) h.maxUs = maxUs;
+            for (int b = 0; b < TRACE_BUCKETS; b++) h.buckets[b] += d->buckets[s][b].load(std::memory_order_relaxed);
+        }
+    }
+    return result;
+}
+
+void Tracer::logSummary()
+{
+    for (const TraceHistogram &h : histograms()) {
+        if (h.count == 0) continue;
+        qDebug() << "Trace:" << h.name << h.count << "samples, avg" << h.avgUs() << "us, p50 <="
+                 << h.percentileUs(0.5) << "us, p99 <=" << h.percentileUs(0.99) << "us, max" << h.maxUs << "us";
+    }
+}
+
+bool Tracer::dumpChromeTrace(const std::string &path, int seconds)
+{
+    struct Copied {
+        int tid;
+        std::string name;
+        std::vector<int64_t> start;
+        std::vector<uint32_t> dur;
+        std::vector<uint8_t> stage;
+    };
+    const int64_t since = nowUs() - static_cast<int64_t>(seconds) * 1000000;
+    std::vector<Copied> copied;
+    {
+        // 持锁期间线程计数区不会被回收; 各线程继续记录, 不受影响
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (ThreadData *d : threads_) {
+            TraceEvent *events = d->events.load(std::memory_order_acquire);
+            const uint64_t n = d->written.load(std::memory_order_acquire);
+            if (!events || n == 0) continue;
+            Copied c;
+            c.tid = d->tid;
+            c.name = d->name;
+            const uint64_t first = n > TRACE_EVENTS_PER_THREAD ? n - TRACE_EVENTS_PER_THREAD : 0;
+            for (uint64_t i = first; i < n; i++) {
+                const TraceEvent &e = events[i % TRACE_EVENTS_PER_THREAD];
+                const int64_t start = e.startUs.load(std::memory_order_relaxed);
+                if (start < since) continue;
+                c.start.push_back(start);
+                c.dur.push_back(e.durUs.load(std::memory_order_relaxed));
+                c.stage.push_back(e.stage.load(std::memory_order_relaxed));
+            }
+            copied.push_back(std::move(c));
+        }
+    }
+
+    FILE *file = fopen(path.c_str(), "w");
+    if (!file) {
+        perror("Failed to create trace file");
+        return false;
+    }
+    const int pid = static_cast<int>(getpid());
+    size_t total = 0;
+    bool first = true;
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for (const Copied &c : copied) {
+        if (!c.name.empty()) {
+            fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                    first ? "" : ",\n", pid, c.tid, c.name.c_str());
+            first = false;
+        }
+        for (size_t i = 0; i < c.start.size(); i++) {
+            const int stage = c.stage[i] < STAGE_COUNT ? c.stage[i] : 0;
+            fprintf(file, "%s{\"name\":\"%s\",\"cat\":\"pipeline\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,"
+                          "\"ts\":%lld,\"dur\":%u}",
+                    first ? "" : ",\n", stageNames[stage], pid, c.tid,
+                    static_cast<long long>(c.start[i]), c.dur[i]);
+            first = false;
+        }
+        total += c.start.size();
+    }
+    fprintf(file, "\n]}\n");
+    const bool ok = !ferror(file);
+    if (fclose(file) != 0 || !ok) {
+        perror("Failed to write trace file");
+        return false;
+    }
+    qDebug() << "Trace written to" << path.c_str() << total << "events," << copied.size() << "threads";
+    return true;
+}
+
+void Tracer::setDumpDirectory(const std::string &directory)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    dumpDirectory_ = directory;
+}
+
+void Tracer::startDumper()
+{
+    std::call_once(dumperOnce_, [this]() {
+        if (pipe2(wakeFd_, O_CLOEXEC) != 0) {
+            perror("Failed to create trace pipe");
+            return;
+        }
+        // 写端非阻塞: 连续触发时管道满了也不会卡住调用者
+        fcntl(wakeFd_[1], F_SETFL, fcntl(wakeFd_[1], F_GETFL) | O_NONBLOCK);
+        signalWakeFd = wakeFd_[1];
+        std::thread(&Tracer::dumpLoop, this).detach();
+    });
+}
+
+void Tracer::requestDump()
+{
+    startDumper();
+    if (wakeFd_[1] < 0) return;
+    const char byte = 'd';
+    if (write(wakeFd_[1], &byte, 1) < 0 && errno != EAGAIN) perror("Failed to request trace dump");
+}
+
+void Tracer::onSignal(int signo)
+{
+    (void)signo;
+    const int savedErrno = errno;
+    const int fd = signalWakeFd.load();
+    if (fd >= 0) {
+        const char byte = 'd';
+        ssize_t n = write(fd, &byte, 1);
+        (void)n;
+    }
+    errno = savedErrno;
+}
+
+void Tracer::installSignalHandler(int signo)
+{
+    startDumper();
+    struct sigaction sa;
+    sa.sa_handler = &Tracer::onSignal;
+    sigemptyset(&sa.sa_mask);
+    // 被打断的系统调用尽量自动重启; select/poll 等仍会返回 EINTR, 调用处需要处理
+    sa.sa_flags = SA_RESTART;
+    if (sigaction(signo, &sa, nullptr) != 0) {
+        perror("Failed to install trace signal handler");
+    }
+}
+
+// 写出线程: 每收到一个字节写出一次, 连续的请求合并
+void Tracer::dumpLoop()
+{
+    setThreadName("trace");
+    char buf[64];
+    while (true) {
+        const ssize_t n = read(wakeFd_[0], buf, sizeof(buf));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+
+        char stamp[32];
+        const time_t now = time(nullptr);
+        struct tm local;
+        localtime_r(&now, &local);
+        strftime(stamp, sizeof(stamp), "%Y%m%d%H%M%S", &local);
+        std::string path;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            path = dumpDirectory_ + "/trace_" + stamp + ".json";
+        }
+        dumpChromeTrace(path);
+        logSummary();
+    }
+}
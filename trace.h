@@ -0,0 +1,113 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <signal.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#define TRACE_BUCKETS 12                // 直方图桶数, 上界见 Tracer::bucketLimitUs
+#define TRACE_EVENTS_PER_THREAD 4096    // 每个线程保留的最近事件数(60fps 下约 10 秒以上)
+#define TRACE_DUMP_SECONDS 10           // requestDump 写出的时间范围
+
+// 被统计的处理阶段
+enum class TraceStage {
+    DqbufWait,  // 等待并出列采集缓冲区
+    Decode,     // 解码阶段: MJPG 解码 / YUYV、NV12 转出为 I420
+    Convert,    // 颜色转换
+    Rotate,     // 旋转 270 度
+    Scale,      // 缩放到显示尺寸
+    QueueWait,  // 在阶段之间的队列中等待
+    Paint,      // 预览控件绘制
+    Count
+};
+
+// 单个阶段的耗时直方图(所有线程合计)
+struct TraceHistogram {
+    const char *name;
+    uint64_t count;
+    uint64_t totalUs;
+    uint64_t maxUs;
+    uint64_t buckets[TRACE_BUCKETS];
+
+    double avgUs() const { return count ? static_cast<double>(totalUs) / count : 0; }
+    // 第 p(0-1) 分位所在桶的上界, 最后一个桶返回 maxUs
+    uint64_t percentileUs(double p) const;
+};
+
+/*
+ * 轻量埋点
+ * 每个线程第一次记录时登记一块自己的计数区: 计数器和固定分桶直方图只由本线程写(无锁, 无原子读改写), 读取时汇总各线程
+ * 同时把事件写入本线程的环形缓冲区, 运行中可把最近 TRACE_DUMP_SECONDS 秒写成 Chrome trace JSON(chrome://tracing 或 ui.perfetto.dev 打开)
+ * 每次记录为两次 CLOCK_MONOTONIC(vDSO)读取加几次普通存储, 60fps 下远低于 1% 的开销
+ * 写出由 requestDump() 或 SIGUSR1 触发, 在单独的线程中进行, 不影响流水线
+ */
+class Tracer {
+public:
+    static Tracer& instance();
+
+    // 当前时间(CLOCK_MONOTONIC 微秒), 与 V4L2 时间戳同一时钟
+    static int64_t nowUs();
+    // 记录一段耗时, startUs 为开始时间
+    static void record(TraceStage stage, int64_t startUs, int64_t durUs);
+    // 当前线程在 trace 中显示的名字, 建议在线程入口调用; 同时设为系统线程名, 主线程除外
+    static void setThreadName(const char *name);
+
+    static const char *stageName(TraceStage stage);
+    // 第 bucket 个桶的上界(微秒, 含)
+    static int64_t bucketLimitUs(int bucket);
+
+    // 是否记录事件(直方图始终记录), 默认开启
+    void setEventsEnabled(bool enable) { eventsEnabled_ = enable; }
+    bool eventsEnabled() const { return eventsEnabled_; }
+
+    std::vector<TraceHistogram> histograms();
+    void logSummary();
+
+    // 把最近 seconds 秒的事件写入 path
+    bool dumpChromeTrace(const std::string &path, int seconds = TRACE_DUMP_SECONDS);
+    // 请求在后台写出, 文件名为 trace_<时间>.json; 可在任意线程及信号处理函数中调用
+    void requestDump();
+    void setDumpDirectory(const std::string &directory);
+    // 收到 signo 时写出
+    void installSignalHandler(int signo = SIGUSR1);
+
+private:
+    struct ThreadData;
+
+    Tracer();
+    ~Tracer() = delete;     // 不析构, 程序退出时其他线程可能还在记录
+
+    ThreadData *threadData();
+    void reclaimLocked();
+    void startDumper();
+    void dumpLoop();
+    static void onSignal(int signo);
+
+    std::mutex mutex_;                  // 保护线程登记表和写出目录
+    std::vector<ThreadData*> threads_;
+    TraceHistogram retired_[static_cast<int>(TraceStage::Count)];  // 已回收线程的直方图
+    std::string dumpDirectory_ = ".";
+    std::atomic<bool> eventsEnabled_{true};
+    std::once_flag dumperOnce_;
+    int wakeFd_[2] = {-1, -1};          // 写一个字节唤醒写出线程, 信号处理函数中也可安全调用
+};
+
+// 作用域计时: 构造时记下开始时间, 析构时记录
+class TraceScope {
+public:
+    explicit TraceScope(TraceStage stage) : stage_(stage), start_(Tracer::nowUs()) {}
+    ~TraceScope() { Tracer::record(stage_, start_, Tracer::nowUs() - start_); }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    TraceStage stage_;
+    int64_t start_;
+};
+
+#endif // TRACE_H
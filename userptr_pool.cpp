@@ -0,0 +1,120 @@
+#include "userptr_pool.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <mutex>
+#include <vector>
+
+struct UserPtrPool::State {
+    mutable std::mutex mutex;
+    std::vector<void*> free;
+    size_t blockSize = 0;
+    int maxBlocks = 0;
+    int allocated = 0;
+    uint64_t generation = 0;        // reset/clear 后加一, 旧块归还时直接释放
+
+    void releaseFree()
+    {
+        for (void *p : free) ::free(p);
+        free.clear();
+    }
+};
+
+// 块释放时回到池中, 池已重建或销毁时直接 free
+struct UserPtrPool::Deleter {
+    std::weak_ptr<State> owner;
+    uint64_t generation;
+
+    void operator()(void *p) const
+    {
+        std::shared_ptr<State> state = owner.lock();
+        if (state) {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            if (state->generation == generation) {
+                state->free.push_back(p);
+                return;
+            }
+        }
+        ::free(p);
+    }
+};
+
+UserPtrPool::UserPtrPool()
+    : state_(std::make_shared<State>())
+{
+}
+
+UserPtrPool::~UserPtrPool()
+{
+    clear();
+}
+
+size_t UserPtrPool::roundToPage(size_t size)
+{
+    const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    return (size + page - 1) / page * page;
+}
+
+bool UserPtrPool::reset(size_t blockSize, int maxBlocks, int prealloc)
+{
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    state_->releaseFree();
+    state_->generation++;
+    state_->blockSize = roundToPage(blockSize);
+    state_->maxBlocks = maxBlocks;
+    state_->allocated = 0;
+    const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    for (int i = 0; i < prealloc && i < maxBlocks; i++) {
+        void *p = nullptr;
+        if (posix_memalign(&p, page, state_->blockSize) != 0) {
+            perror("Failed to allocate capture buffer");
+            return false;
+        }
+        state_->free.push_back(p);
+        state_->allocated++;
+    }
+    return true;
+}
+
+void UserPtrPool::clear()
+{
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    state_->releaseFree();
+    state_->generation++;
+    state_->maxBlocks = 0;
+    state_->allocated = 0;
+}
+
+std::shared_ptr<void> UserPtrPool::take()
+{
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    void *p = nullptr;
+    if (!state_->free.empty()) {
+        p = state_->free.back();
+        state_->free.pop_back();
+    } else if (state_->allocated < state_->maxBlocks) {
+        const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        if (posix_memalign(&p, page, state_->blockSize) != 0) return std::shared_ptr<void>();
+        state_->allocated++;
+    } else {
+        return std::shared_ptr<void>();
+    }
+    Deleter deleter;
+    deleter.owner = state_;
+    deleter.generation = state_->generation;
+    return std::shared_ptr<void>(p, deleter);
+}
+
+size_t UserPtrPool::blockSize() const
+{
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    return state_->blockSize;
+}
+
+int UserPtrPool::allocated() const
+{
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    return state_->allocated;
+}
@@ -0,0 +1,42 @@
+#ifndef USERPTR_POOL_H
+#define USERPTR_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <memory>
+
+/*
+ * USERPTR 采集缓冲区池
+ * 所有块大小相同, 按页对齐分配(同时满足缓存行对齐和驱动固定用户页的要求)
+ * take() 返回的 shared_ptr 最后一个引用释放时把内存还给池, 稳定运行时不再分配
+ * 块总数有上限, 用尽时 take() 返回空, 调用者改为拷贝; 池析构或 reset 后归还的旧块直接 free
+ */
+class UserPtrPool {
+public:
+    UserPtrPool();
+    ~UserPtrPool();
+
+    UserPtrPool(const UserPtrPool&) = delete;
+    UserPtrPool& operator=(const UserPtrPool&) = delete;
+
+    // 按新的块大小重建池, 预先分配 prealloc 块, 块总数不超过 maxBlocks
+    bool reset(size_t blockSize, int maxBlocks, int prealloc);
+    // 释放全部空闲块, 之后 take() 返回空
+    void clear();
+    std::shared_ptr<void> take();
+
+    size_t blockSize() const;
+    // 已分配的块数(含使用中的)
+    int allocated() const;
+
+    // 对齐后的块大小
+    static size_t roundToPage(size_t size);
+
+private:
+    struct State;
+    struct Deleter;
+
+    std::shared_ptr<State> state_;
+};
+
+#endif // USERPTR_POOL_H
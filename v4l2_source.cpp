@@ -0,0 +1,514 @@
+#include "v4l2_source.h"
+
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/select.h>
+#include <cstring>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <QDebug>
+
+V4L2Source::V4L2Source(bool is_M)
+    : fd(-1), type(is_M ? V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE : V4L2_BUF_TYPE_VIDEO_CAPTURE)
+{
+}
+
+V4L2Source::~V4L2Source()
+{
+    close();
+}
+
+int V4L2Source::open(const QString &deviceName)
+{
+    // 1.打开设备
+    fd = ::open(deviceName.toLocal8Bit().constData(), O_RDWR);
+    if (fd < 0) {
+        // 打开设备失败
+        qDebug() << "Failed to open device" << deviceName;
+        return -1;
+    }
+
+    return 0;
+}
+
+int V4L2Source::setFormat(uint32_t width, uint32_t height, uint32_t fourcc)
+{
+    struct v4l2_format format;
+    std::memset(&format, 0, sizeof(format));
+
+    // 2.配置设备
+    format.type = type;
+
+    format.fmt.pix.width = width;
+    format.fmt.pix.height = height;
+    format.fmt.pix.pixelformat = fourcc;
+    format.fmt.pix.field = V4L2_FIELD_NONE;
+    if (ioctl(fd, VIDIOC_S_FMT, &format) == -1) {
+        perror("Failed to set video format");
+        ::close(fd);
+        fd = -1;
+        return -1;
+    }
+    frameBytes = 0;
+    if (type == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE) {
+        for (int plane = 0; plane < format.fmt.pix_mp.num_planes && plane < FMT_NUM_PLANES; plane++) {
+            frameBytes += format.fmt.pix_mp.plane_fmt[plane].sizeimage;
+        }
+    } else {
+        frameBytes = format.fmt.pix.sizeimage;
+    }
+
+    struct v4l2_streamparm streamparm;
+    std::memset(&streamparm, 0, sizeof(streamparm));
+    streamparm.type = type;
+    streamparm.parm.capture.timeperframe.numerator = 1;
+    streamparm.parm.capture.timeperframe.denominator = 30; // 30FPS
+
+    if (ioctl(fd, VIDIOC_S_PARM, &streamparm) < 0) {
+        perror("Failed to set frame rate");
+    }
+
+
+    // 验证帧率设置
+    if (ioctl(fd, VIDIOC_G_PARM, &streamparm) == 0) {
+        printf("Frame rate is now %d/%d FPS\n",
+            streamparm.parm.capture.timeperframe.numerator,
+            streamparm.parm.capture.timeperframe.denominator);
+    }
+    return 0;
+}
+
+bool V4L2Source::frameInterval(uint32_t &numerator, uint32_t &denominator)
+{
+    struct v4l2_streamparm streamparm;
+    std::memset(&streamparm, 0, sizeof(streamparm));
+    streamparm.type = type;
+    if (fd < 0 || ioctl(fd, VIDIOC_G_PARM, &streamparm) != 0
+        || streamparm.parm.capture.timeperframe.numerator == 0
+        || streamparm.parm.capture.timeperframe.denominator == 0) {
+        return false;
+    }
+    numerator = streamparm.parm.capture.timeperframe.numerator;
+    denominator = streamparm.parm.capture.timeperframe.denominator;
+    return true;
+}
+
+int V4L2Source::initBuffers(video_buf_t *bufs, int maxCount)
+{
+    if (type != V4L2_BUF_TYPE_VIDEO_CAPTURE && type != V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE) {
+        perror("Unsupported buffer type");
+        return -1;
+    }
+    framebuf = bufs;
+
+    // 先尝试 USERPTR, 驱动不接受时退回 MMAP
+    int ret = -1;
+    if (userPtr) {
+        memory = V4L2_MEMORY_USERPTR;
+        count = maxCount;
+        std::memset(framebuf, 0, sizeof(video_buf_t) * count);
+        ret = (type == V4L2_BUF_TYPE_VIDEO_CAPTURE) ? initSinglePlaneBuffers() : initMultiPlaneBuffers();
+        if (ret < 0) {
+            qDebug() << "USERPTR capture not supported, falling back to MMAP";
+        } else {
+            qDebug() << "Capturing into" << count << "USERPTR buffers of" << pool.blockSize() << "bytes";
+        }
+    }
+    if (ret < 0) {
+        memory = V4L2_MEMORY_MMAP;
+        count = maxCount;
+        // 映射失败时按 start/plane_count 清理, 先全部清零
+        std::memset(framebuf, 0, sizeof(video_buf_t) * count);
+        ret = (type == V4L2_BUF_TYPE_VIDEO_CAPTURE) ? initSinglePlaneBuffers() : initMultiPlaneBuffers();
+    }
+    return ret < 0 ? -1 : count;
+}
+
+// USERPTR: 按驱动要求的 sizeimage 从池中为每个缓冲区的每个平面取一块内存
+bool V4L2Source::allocUserBuffers(int planes)
+{
+    struct v4l2_format format;
+    std::memset(&format, 0, sizeof(format));
+    format.type = type;
+    if (ioctl(fd, VIDIOC_G_FMT, &format) == -1) {
+        perror("Failed to get video format");
+        return false;
+    }
+    size_t sizes[MAX_PLANES] = {0};
+    if (type == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE) {
+        planes = format.fmt.pix_mp.num_planes;
+        if (planes < 1 || planes > FMT_NUM_PLANES) return false;
+        for (int plane = 0; plane < planes; plane++) sizes[plane] = format.fmt.pix_mp.plane_fmt[plane].sizeimage;
+    } else {
+        sizes[0] = format.fmt.pix.sizeimage;
+    }
+    size_t blockSize = 0;
+    for (int plane = 0; plane < planes; plane++) {
+        if (sizes[plane] == 0) return false;
+        if (sizes[plane] > blockSize) blockSize = sizes[plane];
+    }
+
+    // 驱动占用 count 组, 另有 USERPTR_SPARE_BUFFERS 块供摘下的帧替换
+    if (!pool.reset(blockSize, count * planes + USERPTR_SPARE_BUFFERS, count * planes)) return false;
+    blocks.assign(count * MAX_PLANES, std::shared_ptr<void>());
+    replacements.assign(count * MAX_PLANES, std::shared_ptr<void>());
+    for (int num = 0; num < count; num++) {
+        framebuf[num].plane_count = planes;
+        for (int plane = 0; plane < planes; plane++) {
+            blocks[num * MAX_PLANES + plane] = pool.take();
+            if (!blocks[num * MAX_PLANES + plane]) return false;
+            framebuf[num].fm[plane].start = blocks[num * MAX_PLANES + plane].get();
+            framebuf[num].fm[plane].length = sizes[plane];
+        }
+    }
+    return true;
+}
+
+// 释放已申请的缓冲区; USERPTR 失败后用 count 0 的 REQBUFS 让驱动放开, 才能改用 MMAP
+void V4L2Source::releaseBuffers()
+{
+    unmapBuffers();
+    if (memory == V4L2_MEMORY_USERPTR) {
+        struct v4l2_requestbuffers req;
+        std::memset(&req, 0, sizeof(req));
+        req.count = 0;
+        req.type = type;
+        req.memory = memory;
+        ioctl(fd, VIDIOC_REQBUFS, &req);
+        pool.clear();
+    } else {
+        ::close(fd);
+        fd = -1;
+    }
+}
+
+// 单面
+int V4L2Source::initSinglePlaneBuffers(){
+    struct v4l2_requestbuffers req;
+    struct v4l2_buffer buffer;
+    std::memset(&req, 0, sizeof(req));
+    req.count = count;
+    req.type = type;
+    req.memory = memory;
+
+    if (ioctl(fd, VIDIOC_REQBUFS, &req) == -1 || req.count == 0) {
+        perror("Failed to request buffers");
+        releaseBuffers();
+        return -1;
+    }
+    // 驱动可能只给出部分缓冲区, 之后一律按实际数量处理
+    if (static_cast<int>(req.count) < count) {
+        qDebug() << "Driver granted" << req.count << "of" << count << "buffers";
+        count = req.count;
+    }
+    if (memory == V4L2_MEMORY_USERPTR && !allocUserBuffers(1)) goto cleanup;
+
+    for (int num = 0; num < count; num++) {
+        std::memset(&buffer, 0, sizeof(buffer));
+        buffer.type = type;
+        buffer.memory = memory;
+        buffer.index = num;
+
+        if (memory == V4L2_MEMORY_USERPTR) {
+            buffer.m.userptr = reinterpret_cast<unsigned long>(framebuf[num].fm[0].start);
+            buffer.length = pool.blockSize();
+        } else {
+            if (ioctl(fd, VIDIOC_QUERYBUF, &buffer) == -1) {
+                perror("Failed to query buffer");
+                goto cleanup;
+            }
+
+            framebuf[num].plane_count = 1;
+            framebuf[num].fm[0].start = mmap(NULL, buffer.length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, buffer.m.offset);
+            if (framebuf[num].fm[0].start == MAP_FAILED) {
+                perror("Failed to map buffer");
+                goto cleanup;
+            }
+            framebuf[num].fm[0].length = buffer.length;
+        }
+
+        if (ioctl(fd, VIDIOC_QBUF, &buffer) == -1) {
+            perror("Failed to queue buffer");
+            goto cleanup;
+        }
+    }
+
+    if (ioctl(fd, VIDIOC_STREAMON, &buffer.type) == -1) {
+        perror("Failed to start streaming");
+        goto cleanup;
+    }
+
+    return 0;
+
+cleanup:
+    releaseBuffers();
+    return -1;
+}
+// 多面
+int V4L2Source::initMultiPlaneBuffers() {
+    struct v4l2_requestbuffers req;
+    struct v4l2_buffer buffer;
+    std::memset(&req, 0, sizeof(req));
+    req.count = count;
+    req.type = type;
+    req.memory = memory;
+
+    if (ioctl(fd, VIDIOC_REQBUFS, &req) < 0 || req.count == 0) {
+        perror("Failed to request buffers");
+        releaseBuffers();
+        return -1;
+    }
+    if (static_cast<int>(req.count) < count) {
+        qDebug() << "Driver granted" << req.count << "of" << count << "buffers";
+        count = req.count;
+    }
+
+    if (memory == V4L2_MEMORY_USERPTR) {
+        if (!allocUserBuffers(FMT_NUM_PLANES)) goto cleanup;
+    } else {
+        for (int num = 0; num < count; num++) {
+            struct v4l2_plane planes[FMT_NUM_PLANES];
+            std::memset(&planes, 0, sizeof(planes));
+            std::memset(&buffer, 0, sizeof(buffer));
+
+            buffer.type = type;
+            buffer.memory = V4L2_MEMORY_MMAP;
+            buffer.index = num;
+            buffer.length = FMT_NUM_PLANES;
+            buffer.m.planes = planes;
+
+            // 查询缓冲区
+            if (ioctl(fd, VIDIOC_QUERYBUF, &buffer) == -1) {
+                perror("Failed to query buffer");
+                goto cleanup;
+            }
+
+            framebuf[num].plane_count = buffer.length;  // 实际平面数量
+
+            for (int plane = 0; plane < framebuf[num].plane_count; plane++) {
+                framebuf[num].fm[plane].length = buffer.m.planes[plane].length;
+                framebuf[num].fm[plane].start = mmap(
+                    NULL, framebuf[num].fm[plane].length, PROT_READ | PROT_WRITE,
+                    MAP_SHARED, fd, buffer.m.planes[plane].m.mem_offset);
+
+                if (framebuf[num].fm[plane].start == MAP_FAILED) {
+                    perror("Failed to map plane buffer");
+                    goto cleanup;
+                }
+            }
+        }
+    }
+
+    // 将所有缓冲区加入队列
+    for (int num = 0; num < count; num++) {
+        struct v4l2_plane planes[FMT_NUM_PLANES];
+        std::memset(&planes, 0, sizeof(planes));
+        std::memset(&buffer, 0, sizeof(buffer));
+
+        buffer.type = type;
+        buffer.memory = memory;
+        buffer.index = num;
+        buffer.m.planes = planes;
+        buffer.length = FMT_NUM_PLANES;
+        if (memory == V4L2_MEMORY_USERPTR) {
+            for (int plane = 0; plane < framebuf[num].plane_count; plane++) {
+                planes[plane].m.userptr = reinterpret_cast<unsigned long>(framebuf[num].fm[plane].start);
+                planes[plane].length = pool.blockSize();
+            }
+        }
+
+        if (ioctl(fd, VIDIOC_QBUF, &buffer) == -1) {
+            perror("Failed to queue buffer");
+            goto cleanup;
+        }
+    }
+
+    if (ioctl(fd, VIDIOC_STREAMON, &buffer.type) == -1) {
+        perror("Failed to start streaming");
+        goto cleanup;
+    }
+
+    return 0;
+
+cleanup:
+    releaseBuffers();
+    return -1;
+}
+
+int V4L2Source::dequeue(CapturedFrame &frame, int timeoutMs)
+{
+    // 初始化结构体
+    struct v4l2_buffer buffer;
+    struct v4l2_plane planes[FMT_NUM_PLANES];
+    memset(planes, 0, sizeof(planes));
+    memset(&buffer, 0, sizeof(buffer));
+    buffer.type = type;
+    buffer.memory = memory;
+
+    if (V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE == type) {
+        buffer.m.planes = planes;
+        buffer.length = FMT_NUM_PLANES;
+    }
+
+    // 监视文件超时
+    struct timeval tv;
+    tv.tv_sec = timeoutMs / 1000;
+    tv.tv_usec = (timeoutMs % 1000) * 1000;
+    fd_set fds;
+    FD_ZERO(&fds);
+    FD_SET(fd, &fds);
+
+    int r = select(fd + 1, &fds, NULL, NULL, &tv);
+    if (r == -1) {
+        // 被信号打断(如 SIGUSR1 触发 trace 写出)时由调用者继续等待
+        if (errno == EINTR) return 0;
+        perror("select");
+        return -1;
+    } else if (r == 0) {
+        qDebug() << "Timeout waiting for buffer";
+        return 0;
+    }
+    // 出列
+    if (ioctl(fd, VIDIOC_DQBUF, &buffer) == -1) {
+        if (errno == EINTR || errno == EAGAIN) return 0;
+        perror("Failed to dequeue buffer");
+        return -1;
+    }
+
+    frame.index = buffer.index;
+    frame.sequence = buffer.sequence;
+    frame.flags = buffer.flags;
+    // 只有单调时钟的时间戳可以直接使用
+    if ((buffer.flags & V4L2_BUF_FLAG_TIMESTAMP_MASK) == V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC
+        && (buffer.timestamp.tv_sec != 0 || buffer.timestamp.tv_usec != 0)) {
+        frame.timestampUs = static_cast<int64_t>(buffer.timestamp.tv_sec) * 1000000 + buffer.timestamp.tv_usec;
+    } else {
+        frame.timestampUs = 0;
+    }
+    // 记录有效数据长度, MJPG 帧远小于映射长度
+    memset(frame.bytesused, 0, sizeof(frame.bytesused));
+    if (V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE == type) {
+        for (int plane = 0; plane < static_cast<int>(buffer.length) && plane < FMT_NUM_PLANES; plane++) {
+            frame.bytesused[plane] = planes[plane].bytesused;
+        }
+    } else {
+        frame.bytesused[0] = buffer.bytesused;
+    }
+    return 1;
+}
+
+// 将缓冲区归还给驱动
+void V4L2Source::requeue(int index)
+{
+    if (fd < 0 || index < 0 || index >= count) return;
+
+    struct v4l2_buffer qbuf;
+    struct v4l2_plane planes[FMT_NUM_PLANES];
+    memset(planes, 0, sizeof(planes));
+    memset(&qbuf, 0, sizeof(qbuf));
+    qbuf.type = type;
+    qbuf.index = index;
+    qbuf.memory = memory;
+
+    if (V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE == type) {
+        qbuf.m.planes = planes;
+        qbuf.length = FMT_NUM_PLANES;
+    }
+    if (memory == V4L2_MEMORY_USERPTR) {
+        video_buf_t &vb = framebuf[index];
+        for (int plane = 0; plane < vb.plane_count; plane++) {
+            // 这一帧已被摘下, 换上预留的内存再交给驱动
+            std::shared_ptr<void> &replacement = replacements[index * MAX_PLANES + plane];
+            if (replacement) {
+                blocks[index * MAX_PLANES + plane] = std::move(replacement);
+                replacement.reset();
+                vb.fm[plane].start = blocks[index * MAX_PLANES + plane].get();
+            }
+            const unsigned long userptr = reinterpret_cast<unsigned long>(vb.fm[plane].start);
+            if (V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE == type) {
+                planes[plane].m.userptr = userptr;
+                planes[plane].length = pool.blockSize();
+            } else {
+                qbuf.m.userptr = userptr;
+                qbuf.length = pool.blockSize();
+            }
+        }
+    }
+    if (ioctl(fd, VIDIOC_QBUF, &qbuf) == -1) {
+        perror("Failed to queue buffer");
+    }
+}
+
+bool V4L2Source::detachBuffer(int index, std::shared_ptr<void> planes[MAX_PLANES])
+{
+    if (memory != V4L2_MEMORY_USERPTR || index < 0 || index >= count) return false;
+
+    // 先取齐替换用的内存, 池用尽时不摘
+    const int planeCount = framebuf[index].plane_count;
+    std::shared_ptr<void> fresh[MAX_PLANES];
+    for (int plane = 0; plane < planeCount; plane++) {
+        fresh[plane] = pool.take();
+        if (!fresh[plane]) return false;
+    }
+    for (int plane = 0; plane < planeCount; plane++) {
+        planes[plane] = blocks[index * MAX_PLANES + plane];
+        replacements[index * MAX_PLANES + plane] = std::move(fresh[plane]);
+    }
+    return true;
+}
+
+// 导出驱动缓冲区的一个平面为 dmabuf fd, 消费者可直接映射或交给 RGA/编码器
+int V4L2Source::exportBuffer(int index, int plane)
+{
+    if (fd < 0 || index < 0 || index >= count) return -1;
+
+    struct v4l2_exportbuffer expbuf;
+    memset(&expbuf, 0, sizeof(expbuf));
+    expbuf.type = type;
+    expbuf.index = index;
+    expbuf.plane = plane;
+    expbuf.flags = O_CLOEXEC | O_RDONLY;
+    if (ioctl(fd, VIDIOC_EXPBUF, &expbuf) == -1) {
+        perror("Failed to export buffer");
+        return -1;
+    }
+    return expbuf.fd;
+}
+
+void V4L2Source::unmapBuffers()
+{
+    // USERPTR 的内存归池所有, 摘下的帧在调用者释放后回收
+    blocks.clear();
+    replacements.clear();
+    if (framebuf == nullptr) return;
+    for (int i = 0; i < count; i++) {
+        for (int plane = 0; plane < framebuf[i].plane_count && plane < MAX_PLANES; plane++) {
+            if (memory == V4L2_MEMORY_MMAP && framebuf[i].fm[plane].start && framebuf[i].fm[plane].start != MAP_FAILED) {
+                munmap(framebuf[i].fm[plane].start, framebuf[i].fm[plane].length);
+            }
+            framebuf[i].fm[plane].start = nullptr; // 释放映射后，避免再次操作
+        }
+    }
+}
+
+int V4L2Source::close()
+{
+    if (fd < 0) return -1;
+    // 停止采集并释放映射
+    int buf_type = type;
+    if (ioctl(fd, VIDIOC_STREAMOFF, &buf_type) == -1) {
+        perror("Failed to stop streaming");
+    }
+    unmapBuffers();
+    pool.clear();
+    framebuf = nullptr;
+    count = 0;
+
+    // 关闭设备
+    ::close(fd);
+    fd = -1;
+    return 0;
+}
@@ -0,0 +1,58 @@
+#ifndef V4L2_SOURCE_H
+#define V4L2_SOURCE_H
+
+#include <linux/videodev2.h>
+#include <memory>
+#include <vector>
+
+#include "capture_source.h"
+#include "userptr_pool.h"
+
+#define FMT_NUM_PLANES 2
+#define USERPTR_SPARE_BUFFERS 8     // USERPTR 池中供摘下的帧替换的备用块数, 用尽时拍照/连拍改为拷贝
+
+/*
+ * V4L2 设备采集源
+ * 默认先尝试 USERPTR: 驱动直接写入 UserPtrPool 中页对齐的内存, 帧可以通过 detachBuffer 摘下长期持有,
+ * 归还时换上池中另一块内存, 不拷贝; 驱动不支持时自动退回 MMAP
+ * MMAP 方式: REQBUFS 后把驱动缓冲区映射到 video_buf_t, DQBUF/QBUF 交换索引
+ * is_M 为 true 时按多平面(V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE)方式使用设备
+ */
+class V4L2Source : public CaptureSource {
+public:
+    explicit V4L2Source(bool is_M);
+    ~V4L2Source() override;
+
+    int open(const QString &deviceName) override;
+    int setFormat(uint32_t width, uint32_t height, uint32_t fourcc) override;
+    int initBuffers(video_buf_t *bufs, int maxCount) override;
+    int dequeue(CapturedFrame &frame, int timeoutMs) override;
+    void requeue(int index) override;
+    int close() override;
+    bool frameInterval(uint32_t &numerator, uint32_t &denominator) override;
+    bool multiPlane() const override { return type == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE; }
+    size_t frameSize() const override { return frameBytes; }
+    int exportBuffer(int index, int plane) override;
+    void preferUserPtr(bool enable) override { userPtr = enable; }
+    bool detachBuffer(int index, std::shared_ptr<void> planes[MAX_PLANES]) override;
+
+private:
+    int initSinglePlaneBuffers();
+    int initMultiPlaneBuffers();
+    bool allocUserBuffers(int planes);
+    void releaseBuffers();
+    void unmapBuffers();
+
+    int fd;
+    v4l2_buf_type type;
+    v4l2_memory memory = V4L2_MEMORY_MMAP;
+    bool userPtr = true;                // 优先尝试 USERPTR
+    video_buf_t *framebuf = nullptr;    // 映射结果写入调用者的数组
+    int count = 0;
+    size_t frameBytes = 0;              // 驱动给出的 sizeimage(多平面时为各平面之和)
+    UserPtrPool pool;
+    std::vector<std::shared_ptr<void>> blocks;          // [index * MAX_PLANES + plane] 当前交给驱动的内存
+    std::vector<std::shared_ptr<void>> replacements;    // 摘下的帧归还时换上的内存
+};
+
+#endif // V4L2_SOURCE_H
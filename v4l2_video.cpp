@@ -2,35 +2,107 @@
 #include <QImageReader>
 #include <QBuffer>
 
-#include <sys/mman.h>
+#include <cmath>
 #include <cstring>
 #include <cstdlib>
 #include <unistd.h>
 #include <fcntl.h>
-
-#include <turbojpeg.h>
-
-#define BUFCOUNT 24
-#define FMT_NUM_PLANES 2
+#include <time.h>
+
+#include "jpeg_decoder.h"
+#include "frame_transform.h"
+#include "frame_pool.h"
+#include "jpeg_still.h"
+#include "jpeg_encoder.h"
+#include "trace.h"
+#include "v4l2_source.h"
+
+#define CAPTURE_MAX_BUFFERS 32  // 缓冲区数组容量, 与 VIDEO_MAX_FRAME 相同
+#define CAPTURE_MIN_BUFFERS 4   // 驱动填充 + 排队 + 处理中, 再少就会持续丢帧
+#define ASSUMED_FPS 30          // 取不到帧间隔时按此估算
+#define INDEX_QUEUE_LEN 10  // 待处理索引队列长度
+#define DISPLAY_QUEUE_LEN 1 // 待显示帧只保留最新一帧, 旧帧直接替换
+#define STAGE_QUEUE_LEN 2   // 流水线阶段之间的队列长度
+#define SPARE_FRAME_LEN 8   // 回收帧数量上限
+#define STILL_QUEUE_LEN 32  // 待解码的拍照帧数量上限, 另受连拍内存预算限制
+#define RECORD_MAX_INFLIGHT 2 // 同时在线程池中编码的录像帧上限, 超出时丢帧
+
+typedef std::chrono::steady_clock Clock;
 
 inline int clamp(int value, int min, int max)
 {
     return std::max(min, std::min(value, max));
 }
 
-v4l2_buf_type type;
-Vvideo::Vvideo(const bool& is_M_, QLabel *Label, QObject *parent)
-    : fd(-1), is_M(is_M_), displayLabel(Label)
+// 与 V4L2 单调时间戳同一时钟
+static int64_t monotonicUs()
 {
-    type = is_M ? V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE : V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    framebuf = new video_buf_t[BUFCOUNT];
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
 
+static uint64_t elapsedUs(Clock::time_point from, Clock::time_point to)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(to - from).count();
+}
+
+// 在阶段间队列中等待的时间计入 trace; steady_clock 与 CLOCK_MONOTONIC 同源, 以当前时间倒推开始时间
+static void recordQueueWait(Clock::time_point queuedAt, Clock::time_point start)
+{
+    const int64_t waitUs = static_cast<int64_t>(elapsedUs(queuedAt, start));
+    const int64_t nowUs = Tracer::nowUs();
+    Tracer::record(TraceStage::QueueWait, nowUs - waitUs, waitUs);
+}
+
+// 解码阶段的输入是缓冲区索引, 不统计排队时间
+template <typename T>
+static StageStats makeStageStats(const char *name, RingQueue<T> &queue, const StageCounter &counter)
+{
+    StageStats st;
+    st.name = name;
+    st.queued = queue.size();
+    st.capacity = queue.capacity();
+    st.dropped = queue.dropped();
+    st.frames = counter.frames;
+    st.avgWaitUs = st.frames ? static_cast<double>(counter.waitUs) / st.frames : 0;
+    st.avgProcessUs = st.frames ? static_cast<double>(counter.processUs) / st.frames : 0;
+    return st;
+}
+
+Vvideo::Vvideo(const bool& is_M_, PreviewWidget *preview, QObject *parent)
+    : Vvideo(std::unique_ptr<CaptureSource>(new V4L2Source(is_M_)), preview, parent)
+{
+}
+
+Vvideo::Vvideo(std::unique_ptr<CaptureSource> source, PreviewWidget *preview, QObject *parent)
+    : source_(std::move(source)), displayWidget(preview),
+      frameIndexQueue(INDEX_QUEUE_LEN, OverflowPolicy::DropOldest),
+      displayFrames(DISPLAY_QUEUE_LEN, OverflowPolicy::DropOldest),
+      decodedFrames(STAGE_QUEUE_LEN, OverflowPolicy::Block),
+      renderedFrames(STAGE_QUEUE_LEN, OverflowPolicy::Block),
+      spareFrames(SPARE_FRAME_LEN, OverflowPolicy::DropNewest),
+      stillJobs(STILL_QUEUE_LEN, OverflowPolicy::DropNewest),
+      recordSpare_(RECORD_MAX_INFLIGHT + 1, OverflowPolicy::DropNewest)
+{
+    framebuf = new video_buf_t[CAPTURE_MAX_BUFFERS]();
+    bufferRefs_.reset(new std::atomic<int>[CAPTURE_MAX_BUFFERS]);
+    for (int i = 0; i < CAPTURE_MAX_BUFFERS; i++) bufferRefs_[i] = 0;
+    // 在 UI 线程构造, 此时可以查询屏幕
+    outputFormat_ = PreviewWidget::nativeFormat();
+    recorder_.setFinishedCallback([this](const std::string &path, bool ok) {
+        emit recordingFinished(QString::fromLocal8Bit(path.c_str()), ok);
+    });
 }
 
 Vvideo::~Vvideo(){
-    quit_ = 1;
-    if (captureThread_.joinable()) captureThread_.join();
-    if (processThread_.joinable()) processThread_.join();
+    // 各阶段线程由 run() 启动并在返回前 join, 调用者保证 run() 已返回
+    stop();
+    // 录像收尾会发出信号, 在对象析构前结束
+    recorder_.stop();
+    recorder_.wait();
+    // 先断开导出的消费者, 之后不会再有归还回调
+    exporter_.reset();
     closeDevice();
 
     // 释放缓冲区
@@ -43,410 +115,488 @@ Vvideo::~Vvideo(){
 int Vvideo::openDevice(const QString& deviceName)
 {
     // 1.打开设备
-    fd = open(deviceName.toLocal8Bit().constData(), O_RDWR);
-    if (fd < 0) {
-        // 打开设备失败
-        qDebug() << "Failed to open device" << deviceName;
-        return -1;
-    }
-
-    return 0;
+    return source_->open(deviceName);
 }
 
 int Vvideo::setFormat(const __u32 &w_, const __u32 &h_, const __u32 &fmt_)
-{   
-    struct v4l2_format format;
-    std::memset(&format, 0, sizeof(format));
-
+{
     // 2.配置设备
-    format.type = type;
-
-    format.fmt.pix.width = w_;
-    format.fmt.pix.height = h_;
-    format.fmt.pix.pixelformat = fmt_;
-    format.fmt.pix.field = V4L2_FIELD_NONE;
-    if (ioctl(fd, VIDIOC_S_FMT, &format) == -1) {
-        perror("Failed to set video format");
-        close(fd);
-        return -1;
-    }
+    if (source_->setFormat(w_, h_, fmt_) < 0) return -1;
     w = w_;
     h = h_;
     fmt = fmt_;
     qDebug() <<w <<h <<fmt;
-
-    struct v4l2_streamparm streamparm;
-    std::memset(&streamparm, 0, sizeof(streamparm));
-    streamparm.type = type;
-    streamparm.parm.capture.timeperframe.numerator = 1;
-    streamparm.parm.capture.timeperframe.denominator = 30; // 30FPS
-
-    if (ioctl(fd, VIDIOC_S_PARM, &streamparm) < 0) {
-        perror("Failed to set frame rate");
-    }
-
-
-    // 验证帧率设置
-    if (ioctl(fd, VIDIOC_G_PARM, &streamparm) == 0) {
-        printf("Frame rate is now %d/%d FPS\n",
-            streamparm.parm.capture.timeperframe.numerator,
-            streamparm.parm.capture.timeperframe.denominator);
-    }
     return 0;
 }
 
-int Vvideo::initBuffers() {
-    for (int num = 0; num < BUFCOUNT; num++) {
-        framebuf[num].fm[0].in_use = false;  // 初始状态未使用
-    }
-    
-    if (type == V4L2_BUF_TYPE_VIDEO_CAPTURE) {
-        return initSinglePlaneBuffers();
-    } else if (type == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE) {
-        return initMultiPlaneBuffers();
-    } else {
-        perror("Unsupported buffer type");
-        return -1;
+// 按延迟/内存预算估算采集缓冲区数
+int Vvideo::captureBufferTarget()
+{
+    uint32_t numerator = 0, denominator = 0;
+    double fps = ASSUMED_FPS;
+    if (source_->frameInterval(numerator, denominator)) fps = static_cast<double>(denominator) / numerator;
+    size_t frameBytes = source_->frameSize();
+    if (frameBytes == 0) frameBytes = static_cast<size_t>(w) * h * 2;
+
+    int count = static_cast<int>(std::ceil(fps * captureDepthMs_ / 1000.0)) + 1;
+    // MJPG 按帧并行解码时每个工作线程各占一帧, 导出的消费者各自还会多持有几帧
+    if (workerThreads_ > 1 && isMjpgStream()) count += workerThreads_ - 1;
+    if (exporter_) count += EXPORT_MAX_HELD;
+    count = std::max(count, CAPTURE_MIN_BUFFERS);
+    const size_t affordable = frameBytes > 0 ? captureBudget_ / frameBytes : count;
+    if (static_cast<size_t>(count) > affordable) {
+        qDebug() << "Capture memory budget" << captureBudget_ / 1024 << "KB allows" << affordable
+                 << "buffers of" << frameBytes / 1024 << "KB, wanted" << count;
+        count = std::max(static_cast<int>(affordable), CAPTURE_MIN_BUFFERS);
     }
+    return std::min(count, CAPTURE_MAX_BUFFERS);
 }
-// 单面
-int Vvideo::initSinglePlaneBuffers(){
-    struct v4l2_requestbuffers req;
-    std::memset(&req, 0, sizeof(req));
-    req.count = BUFCOUNT;
-    req.type = type;
-    req.memory = V4L2_MEMORY_MMAP;
 
-    if (ioctl(fd, VIDIOC_REQBUFS, &req) == -1) {
-        perror("Failed to request buffers");
-        close(fd);
-        return -1;
+int Vvideo::initBuffers() {
+    for (int num = 0; num < CAPTURE_MAX_BUFFERS; num++) {
+        framebuf[num].fm[0].in_use = false;  // 初始状态未使用
     }
 
-    for (int num = 0; num < BUFCOUNT; num++) {
-        std::memset(&buffer, 0, sizeof(buffer));
-        buffer.type = type;
-        buffer.memory = V4L2_MEMORY_MMAP;
-        buffer.index = num;
-
-        if (ioctl(fd, VIDIOC_QUERYBUF, &buffer) == -1) {
-            perror("Failed to query buffer");
-            goto cleanup;
-        }
-
-        framebuf[num].fm[0].start = mmap(NULL, buffer.length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, buffer.m.offset);
-        if (framebuf[num].fm[0].start == MAP_FAILED) {
-            perror("Failed to map buffer");
-            goto cleanup;
-        }
-        framebuf[num].fm[0].length = buffer.length;
-
-        if (ioctl(fd, VIDIOC_QBUF, &buffer) == -1) {
-            perror("Failed to queue buffer");
-            goto cleanup;
+    // dmabuf 只能从 MMAP 缓冲区导出
+    source_->preferUserPtr(userPtrCapture_ && !exporter_);
+    const int wanted = captureBufferTarget();
+    const int count = source_->initBuffers(framebuf, wanted);
+    if (count < 0) return -1;
+    // 之后一律按实际得到的数量处理
+    bufferCount_ = count;
+    bufferBytes_ = 0;
+    for (int num = 0; num < CAPTURE_MAX_BUFFERS; num++) {
+        bufferRefs_[num] = 0;
+        for (int plane = 0; plane < MAX_PLANES; plane++) framebuf[num].fm[plane].dmabuf = -1;
+        if (num >= count) continue;
+        for (int plane = 0; plane < framebuf[num].plane_count && plane < MAX_PLANES; plane++) {
+            bufferBytes_ += framebuf[num].fm[plane].length;
         }
     }
-
-    if (ioctl(fd, VIDIOC_STREAMON, &buffer.type) == -1) {
-        perror("Failed to start streaming");
-        goto cleanup;
+    buffersHeld_ = 0;
+    minFreeBuffers_ = count;
+    qDebug() << "Capture buffers:" << count << "of" << wanted << "requested," << bufferBytes_ / 1024 << "KB";
+    if (exporter_) {
+        // 导出的消费者合计只能占用 captureBufferTarget 为其预留的缓冲区, 预算不够时流水线至少保留
+        // CAPTURE_MIN_BUFFERS 个, 其余帧拷贝导出
+        exporter_->setMaxHeldBuffers(std::min(EXPORT_MAX_HELD, count - CAPTURE_MIN_BUFFERS));
+        exportBuffers();
     }
-
     return 0;
+}
 
-cleanup:
-    for (int i = 0; i < BUFCOUNT; i++) {
-        if (framebuf[i].fm[0].start && framebuf[i].fm[0].start != MAP_FAILED) {
-            munmap(framebuf[i].fm[0].start, framebuf[i].fm[0].length);
-            framebuf[i].fm[0].start = nullptr; // 清理映射
-        }
+bool Vvideo::enableFrameExport(const std::string &socketPath)
+{
+    if (!exporter_) {
+        exporter_.reset(new FrameExporter());
+        // 消费者持有期间缓冲区不归还给采集源
+        exporter_->setBufferCallbacks([this](int index) { bufferRefs_[index]++; },
+                                      [this](int index) { requeueBuffer(index); });
     }
-    close(fd);
-    return -1;
-}
-// 多面
-int Vvideo::initMultiPlaneBuffers() {
-    struct v4l2_requestbuffers req;
-    std::memset(&req, 0, sizeof(req));
-    req.count = BUFCOUNT;
-    req.type = type;
-    req.memory = V4L2_MEMORY_MMAP;
-
-    if (ioctl(fd, VIDIOC_REQBUFS, &req) < 0) {
-        perror("Failed to request buffers");
-        close(fd);
-        return -1;
-    }
-
-    for (int num = 0; num < req.count; num++) {
-        struct v4l2_plane planes[FMT_NUM_PLANES];
-        std::memset(&planes, 0, sizeof(planes));
-        std::memset(&buffer, 0, sizeof(buffer));
-
-        buffer.type = type;
-        buffer.memory = V4L2_MEMORY_MMAP;
-        buffer.index = num;
-        buffer.length = FMT_NUM_PLANES;
-        buffer.m.planes = planes;
-
-        // 查询缓冲区
-        if (ioctl(fd, VIDIOC_QUERYBUF, &buffer) == -1) {
-            perror("Failed to query buffer");
-            goto cleanup;
-        }
+    return exporter_->start(socketPath);
+}
 
-        framebuf[num].plane_count = buffer.length;  // 实际平面数量
-
-        for (int plane = 0; plane < framebuf[num].plane_count; plane++) {
-            framebuf[num].fm[plane].length = buffer.m.planes[plane].length;
-            framebuf[num].fm[plane].start = mmap(
-                NULL, framebuf[num].fm[plane].length, PROT_READ | PROT_WRITE,
-                MAP_SHARED, fd, buffer.m.planes[plane].m.mem_offset);
-
-            if (framebuf[num].fm[plane].start == MAP_FAILED) {
-                perror("Failed to map plane buffer");
-                for (int j = 0; j < plane; j++) {
-                    if (framebuf[num].fm[j].start != MAP_FAILED) {
-                        munmap(framebuf[num].fm[j].start, framebuf[num].fm[j].length);
-                        framebuf[num].fm[j].start = nullptr;
-                    }
+// 导出所有缓冲区的 dmabuf, 任何一个失败就全部放弃, 改为逐帧拷贝到 memfd
+void Vvideo::exportBuffers()
+{
+    for (int i = 0; i < bufferCount_; i++) {
+        for (int plane = 0; plane < framebuf[i].plane_count && plane < MAX_PLANES; plane++) {
+            framebuf[i].fm[plane].dmabuf = source_->exportBuffer(i, plane);
+            if (framebuf[i].fm[plane].dmabuf >= 0) continue;
+            for (int j = 0; j <= i; j++) {
+                for (int p = 0; p < MAX_PLANES; p++) {
+                    if (framebuf[j].fm[p].dmabuf >= 0) ::close(framebuf[j].fm[p].dmabuf);
+                    framebuf[j].fm[p].dmabuf = -1;
                 }
-                goto cleanup;
             }
+            qDebug() << "Capture buffers cannot be exported, frames will be copied to memfd";
+            return;
         }
     }
-
-    // 将所有缓冲区加入队列
-    for (int num = 0; num < req.count; num++) {
-        struct v4l2_plane planes[FMT_NUM_PLANES];
-        std::memset(&planes, 0, sizeof(planes));
-        std::memset(&buffer, 0, sizeof(buffer));
-
-        buffer.type = type;
-        buffer.memory = V4L2_MEMORY_MMAP;
-        buffer.index = num;
-        buffer.m.planes = planes;
-        buffer.length = FMT_NUM_PLANES;
-
-        if (ioctl(fd, VIDIOC_QBUF, &buffer) == -1) {
-            perror("Failed to queue buffer");
-            goto cleanup;
-        }
-    }
-
-    if (ioctl(fd, VIDIOC_STREAMON, &buffer.type) == -1) {
-        perror("Failed to start streaming");
-        goto cleanup;
-    }
-
-    return 0;
-
-cleanup:
-    for (int i = 0; i < req.count; i++) {
-        for (int plane = 0; plane < framebuf[i].plane_count; plane++) {
-            if (framebuf[i].fm[plane].start && framebuf[i].fm[plane].start != MAP_FAILED) {
-                munmap(framebuf[i].fm[plane].start, framebuf[i].fm[plane].length);
-                framebuf[i].fm[0].start = nullptr; // 清理映射
-            }
-        }
-    }
-    close(fd);
-    return -1;
+    qDebug() << "Exported" << bufferCount_ << "capture buffers as dmabuf";
 }
 
-
-
 int Vvideo::captureFrame() {
+    Tracer::setThreadName("capture");
     while(!quit_)
     {
-        // 限制缓存队列长度
-        if (frameIndexQueue.size() > 10) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(10)); // 等待队列有数据
-            continue;
-        }
-
-        // 初始化结构体
-        struct v4l2_plane planes[FMT_NUM_PLANES];
-        memset(planes, 0, sizeof(planes));
-        memset(&buffer, 0, sizeof(buffer));
-        buffer.type = type;
-        buffer.memory = V4L2_MEMORY_MMAP;
-
-        if (V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE == type) {
-            buffer.m.planes = planes;
-            buffer.length = FMT_NUM_PLANES;
-        }
-
-        // 监视文件超时
-        struct timeval tv;
-        tv.tv_sec = 3; // 3秒
-        tv.tv_usec = 0;
-
-        fd_set fds;
-        FD_ZERO(&fds);
-        FD_SET(fd, &fds);
-
-        int r = select(fd + 1, &fds, NULL, NULL, &tv);
-        if (r == -1) {
-            perror("select");
-            return -1;
-        } else if (r == 0) {
-            qDebug() << "Timeout waiting for buffer";
-            continue;
-        }
-        // 出列
-        if (ioctl(fd, VIDIOC_DQBUF, &buffer) == -1) {
-            perror("Failed to dequeue buffer");
-            return -1;
+        // 等待一帧, 3 秒超时或被信号打断(如 SIGUSR1 触发 trace 写出)时继续等待
+        CapturedFrame captured;
+        const int64_t waitStart = Tracer::nowUs();
+        int r = source_->dequeue(captured, 3000);
+        if (r < 0) return -1;
+        if (r == 0) continue;
+
+        int buf_index = captured.index;
+        const int64_t dequeueUs = monotonicUs();
+        Tracer::record(TraceStage::DqbufWait, waitStart, dequeueUs - waitStart);
+
+        // 驱动序号不连续说明驱动侧已经丢帧(通常是缓冲区都被占用, 没有空闲缓冲区可写)
+        if (dequeued_++ > 0) {
+            const uint32_t last = lastSequence_;
+            if (captured.sequence > last + 1) {
+                sequenceGaps_++;
+                lostFrames_ += captured.sequence - last - 1;
+            }
         }
+        lastSequence_ = captured.sequence;
+        if (captured.flags & V4L2_BUF_FLAG_ERROR) errorFrames_++;
 
-        int buf_index = buffer.index;
+        // 出列后驱动手里已没有空缓冲区: 归还之前到达的帧都会被驱动丢弃
+        const int freeBuffers = bufferCount_ - ++buffersHeld_;
+        if (freeBuffers <= 0) starvation_++;
+        if (freeBuffers < minFreeBuffers_) minFreeBuffers_ = freeBuffers;
 
         // 如果该缓冲区正在被 `processFrame()` 处理，则重新入队
+        // 此时不能改写 framebuf 中的帧信息, 处理中的帧还在使用
         if (framebuf[buf_index].fm[0].in_use == true) {
-            if (ioctl(fd, VIDIOC_QBUF, &buffer) == -1) {
-                perror("Failed to queue buffer");
-            }
+            requeuedBusy_++;
+            buffersHeld_--;
+            source_->requeue(buf_index);
             continue;
         }
-        
-        
+
+        // 没有可用的驱动时间戳时以出列时间代替
+        framebuf[buf_index].timestampUs = captured.timestampUs != 0 ? captured.timestampUs : dequeueUs;
+        framebuf[buf_index].dequeueUs = dequeueUs;
+        framebuf[buf_index].sequence = captured.sequence;
+
         // 标记缓冲区正在使用
         framebuf[buf_index].fm[0].in_use = true;
+        bufferRefs_[buf_index] = 1;
+        // 记录有效数据长度, MJPG 帧远小于映射长度
+        for (int plane = 0; plane < framebuf[buf_index].plane_count && plane < MAX_PLANES; plane++) {
+            framebuf[buf_index].fm[plane].bytesused = captured.bytesused[plane];
+        }
 
-        // 入队处理
-        frameIndexQueue.enqueue(buf_index);
+        // 入队处理, 队列满时挤掉最旧的帧并归还给驱动
+        int evicted = -1;
+        QueueStatus status = frameIndexQueue.push(buf_index, &evicted);
+        if (status == QueueStatus::Dropped) {
+            overflowDropped_++;
+            requeueBuffer(evicted);
+        } else if (status == QueueStatus::Closed) {
+            requeueBuffer(buf_index);
+            break;
+        }
     }
     return 0;
 }
 
-void Vvideo::processFrame(QLabel *displayLabel) {
+void Vvideo::processFrame(PreviewWidget *displayWidget) {
+    Tracer::setThreadName("decode");
     int buf_index;
-    uint wait = 0;
     while (!quit_) {
-        while(QPixmapframes.size() > 15) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(30)); // 等待ui更新label
-            wait ++;
-            if (wait > 5) // 5次等待超时,UI更新出现问题
-            {
-                qDebug() << "UI update frame failed.";
-                wait = 0;
+        // 阻塞等待新帧, 超时只是为了周期性检查退出标志
+        QueueStatus status = frameIndexQueue.pop(buf_index, 100);
+        if (status == QueueStatus::Closed) break;
+        if (status != QueueStatus::Ok) continue;
+        // 若数据长度为0,忽略
+        if (framebuf[buf_index].fm[0].length == 0) {
+            requeueBuffer(buf_index);
+            continue;
+        }
+        // 添加数据处理部分到线程池
+        {
+            const QSize labelSize = displayWidget ? displayWidget->targetSize() : QSize(targetWidth_, targetHeight_);
+            // 图像会旋转 270 度后显示, 解码目标框的宽高互换
+            const QSize decodeBox(labelSize.height(), labelSize.width());
+
+            // 拍照/连拍/预录: 拷贝原始帧交给拍照线程, 本线程不等待全分辨率解码
+            handleStill(buf_index);
+            // 录像: MJPG 拷贝压缩数据, YUYV/NV12 转出后交给线程池编码
+            if (recorder_.active()) recordFrame(buf_index);
+            // 导出: 消费者持有 dmabuf 时缓冲区晚一些归还
+            if (exporter_ && exporter_->hasConsumers()) exportFrame(buf_index);
+
+            // 复用显示完回收的帧, 避免每帧重新分配解码缓冲区
+            StageFrame frame;
+            spareFrames.try_pop(frame);
+            frame.seq = frameSeq_++;
+            frame.timing = FrameTiming();
+            frame.timing.sequence = framebuf[buf_index].sequence;
+            frame.timing.captureUs = framebuf[buf_index].timestampUs;
+            frame.timing.dequeueUs = framebuf[buf_index].dequeueUs;
+            frame.labelSize = labelSize;
+            const QSize box = previewScaledDecode_ ? decodeBox : QSize();
+
+            // MJPG 解码无法拆分, 整帧交给工作线程
+            if (pool_ && isMjpgStream()) {
+                dispatchMjpg(buf_index, std::move(frame), box);
                 continue;
             }
+
+            // 解码阶段只把帧从驱动缓冲区转出, 尽早归还缓冲区; YUV 大帧由线程池按条带并行
+            const Clock::time_point start = Clock::now();
+            frame.valid = decodePreview(buf_index, box, frame, pool_.get());
+            frame.timing.decodeEndUs = monotonicUs();
+            requeueBuffer(buf_index);
+            decodeCounter_.add(0, elapsedUs(start, Clock::now()));
+            deliverFrame(std::move(frame));
         }
-        // 从队列中取出帧
-        if (!frameIndexQueue.try_dequeue(buf_index)) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(10)); // 等待队列有数据
+    }
+}
+
+// 旋转缩放阶段
+void Vvideo::transformFrame()
+{
+    Tracer::setThreadName("transform");
+    StageFrame frame;
+    while (decodedFrames.pop(frame) == QueueStatus::Ok) {
+        const Clock::time_point start = Clock::now();
+        recordQueueWait(frame.queuedAt, start);
+        const bool ok = convertRotateScale(frame.view, frame.labelSize, frame.output,
+                                           outputFormat_.load(), pool_.get());
+        const Clock::time_point end = Clock::now();
+        transformCounter_.add(elapsedUs(frame.queuedAt, start), elapsedUs(start, end));
+        if (!ok) {
+            spareFrames.push(std::move(frame));
             continue;
         }
-        // 若数据长度为0,忽略
-        if (framebuf[buf_index].fm[0].length == 0) continue;
-        // 添加数据处理部分到线程池
+        frame.queuedAt = end;
+        frame.timing.transformEndUs = monotonicUs();
+        // 显示阶段忙时在此阻塞
+        renderedFrames.push(std::move(frame));
+    }
+}
+
+// 显示阶段: 把显示帧交给 UI 线程, 帧回收给解码阶段
+// 待显示帧只保留最新一帧, UI 线程处理前到达的新帧直接替换旧帧
+void Vvideo::presentFrame()
+{
+    Tracer::setThreadName("present");
+    StageFrame frame;
+    while (renderedFrames.pop(frame) == QueueStatus::Ok) {
+        const Clock::time_point start = Clock::now();
+        recordQueueWait(frame.queuedAt, start);
+        // 交出显示帧的引用, 缓冲区在预览控件换帧后回到 FramePool, 旋转缩放阶段下次从池中取
+        DisplayFrame display;
+        display.image = std::move(frame.output);
+        display.timing = frame.timing;
+        frame.output = QImage();
+        displayFrames.push(std::move(display));
+        // 同一时间只挂一个通知, 避免 UI 繁忙时事件队列堆积
+        if (!notifyPending_.exchange(true)) emit frameReady();
+        presentCounter_.add(elapsedUs(frame.queuedAt, start), elapsedUs(start, Clock::now()));
+        spareFrames.push(std::move(frame));
+
+        // 每 300 帧输出一次各阶段统计
+        if (presentCounter_.frames % 300 == 0) logStageStats();
+    }
+}
+
+void Vvideo::closeQueues()
+{
+    frameIndexQueue.close();
+    decodedFrames.close();
+    renderedFrames.close();
+    displayFrames.close();
+    stillJobs.close();
+}
+
+bool Vvideo::isMjpgStream() const
+{
+    return !source_->multiPlane()
+           || fmt == V4L2_PIX_FMT_MJPEG || fmt == V4L2_PIX_FMT_JPEG;
+}
+
+// 按帧并行: 等待空闲线程后把整帧交给线程池, 完成后归还缓冲区并按序号交给下一阶段
+void Vvideo::dispatchMjpg(int buf_index, StageFrame &&frame, const QSize &decodeBox)
+{
+    {
+        std::unique_lock<std::mutex> lock(inflightMutex_);
+        inflightCond_.wait(lock, [this]() { return inflight_ < pool_->size(); });
+        inflight_++;
+    }
+    std::shared_ptr<StageFrame> job = std::make_shared<StageFrame>(std::move(frame));
+    pool_->submit([this, buf_index, job, decodeBox]() {
+        const Clock::time_point start = Clock::now();
+        job->valid = decodePreview(buf_index, decodeBox, *job, nullptr);
+        job->timing.decodeEndUs = monotonicUs();
+        requeueBuffer(buf_index);
+        decodeCounter_.add(0, elapsedUs(start, Clock::now()));
+        deliverFrame(std::move(*job));
         {
-            QImage image_ = QImage(w, h, QImage::Format_RGB888);
-            if (V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE == type) {
-
-                if (fmt == V4L2_PIX_FMT_NV12) {
-                    NV12ToRGB(image_, framebuf[buf_index].fm[0].start, framebuf[buf_index].fm[0].length,
-                        framebuf[buf_index].fm[1].start, framebuf[buf_index].fm[1].length);
-                } else if (fmt == V4L2_PIX_FMT_MJPEG || fmt == V4L2_PIX_FMT_JPEG) {
-                    MJPG2RGB(image_, framebuf[buf_index].fm[0].start, framebuf[buf_index].fm[0].length);
-                } else if (fmt == V4L2_PIX_FMT_YUYV) {
-                    YUYV2RGB(image_, framebuf[buf_index].fm[0].start, framebuf[buf_index].fm[0].length);
-                } else {
-                    qDebug() << "Unsupported format";
-                    image_ = QImage();
-                }
-            } else {// 测试平台仅有MJPG格式可以使用
-                MJPG2RGB(image_, framebuf[buf_index].fm[0].start, framebuf[buf_index].fm[0].length);
-            }
+            std::lock_guard<std::mutex> lock(inflightMutex_);
+            inflight_--;
+        }
+        inflightCond_.notify_one();
+    });
+}
 
-            struct v4l2_buffer qbuf;
-            struct v4l2_plane planes[FMT_NUM_PLANES];
-            memset(planes, 0, sizeof(planes));
-            memset(&qbuf, 0, sizeof(qbuf));
-            qbuf.type = type;
-            qbuf.index = buf_index;
-            qbuf.memory = V4L2_MEMORY_MMAP;
-
-            if (V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE == type) {
-                qbuf.m.planes = planes;
-                qbuf.length = FMT_NUM_PLANES;
-            }
-            framebuf[buf_index].fm[0].in_use = false;
-            // 缓冲区重新入队
-            if (ioctl(fd, VIDIOC_QBUF, &qbuf) == -1) {
-                perror("Failed to queue buffer");
-            }
+// 按序号交给旋转缩放阶段; 解码失败的帧只推进序号
+void Vvideo::deliverFrame(StageFrame &&frame)
+{
+    std::lock_guard<std::mutex> lock(reorderMutex_);
+    const uint64_t seq = frame.seq;
+    reorderFrames_[seq] = std::move(frame);
+    while (!reorderFrames_.empty() && reorderFrames_.begin()->first == nextSeq_) {
+        StageFrame ready = std::move(reorderFrames_.begin()->second);
+        reorderFrames_.erase(reorderFrames_.begin());
+        nextSeq_++;
+        if (!ready.valid) {
+            spareFrames.push(std::move(ready));
+            continue;
+        }
+        ready.queuedAt = Clock::now();
+        // 旋转缩放阶段忙时在此阻塞, 积压留在索引队列中按策略丢弃
+        decodedFrames.push(std::move(ready));
+    }
+}
 
-            if (image_.isNull()) continue;
+std::vector<StageStats> Vvideo::stageStats()
+{
+    std::vector<StageStats> stats;
+    stats.push_back(makeStageStats("decode", frameIndexQueue, decodeCounter_));
+    stats.push_back(makeStageStats("transform", decodedFrames, transformCounter_));
+    stats.push_back(makeStageStats("present", renderedFrames, presentCounter_));
+    return stats;
+}
+
+void Vvideo::logStageStats()
+{
+    for (const StageStats &st : stageStats()) {
+        qDebug() << "Stage" << st.name << "queue" << st.queued << "/" << st.capacity
+                 << "dropped" << st.dropped << "wait" << st.avgWaitUs << "us, process"
+                 << st.avgProcessUs << "us over" << st.frames << "frames";
+    }
+    const CaptureStats capture = captureStats();
+    qDebug() << "Capture buffers" << capture.buffers << "(" << capture.bufferBytes / 1024 << "KB ), starved"
+             << capture.starvation << "times, min free" << capture.minFreeBuffers;
+    FramePool &pool = FramePool::instance();
+    qDebug() << "Frame pool hits" << pool.hits() << "misses" << pool.misses()
+             << "free" << pool.freeBuffers() << "buffers," << pool.freeBytes() / 1024 << "KB";
+    Tracer::instance().logSummary();
+}
 
-            // 旋转图像以适应竖屏显示
-            image_ = image_.transformed(QMatrix().rotate(270));
+// 解码阶段: 把帧从驱动缓冲区转出到 frame, 之后即可归还缓冲区
+// MJPG 按 decodeBox 缩放解码为 RGB32, YUYV/NV12 转换为 I420
+bool Vvideo::decodePreview(int buf_index, const QSize &decodeBox, StageFrame &frame, ThreadPool *pool)
+{
+    TraceScope trace(TraceStage::Decode);
+    video_buf_t &vb = framebuf[buf_index];
 
-            // 处理后帧入队
-            QPixmap pixmap = QPixmap::fromImage(image_.scaled(displayLabel->size(), Qt::KeepAspectRatio, Qt::SmoothTransformation));
-            QPixmapframes.enqueue(pixmap);
+    if (isMjpgStream()) {
+        if (!JpegDecoder::forThread().decode(vb.fm[0].start, vb.fm[0].length, frame.argb,
+                                             decodeBox, QImage::Format_RGB32)) {
+            return false;
         }
+        std::memset(&frame.view, 0, sizeof(frame.view));
+        frame.view.format = SourceFormat::ARGB;
+        frame.view.width = frame.argb.width();
+        frame.view.height = frame.argb.height();
+        frame.view.data[0] = frame.argb.constBits();
+        frame.view.stride[0] = frame.argb.bytesPerLine();
+        return true;
     }
+    FrameView view;
+    if (!rawFrameView(vb, view)) return false;
+    return convertToI420(view, frame.i420, frame.view, pool);
 }
 
-void Vvideo::MJPG2RGB(QImage &image_, void *data, size_t length) {
-    tjhandle handle = tjInitDecompress();
-    if (!handle) {
-        qWarning() << "Failed to initialize TurboJPEG decompressor";
-        return;
+// 描述驱动缓冲区中的 YUYV/NV12 帧, 其他格式返回 false
+bool Vvideo::rawFrameView(const video_buf_t &vb, FrameView &view)
+{
+    std::memset(&view, 0, sizeof(view));
+    if (fmt == V4L2_PIX_FMT_NV12) {
+        view.format = SourceFormat::NV12;
+        view.width = w;
+        view.height = h;
+        view.data[0] = static_cast<const uint8_t*>(vb.fm[0].start);
+        view.stride[0] = w;
+        // 单平面 NV12 的 UV 紧跟在 Y 之后
+        view.data[1] = vb.plane_count > 1 ? static_cast<const uint8_t*>(vb.fm[1].start)
+                                          : view.data[0] + w * h;
+        view.stride[1] = w;
+    } else if (fmt == V4L2_PIX_FMT_YUYV) {
+        view.format = SourceFormat::YUYV;
+        view.width = w;
+        view.height = h;
+        view.data[0] = static_cast<const uint8_t*>(vb.fm[0].start);
+        view.stride[0] = w * 2;
+    } else {
+        qDebug() << "Unsupported format";
+        return false;
     }
-    int width, height, subsamp, colorspace;
-    if (tjDecompressHeader3(handle, static_cast<unsigned char*>(data), length, 
-                            &width, &height, &subsamp, &colorspace) != 0) {
-        qWarning() << "Failed to read MJPEG header:" << tjGetErrorStr();
-        tjDestroy(handle);
-        return;
+    return true;
+}
+
+// 将一帧原始数据转换为 RGB888
+// fitSize 非空时, MJPG 直接按 TurboJPEG 缩放因子解码到刚好覆盖 fitSize 的尺寸
+bool Vvideo::convertFrame(const video_buf_t &vb, QImage &image_, const QSize &fitSize)
+{
+    if (source_->multiPlane()) {
+
+        if (fmt == V4L2_PIX_FMT_NV12) {
+            prepareFrameImage(image_);
+            if (vb.plane_count > 1) {
+                NV12ToRGB(image_, vb.fm[0].start, vb.fm[0].length, vb.fm[1].start, vb.fm[1].length);
+            } else {
+                // 单平面 NV12 的 UV 紧跟在 Y 之后
+                uint8_t *uv = static_cast<uint8_t*>(vb.fm[0].start) + w * h;
+                NV12ToRGB(image_, vb.fm[0].start, w * h, uv, vb.fm[0].length - w * h);
+            }
+        } else if (fmt == V4L2_PIX_FMT_MJPEG || fmt == V4L2_PIX_FMT_JPEG) {
+            return MJPG2RGB(image_, vb.fm[0].start, vb.fm[0].length, fitSize);
+        } else if (fmt == V4L2_PIX_FMT_YUYV) {
+            prepareFrameImage(image_);
+            YUYV2RGB(image_, vb.fm[0].start, vb.fm[0].length);
+        } else {
+            qDebug() << "Unsupported format";
+            return false;
+        }
+        return true;
     }
-    QImage image(width, height, QImage::Format_RGB888);
-    if (tjDecompress2(handle, static_cast<unsigned char*>(data), length,
-                      image.bits(), width, 0, height, TJPF_RGB, TJFLAG_FASTDCT) != 0) {
-        qWarning() << "Failed to decompress MJPEG frame:" << tjGetErrorStr();
-        tjDestroy(handle);
-        return;
+    // 测试平台仅有MJPG格式可以使用
+    return MJPG2RGB(image_, vb.fm[0].start, vb.fm[0].length, fitSize);
+}
+
+// 将缓冲区归还给驱动, 导出的消费者都归还后才真正入队
+void Vvideo::requeueBuffer(int index)
+{
+    if (index < 0 || index >= bufferCount_) return;
+    if (bufferRefs_[index].fetch_sub(1) > 1) return;
+
+    buffersHeld_--;
+    framebuf[index].fm[0].in_use = false;
+    source_->requeue(index);
+}
+
+// 确保复用的帧缓冲区与当前分辨率一致
+void Vvideo::prepareFrameImage(QImage &image_)
+{
+    if (image_.width() != static_cast<int>(w) || image_.height() != static_cast<int>(h)
+        || image_.format() != QImage::Format_RGB888) {
+        image_ = FramePool::instance().acquire(w, h, QImage::Format_RGB888);
     }
-    tjDestroy(handle);
-    image_ = image;  // 返回解码后的图像
 }
 
-/* 尝试直接操作image_(引用)减少额外开销 */
-void Vvideo::YUYV2RGB(QImage &image_, void *data, size_t length) {
-    // 1. 使用 ARGB 作为中间格式
-    std::vector<uint8_t> argb_buffer(w * h * 4); // ARGB 缓冲区
-    libyuv::YUY2ToARGB(
-        static_cast<const uint8_t*>(data),  // 输入 YUYV 数据
-        w * 2,                              // YUYV 的步长（每行字节数）
-        argb_buffer.data(),                 // 输出 ARGB 数据
-        w * 4,                              // ARGB 的步长（每行字节数）
-        w, h                                // 宽高
-    );
+bool Vvideo::MJPG2RGB(QImage &image_, void *data, size_t length, const QSize &fitSize) {
+    // 解码器随线程持久存在, 直接解码进 image_ 的缓冲区
+    JpegDecoder &decoder = JpegDecoder::forThread();
+    if (!decoder.decode(data, length, image_, fitSize)) return false;
 
-    // 2. 手动交换 ARGB 中的 R 和 B 通道
-    for (size_t i = 0; i < w * h; ++i) {
-        uint8_t *pixel = &argb_buffer[i * 4];
-        std::swap(pixel[0], pixel[2]);  // 交换 R 和 B
+    // 每 300 帧输出一次解码耗时
+    if (decoder.decodedFrames() % 300 == 0) {
+        qDebug() << "MJPG decode:" << decoder.lastDecodeUs() << "us, avg"
+                 << decoder.avgDecodeUs() << "us over" << decoder.decodedFrames() << "frames, scale 1/"
+                 << decoder.lastScaleDenom();
     }
+    return true;
+}
 
-    // 3. 将 ARGB 转换为 RGB24（丢弃 Alpha 通道）
-    libyuv::ARGBToRGB24(
-        argb_buffer.data(),    // 输入 ARGB 数据
-        w * 4,                 // ARGB 的步长
-        image_.bits(),         // 输出 RGB24 数据
-        w * 3,                 // RGB24 的步长
-        w, h
-    );
+/* 尝试直接操作image_(引用)减少额外开销 */
+void Vvideo::YUYV2RGB(QImage &image_, void *data, size_t length) {
+    // 按行条带转换, 不分配整帧 ARGB 缓冲区, 也不需要逐像素交换 R/B(见 yuyvToRgb888)
+    if (length < static_cast<size_t>(w) * h * 2) return;
+    yuyvToRgb888(static_cast<const uint8_t*>(data), w * 2, image_.bits(), image_.bytesPerLine(), w, h);
 }
 
 void Vvideo::NV12ToRGB(QImage &image_, void *data_y, size_t len_y, void *data_uv, size_t len_uv) {
     // QImage image(w, h, QImage::Format_RGB888);
     // 使用libyuv转换NV12到RGB
-    libyuv::NV12ToRGB24(
+    // libyuv 的 RGB24 内存顺序为 B,G,R, RAW 才与 QImage::Format_RGB888 一致
+    libyuv::NV12ToRAW(
         static_cast<const uint8_t*>(data_y),    // Y平面
         w,                                      // Y步长
         static_cast<const uint8_t*>(data_uv),   // UV平面
@@ -458,59 +608,460 @@ void Vvideo::NV12ToRGB(QImage &image_, void *data_y, size_t len_y, void *data_uv
     // image_ = image;
 }
 
+bool Vvideo::setOutputFormat(QImage::Format format)
+{
+    if (!isOutputFormatSupported(format)) return false;
+    outputFormat_ = format;
+    return true;
+}
+
 void Vvideo::updateImage()
 {
-    QPixmap Pixmap_img;
-    QPixmapframes.try_dequeue(Pixmap_img);
-    
-    if(Pixmap_img.isNull()) return;
-    // 显示到label
-    QMetaObject::invokeMethod(displayLabel, 
-        [this, Pixmap_img]() {
-            displayLabel->setPixmap(Pixmap_img);
-        }
-    , Qt::QueuedConnection);
+    // 先清除通知标志再取帧, 取帧之后到达的帧会再次发出通知
+    notifyPending_ = false;
+    DisplayFrame frame;
+    if (!displayFrames.try_pop(frame) || frame.image.isNull()) return;
+    // 已在 UI 线程, 直接交给预览控件绘制; 没有控件时只做统计
+    if (displayWidget) displayWidget->setFrame(frame.image);
+    frame.timing.displayUs = monotonicUs();
+    recordDisplayed(frame.timing);
+    if (displayWidget && displayWidget->overlayVisible()) updateOverlay();
 }
 
-void Vvideo::takePic(QImage &img)
+// 叠加层: 帧率/延迟, 以及各类丢帧计数
+void Vvideo::updateOverlay()
 {
-    img = QPixmapframes.dequeue().toImage();
+    const DisplayStats st = displayStats();
+    const CaptureStats cap = captureStats();
+    const QString details = QString("seq %1  lost %2  busy %3  drop %4  repl %5")
+                                .arg(cap.lastSequence)
+                                .arg(cap.lostFrames)
+                                .arg(cap.requeuedBusy)
+                                .arg(cap.overflowDropped)
+                                .arg(st.replacedFrames);
+    displayWidget->setOverlayStats(st.fps, st.avgLatencyMs, details);
 }
 
-int Vvideo::closeDevice()
+// 两个时间点之间的耗时, 任一未记录时为 0
+static int64_t spanUs(int64_t from, int64_t to)
 {
-    frameIndexQueue.clear(); // 清空队列
-    QPixmapframes.clear();
-    // 停止采集并释放映射
-    if (ioctl(fd, VIDIOC_STREAMOFF, &buffer.type) == -1) {
-        perror("Failed to stop streaming");
-        close(fd);
-        return -1;
-    }
-
-    if (type == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE) {
-        // 多平面缓冲区的解映射
-        for (int i = 0; i < BUFCOUNT; i++) {
-            for (int plane = 0; plane < framebuf[i].plane_count; plane++) {
-                if (framebuf[i].fm[plane].start && framebuf[i].fm[plane].start != MAP_FAILED) {
-                    munmap(framebuf[i].fm[plane].start, framebuf[i].fm[plane].length);
-                    framebuf[i].fm[plane].start = nullptr; // 释放映射后，避免再次操作
-                }
+    return from > 0 && to >= from ? to - from : 0;
+}
+
+// 采集到显示的延迟以 V4L2 时间戳为起点, 统计窗口约 1 秒
+void Vvideo::recordDisplayed(const FrameTiming &timing)
+{
+    const int64_t now = timing.displayUs;
+    std::lock_guard<std::mutex> lock(displayMutex_);
+    displayedFrames_++;
+    lastLatencyUs_ = spanUs(timing.captureUs, now);
+    lastTiming_ = timing;
+    if (latencySampling_ && latencySamples_.size() < LATENCY_SAMPLES_MAX) {
+        latencySamples_.push_back(static_cast<uint32_t>(lastLatencyUs_));
+    }
+    if (windowStartUs_ == 0) windowStartUs_ = now;
+    windowFrames_++;
+    windowLatencyUs_ += lastLatencyUs_;
+    windowDequeueUs_ += spanUs(timing.captureUs, timing.dequeueUs);
+    windowDecodeUs_ += spanUs(timing.dequeueUs, timing.decodeEndUs);
+    windowTransformUs_ += spanUs(timing.decodeEndUs, timing.transformEndUs);
+    windowPresentUs_ += spanUs(timing.transformEndUs, now);
+    if (now - windowStartUs_ >= 1000000) {
+        displayFps_ = windowFrames_ * 1e6 / (now - windowStartUs_);
+        avgLatencyMs_ = windowLatencyUs_ / 1000.0 / windowFrames_;
+        avgDequeueMs_ = windowDequeueUs_ / 1000.0 / windowFrames_;
+        avgDecodeMs_ = windowDecodeUs_ / 1000.0 / windowFrames_;
+        avgTransformMs_ = windowTransformUs_ / 1000.0 / windowFrames_;
+        avgPresentMs_ = windowPresentUs_ / 1000.0 / windowFrames_;
+        windowStartUs_ = now;
+        windowFrames_ = 0;
+        windowLatencyUs_ = 0;
+        windowDequeueUs_ = 0;
+        windowDecodeUs_ = 0;
+        windowTransformUs_ = 0;
+        windowPresentUs_ = 0;
+    }
+    // 每 300 帧输出一次显示统计
+    if (displayedFrames_ % 300 == 0) {
+        qDebug() << "Display:" << displayFps_ << "fps, latency avg" << avgLatencyMs_ << "ms (dequeue"
+                 << avgDequeueMs_ << "decode" << avgDecodeMs_ << "transform" << avgTransformMs_
+                 << "present" << avgPresentMs_ << "), last" << lastLatencyUs_ / 1000.0
+                 << "ms, replaced" << displayFrames.dropped() << "frames";
+        const CaptureStats cap = captureStats();
+        qDebug() << "Capture: seq" << cap.lastSequence << "dequeued" << cap.dequeued << "gaps"
+                 << cap.sequenceGaps << "lost" << cap.lostFrames << "error" << cap.errorFrames
+                 << "requeued busy" << cap.requeuedBusy << "overflow" << cap.overflowDropped;
+    }
+}
+
+void Vvideo::setLatencySampling(bool enable)
+{
+    std::lock_guard<std::mutex> lock(displayMutex_);
+    latencySampling_ = enable;
+    if (!enable) latencySamples_.clear();
+}
+
+std::vector<uint32_t> Vvideo::takeLatencySamples()
+{
+    std::vector<uint32_t> samples;
+    std::lock_guard<std::mutex> lock(displayMutex_);
+    samples.swap(latencySamples_);
+    return samples;
+}
+
+DisplayStats Vvideo::displayStats()
+{
+    DisplayStats st;
+    std::lock_guard<std::mutex> lock(displayMutex_);
+    st.fps = displayFps_;
+    st.avgLatencyMs = avgLatencyMs_;
+    st.lastLatencyMs = lastLatencyUs_ / 1000.0;
+    st.displayedFrames = displayedFrames_;
+    st.replacedFrames = displayFrames.dropped();
+    st.avgDequeueMs = avgDequeueMs_;
+    st.avgDecodeMs = avgDecodeMs_;
+    st.avgTransformMs = avgTransformMs_;
+    st.avgPresentMs = avgPresentMs_;
+    st.lastSequence = lastTiming_.sequence;
+    return st;
+}
+
+CaptureStats Vvideo::captureStats()
+{
+    CaptureStats st;
+    st.dequeued = dequeued_;
+    st.sequenceGaps = sequenceGaps_;
+    st.lostFrames = lostFrames_;
+    st.errorFrames = errorFrames_;
+    st.requeuedBusy = requeuedBusy_;
+    st.overflowDropped = overflowDropped_;
+    st.lastSequence = lastSequence_;
+    st.detachedFrames = detachedFrames_;
+    st.buffers = bufferCount_;
+    st.bufferBytes = bufferBytes_;
+    st.starvation = starvation_;
+    st.minFreeBuffers = minFreeBuffers_;
+    return st;
+}
+
+void Vvideo::requestStill(int64_t notBeforeUs)
+{
+    // 只保留最新的请求, 处理线程取到满足时间条件的帧后清除
+    stillShutterUs_ = monotonicUs();
+    stillRequestUs_ = notBeforeUs < 0 ? 0 : notBeforeUs;
+}
+
+void Vvideo::setBurst(int preFrames, int postFrames, size_t ramBudget)
+{
+    burstPre_ = preFrames < 0 ? 0 : preFrames;
+    burstPost_ = postFrames < 1 ? 1 : postFrames;
+    burstBudget_ = ramBudget;
+}
+
+static size_t stillBytes(const StillJob &job)
+{
+    size_t bytes = 0;
+    for (int plane = 0; plane < MAX_PLANES; plane++) {
+        bytes += job.memory[plane] ? job.buf.fm[plane].length : job.data[plane].size();
+    }
+    return bytes;
+}
+
+void Vvideo::handleStill(int buf_index)
+{
+    const video_buf_t &vb = framebuf[buf_index];
+    int64_t notBefore = stillRequestUs_.load();
+    if (notBefore != NO_STILL_REQUEST && vb.timestampUs >= notBefore
+        && stillRequestUs_.compare_exchange_strong(notBefore, NO_STILL_REQUEST)) {
+        // 快门: 先保存预录环里快门前的帧, 本帧起再保存 postFrames 帧
+        burstShutterUs_ = stillShutterUs_;
+        burstRemaining_ = burstPost_;
+        const size_t prerollFrames = preroll_.size();
+        while (!preroll_.empty()) {
+            StillJob job = std::move(preroll_.front());
+            preroll_.pop_front();
+            job.shutterUs = burstShutterUs_;
+            pushStill(std::move(job));
+        }
+        prerollBytes_ = 0;
+        if (prerollFrames > 0 || burstRemaining_ > 1) {
+            qDebug() << "Burst:" << prerollFrames << "pre-roll frames +" << burstRemaining_ << "frames";
+        }
+    }
+
+    if (burstRemaining_ > 0) {
+        burstRemaining_--;
+        StillJob job;
+        if (copyStill(buf_index, job)) {
+            pushStill(std::move(job));
+        } else {
+            failStill(job);
+        }
+    } else if (burstPre_ > 0) {
+        keepPreroll(buf_index);
+    } else if (!preroll_.empty()) {
+        preroll_.clear();
+        prerollBytes_ = 0;
+    }
+}
+
+// 取出原始帧, 采集缓冲区随后照常归还驱动; job 中已有的缓冲区会被复用
+// USERPTR 模式下直接摘下采集内存, 否则拷贝
+bool Vvideo::copyStill(int buf_index, StillJob &job)
+{
+    const video_buf_t &vb = framebuf[buf_index];
+    const int planes = source_->multiPlane() ? vb.plane_count : 1;
+    job.buf = vb;
+    job.rotate = stillRotate_;
+    job.shutterUs = burstShutterUs_;
+    job.passthrough = isMjpgStream() && jpegPassthrough_ && photoWriter_;
+    for (int plane = 0; plane < MAX_PLANES; plane++) job.memory[plane].reset();
+    // 直通模式要补霍夫曼表, 总要拷贝一次
+    if (!job.passthrough && source_->detachBuffer(buf_index, job.memory)) {
+        for (int plane = 0; plane < MAX_PLANES; plane++) {
+            job.data[plane].clear();
+            if (plane >= planes) {
+                job.memory[plane].reset();
+                continue;
+            }
+            if (vb.fm[plane].bytesused > 0 && vb.fm[plane].bytesused < vb.fm[plane].length) {
+                job.buf.fm[plane].length = vb.fm[plane].bytesused;
             }
         }
-    } else {
-        // 单平面缓冲区的解映射
-        for (int i = 0; i < BUFCOUNT; i++) {  // 修正了 <= BUFCOUNT 的问题
-            if (framebuf[i].fm[0].start) {
-                munmap(framebuf[i].fm[0].start, framebuf[i].fm[0].length);
-                framebuf[i].fm[0].start = nullptr; // 防止重复操作
+        detachedFrames_++;
+        return true;
+    }
+    for (int plane = 0; plane < MAX_PLANES; plane++) {
+        if (plane >= planes) {
+            job.data[plane].clear();
+            continue;
+        }
+        const uint8_t *src = static_cast<const uint8_t*>(vb.fm[plane].start);
+        size_t length = vb.fm[plane].length;
+        if (vb.fm[plane].bytesused > 0 && vb.fm[plane].bytesused < length) length = vb.fm[plane].bytesused;
+        if (job.passthrough) {
+            // 直通模式只拷贝这一次, 顺带补上摄像头省略的霍夫曼表
+            if (!completeMjpegFrame(src, length, job.data[0])) {
+                qDebug() << "Still capture failed: invalid MJPG frame";
+                return false;
             }
+            for (int rest = 1; rest < MAX_PLANES; rest++) job.data[rest].clear();
+            return true;
+        }
+        job.data[plane].assign(src, src + length);
+        job.buf.fm[plane].start = job.data[plane].data();
+        job.buf.fm[plane].length = length;
+    }
+    return true;
+}
+
+// 交给拍照线程, 超出数量或内存预算时丢弃
+void Vvideo::pushStill(StillJob &&job)
+{
+    const size_t bytes = stillBytes(job);
+    if (stillQueuedBytes_ + bytes > burstBudget_ && stillQueuedBytes_ > 0) {
+        stillDropped_++;
+        qDebug() << "Still frame dropped: over burst memory budget," << stillDropped_.load() << "dropped";
+        failStill(job);
+        return;
+    }
+    stillQueuedBytes_ += bytes;
+    StillJob dropped;
+    if (stillJobs.push(std::move(job), &dropped) != QueueStatus::Ok) {
+        stillQueuedBytes_ -= bytes;
+        stillDropped_++;
+        qDebug() << "Still frame dropped: still queue full," << stillDropped_.load() << "dropped";
+        failStill(dropped);
+    }
+}
+
+// 预录环: 最多 preFrames 帧且不超过内存预算, 淘汰最旧的帧并复用其缓冲区
+void Vvideo::keepPreroll(int buf_index)
+{
+    const size_t maxFrames = static_cast<size_t>(burstPre_.load());
+    const size_t budget = burstBudget_;
+    StillJob job;
+    while (!preroll_.empty() && preroll_.size() >= maxFrames) {
+        prerollBytes_ -= stillBytes(preroll_.front());
+        job = std::move(preroll_.front());
+        preroll_.pop_front();
+    }
+    if (!copyStill(buf_index, job)) return;
+    const size_t bytes = stillBytes(job);
+    while (!preroll_.empty() && prerollBytes_ + bytes > budget) {
+        prerollBytes_ -= stillBytes(preroll_.front());
+        preroll_.pop_front();
+    }
+    if (bytes > budget) return;
+    prerollBytes_ += bytes;
+    preroll_.push_back(std::move(job));
+}
+
+void Vvideo::failStill(const StillJob &job)
+{
+    emit stillReady(QImage(), job.buf.timestampUs);
+}
+
+// 拍照线程: 全分辨率解码并旋转, 不占用预览流水线
+void Vvideo::stillFrame()
+{
+    Tracer::setThreadName("still");
+    StillJob job;
+    while (stillJobs.pop(job) == QueueStatus::Ok) {
+        stillQueuedBytes_ -= stillBytes(job);
+        if (job.passthrough) {
+            saveJpegStill(job);
+            job = StillJob();
+            continue;
+        }
+        const Clock::time_point start = Clock::now();
+        QImage still;
+        if (convertFrame(job.buf, still, QSize())) {
+            still = still.transformed(QMatrix().rotate(270));
+        } else {
+            still = QImage();
+        }
+        qDebug() << "Still decoded in" << elapsedUs(start, Clock::now()) / 1000 << "ms,"
+                 << still.width() << "x" << still.height();
+        if (!still.isNull() && photoWriter_) {
+            // 保存队列满时在此等待, 积压留在 stillJobs 中受内存预算约束
+            if (!photoWriter_->submitImage(still, job.shutterUs, -1)) failStill(job);
+        } else {
+            emit stillReady(still, job.buf.timestampUs);
+        }
+        // 释放拷贝的原始数据
+        job = StillJob();
+    }
+}
+
+// 直通模式: 按需无损旋转后交给 PhotoWriter, 不解码像素
+void Vvideo::saveJpegStill(StillJob &job)
+{
+    std::vector<uint8_t> jpeg;
+    if (job.rotate) {
+        if (!JpegTransformer::forThread().rotate270(job.data[0].data(), job.data[0].size(), jpeg)) {
+            failStill(job);
+            return;
+        }
+    } else {
+        jpeg.swap(job.data[0]);
+    }
+    if (!photoWriter_->submitJpeg(std::move(jpeg), job.shutterUs, -1)) failStill(job);
+}
+
+bool Vvideo::startRecording(const QString &fileName, int quality)
+{
+    // 按驱动实际采用的帧率写入文件头, 查询失败时按 30fps
+    uint32_t rate = 30;
+    uint32_t scale = 1;
+    uint32_t numerator, denominator;
+    if (source_->frameInterval(numerator, denominator)) {
+        rate = denominator;
+        scale = numerator;
+    }
+    recordQuality_ = clamp(quality, 1, 100);
+    return recorder_.start(fileName, w, h, rate, scale);
+}
+
+// 录像帧按采集顺序取序号, 编码完成顺序不定, 由 VideoRecorder 重排
+void Vvideo::recordFrame(int buf_index)
+{
+    const video_buf_t &vb = framebuf[buf_index];
+    const uint64_t seq = recorder_.reserve();
+    const uint8_t *src = static_cast<const uint8_t*>(vb.fm[0].start);
+    size_t length = vb.fm[0].length;
+    if (vb.fm[0].bytesused > 0 && vb.fm[0].bytesused < length) length = vb.fm[0].bytesused;
+
+    if (isMjpgStream()) {
+        // 压缩数据只拷贝一次, 顺带补上霍夫曼表, 否则部分播放器无法解码
+        std::vector<uint8_t> jpeg;
+        if (completeMjpegFrame(src, length, jpeg)) {
+            recorder_.submit(seq, std::move(jpeg), vb.timestampUs);
+        } else {
+            recorder_.skip(seq);
+        }
+        return;
+    }
+
+    // 编码跟不上时直接丢帧, 不占用驱动缓冲区, 也不阻塞预览
+    if (recordInflight_ >= RECORD_MAX_INFLIGHT) {
+        recorder_.skip(seq);
+        return;
+    }
+    FrameView raw;
+    std::shared_ptr<std::vector<uint8_t>> i420 = std::make_shared<std::vector<uint8_t>>();
+    recordSpare_.try_pop(*i420);
+    std::shared_ptr<FrameView> view = std::make_shared<FrameView>();
+    if (!rawFrameView(vb, raw) || !convertToI420(raw, *i420, *view, pool_.get())) {
+        recorder_.skip(seq);
+        return;
+    }
+    const int64_t timestampUs = vb.timestampUs;
+    const int quality = recordQuality_;
+    std::function<void()> encode = [this, seq, i420, view, timestampUs, quality]() {
+        std::vector<uint8_t> jpeg;
+        if (JpegEncoder::forThread().encodeI420(*view, quality, jpeg)) {
+            recorder_.submit(seq, std::move(jpeg), timestampUs);
+        } else {
+            recorder_.skip(seq);
         }
+        recordSpare_.push(std::move(*i420));
+        recordInflight_--;
+    };
+    recordInflight_++;
+    if (pool_) {
+        pool_->submit(encode);
+    } else {
+        encode();
+    }
+}
+
+// 把当前帧交给导出的消费者, 缓冲区导出了 dmabuf 时只传 fd, 否则由 FrameExporter 拷贝
+void Vvideo::exportFrame(int buf_index)
+{
+    const video_buf_t &vb = framebuf[buf_index];
+    const bool compressed = isMjpgStream();
+    ExportedFrame frame;
+    memset(&frame, 0, sizeof(frame));
+    frame.index = static_cast<uint32_t>(buf_index);
+    frame.sequence = vb.sequence;
+    frame.timestampUs = vb.timestampUs;
+    frame.fourcc = compressed ? V4L2_PIX_FMT_MJPEG : fmt;
+    frame.width = w;
+    frame.height = h;
+    frame.planes = static_cast<uint32_t>(std::min(vb.plane_count, MAX_PLANES));
+    const void *data[MAX_PLANES] = {nullptr};
+    for (uint32_t plane = 0; plane < frame.planes; plane++) {
+        const frame_data &fm = vb.fm[plane];
+        size_t length = fm.length;
+        if (fm.bytesused > 0 && fm.bytesused < length) length = fm.bytesused;
+        frame.fd[plane] = fm.dmabuf;
+        frame.bytesused[plane] = static_cast<uint32_t>(length);
+        frame.stride[plane] = compressed ? 0 : (fmt == V4L2_PIX_FMT_YUYV ? w * 2 : w);
+        data[plane] = fm.start;
     }
+    for (uint32_t plane = frame.planes; plane < MAX_PLANES; plane++) frame.fd[plane] = -1;
+    exporter_->publish(frame, data);
+}
 
-    // 关闭设备
-    close(fd);
-    fd = -1;
+int Vvideo::closeDevice()
+{
+    frameIndexQueue.clear(); // 清空队列
+    displayFrames.clear();
+    decodedFrames.clear();
+    renderedFrames.clear();
+    spareFrames.clear();
+    stillJobs.clear();
+    stillQueuedBytes_ = 0;
+    // 停止采集并释放缓冲区
+    for (int i = 0; i < bufferCount_; i++) {
+        for (int plane = 0; plane < MAX_PLANES; plane++) {
+            if (framebuf[i].fm[plane].dmabuf >= 0) ::close(framebuf[i].fm[plane].dmabuf);
+            framebuf[i].fm[plane].dmabuf = -1;
+        }
+    }
+    bufferCount_ = 0;
+    if (source_->close() < 0) return -1;
     qDebug() << "--------------";
 
     return 0;
@@ -7,10 +7,19 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <vector>
+#include <chrono>
 
 
 #include "libyuv.h"
 #include "queue_.h"
+#include "thread_pool.h"
+#include "frame_transform.h"
 
 #include <QObject>
 #include <QImage>
@@ -19,24 +28,117 @@
 #include <QMutexLocker>
 #include <thread>
 #include <QDebug>
-#include <QLabel>
+
+#include "preview_widget.h"
+#include "photo_writer.h"
+#include "capture_source.h"
+#include "video_recorder.h"
+#include "frame_exporter.h"
 
 #include <linux/videodev2.h>
 
 using namespace std;
 
-#define MAX_PLANES 3  // 假设最多支持3个平面
+#define NO_STILL_REQUEST (-1)  // 没有待处理的拍照请求
+#define DEFAULT_BURST_BUDGET (32u << 20)  // 连拍预录环/待保存帧的默认内存上限
+#define DEFAULT_RECORD_QUALITY 80  // YUYV/NV12 录像的 JPEG 质量
+#define LATENCY_SAMPLES_MAX 100000  // 延迟样本上限, 超出后不再记录
+#define DEFAULT_CAPTURE_DEPTH_MS 150  // 采集缓冲区要覆盖的流水线深度(毫秒)
+#define DEFAULT_CAPTURE_BUDGET (48u << 20)  // 采集缓冲区的默认内存上限
+
+// 一帧经过各阶段的时间点(CLOCK_MONOTONIC, 微秒), 随帧一路传到显示
+struct FrameTiming {
+    uint32_t sequence = 0;      // 驱动帧序号
+    int64_t captureUs = 0;      // 驱动时间戳
+    int64_t dequeueUs = 0;      // 出列
+    int64_t decodeEndUs = 0;    // 解码阶段完成
+    int64_t transformEndUs = 0; // 旋转缩放完成
+    int64_t displayUs = 0;      // UI 线程显示
+};
 
-typedef struct __frame {
-    void *start;                // 存储每个平面映射的内存
-    size_t length;               // 每个平面的长度
-    bool in_use;                 // 是否正在使用
-} frame_data;
+// 流水线各阶段之间传递的帧, 用完后回收给解码阶段复用其中的缓冲区
+struct StageFrame {
+    uint64_t seq = 0;
+    bool valid = false;         // 解码失败的帧只用于推进序号
+    FrameTiming timing;
+    QSize labelSize;            // 显示区域尺寸
+    FrameView view;             // 指向 argb 或 i420
+    QImage argb;                // MJPG 解码结果(RGB32)
+    std::vector<uint8_t> i420;  // YUYV/NV12 转换结果
+    QImage output;              // 旋转缩放后的显示帧(输出格式, 来自 FramePool)
+    std::chrono::steady_clock::time_point queuedAt;  // 进入下一阶段输入队列的时间
+};
 
-typedef struct __video_buffer {
-    frame_data fm[MAX_PLANES];
-    int plane_count;            // 平面的数量
-} video_buf_t;
+// 拍照任务: 原始帧的拷贝, 采集缓冲区不必等全分辨率解码完成就能归还驱动
+struct StillJob {
+    video_buf_t buf;                        // 平面指针指向 data 或 memory
+    std::vector<uint8_t> data[MAX_PLANES];
+    std::shared_ptr<void> memory[MAX_PLANES]; // USERPTR 模式下从采集源摘下的原始帧, 不拷贝
+    bool passthrough = false;               // data[0] 为补全霍夫曼表的 JPEG, 直接保存
+    bool rotate = true;
+    int64_t shutterUs = 0;                  // 请求拍照的时间(CLOCK_MONOTONIC, 微秒)
+};
+
+// 交给 UI 线程显示的帧, 与预览控件共享 FramePool 中的缓冲区, 不转换为 QPixmap
+struct DisplayFrame {
+    QImage image;
+    FrameTiming timing;
+};
+
+// 显示端统计, 在 UI 线程实际显示帧时更新
+struct DisplayStats {
+    double fps;                 // 最近一个统计窗口(约 1 秒)实际显示的帧率
+    double avgLatencyMs;        // 最近一个统计窗口采集到显示的平均延迟
+    double lastLatencyMs;       // 最近一帧采集到显示的延迟
+    uint64_t displayedFrames;   // 已显示帧数
+    uint64_t replacedFrames;    // UI 来不及显示、被更新的帧替换掉的帧数
+    // 最近一个统计窗口内各段的平均耗时
+    double avgDequeueMs;        // 驱动时间戳 -> 出列
+    double avgDecodeMs;         // 出列 -> 解码完成
+    double avgTransformMs;      // 解码完成 -> 旋转缩放完成
+    double avgPresentMs;        // 旋转缩放完成 -> 显示
+    uint32_t lastSequence;      // 最近显示帧的驱动序号
+};
+
+// 采集端统计, 由采集线程累加
+struct CaptureStats {
+    uint64_t dequeued;          // 出列的帧数
+    uint64_t sequenceGaps;      // 驱动序号不连续的次数
+    uint64_t lostFrames;        // 按序号推算驱动侧丢失的帧数(缓冲区耗尽等)
+    uint64_t errorFrames;       // 驱动标记 V4L2_BUF_FLAG_ERROR 的帧数
+    uint64_t requeuedBusy;      // 缓冲区仍被占用, 未处理直接归还的帧数
+    uint64_t overflowDropped;   // 处理跟不上, 从索引队列中挤掉的帧数
+    uint32_t lastSequence;      // 最近出列帧的驱动序号
+    uint64_t detachedFrames;    // USERPTR 模式下直接摘下、没有拷贝的拍照/连拍帧数
+    int buffers;                // 驱动实际给出的采集缓冲区数
+    size_t bufferBytes;         // 采集缓冲区占用的内存(不含 USERPTR 备用块)
+    uint64_t starvation;        // 出列时驱动手里已没有空缓冲区的次数, 持续出现说明缓冲区不够
+    int minFreeBuffers;         // 出列时驱动手里空缓冲区数的最小值, 长期较大说明缓冲区过多
+};
+
+// 单个流水线阶段的统计
+struct StageStats {
+    const char *name;
+    size_t queued;              // 输入队列当前帧数
+    size_t capacity;            // 输入队列容量
+    uint64_t dropped;           // 输入队列丢弃的帧数
+    uint64_t frames;            // 已处理帧数
+    double avgWaitUs;           // 平均排队时间
+    double avgProcessUs;        // 平均处理时间
+};
+
+// 阶段计数器, 由阶段线程累加, 任意线程读取
+struct StageCounter {
+    std::atomic<uint64_t> frames{0};
+    std::atomic<uint64_t> waitUs{0};
+    std::atomic<uint64_t> processUs{0};
+
+    void add(uint64_t wait, uint64_t process) {
+        waitUs += wait;
+        processUs += process;
+        frames++;
+    }
+};
 
 
 
@@ -44,21 +146,46 @@ class Vvideo : public QObject {
     Q_OBJECT    // 信号与槽必要宏
 public:
     
-    explicit Vvideo(const bool& is_M_, QLabel *Label, QObject *parent=nullptr);
+    explicit Vvideo(const bool& is_M_, PreviewWidget *preview, QObject *parent=nullptr);
+    // 使用指定的采集源(如 ReplaySource 回放文件), 取得其所有权
+    Vvideo(std::unique_ptr<CaptureSource> source, PreviewWidget *preview, QObject *parent=nullptr);
+    // 析构前必须先 stop() 并等 run() 返回(join 运行 run() 的线程)
     ~Vvideo();
 
     void run() {
+        // 转换线程池, 处理线程负责分发
+        if (workerThreads_ > 1) pool_.reset(new ThreadPool(workerThreads_));
         // 开启线程
+        // 采集 -> 解码 -> 旋转缩放 -> 显示, 各阶段一个线程, 由有界队列连接
         captureThread_ = std::thread(&Vvideo::captureFrame, this);
-        processThread_ = std::thread(&Vvideo::processFrame, this, displayLabel);
+        processThread_ = std::thread(&Vvideo::processFrame, this, displayWidget);
+        transformThread_ = std::thread(&Vvideo::transformFrame, this);
+        presentThread_ = std::thread(&Vvideo::presentFrame, this);
+        stillThread_ = std::thread(&Vvideo::stillFrame, this);
 
-        captureThread_.detach();
-        processThread_.detach();
         qDebug()<<"Thread running...";
-        while (!quit_) {
-            // 执行线程的主要逻辑
-            std::this_thread::sleep_for(std::chrono::milliseconds(3000)); // 模拟工作
+        {
+            // 等待 stop() 唤醒, 不再定时轮询退出标志
+            std::unique_lock<std::mutex> lock(runMutex_);
+            runCond_.wait(lock, [this]() { return quit_.load(); });
         }
+        // 关闭队列, 唤醒阻塞在队列上的各阶段线程
+        closeQueues();
+        if (captureThread_.joinable()) captureThread_.join();
+        if (processThread_.joinable()) processThread_.join();
+        if (transformThread_.joinable()) transformThread_.join();
+        if (presentThread_.joinable()) presentThread_.join();
+        if (stillThread_.joinable()) stillThread_.join();
+        // 等待已分发的帧处理完并归还缓冲区
+        pool_.reset();
+        // 消费者还没归还的帧全部收回
+        if (exporter_) exporter_->releaseAll();
+        // 所有编码任务已结束, 收尾录像文件
+        recorder_.stop();
+        recorder_.wait();
+        reorderFrames_.clear();
+        preroll_.clear();
+        prerollBytes_ = 0;
         qDebug()<<"Thread exited.";
     }
     
@@ -67,35 +194,210 @@ public:
     int setFormat(const __u32& w_, const __u32&h_, const __u32& fmt_);
     int initBuffers();
 
+    // 在 UI 线程中显示最新的一帧, 由 frameReady 信号以 QueuedConnection 触发
     void updateImage();
-    void takePic(QImage &img);
+    DisplayStats displayStats();
+    CaptureStats captureStats();
+    // 拍照: 对采集时间不早于 notBeforeUs(CLOCK_MONOTONIC 微秒, 0 表示下一帧)的第一帧做全分辨率解码
+    // 立即返回, 解码在拍照线程中进行, 预览照常运行
+    // 设置了 PhotoWriter 时照片交给它保存, 否则由 stillReady 送出; 失败时 stillReady 送出空图像
+    void requestStill(int64_t notBeforeUs = 0);
+    // 照片保存服务, 需在 run() 之前设置, 生命周期由调用者管理
+    void setPhotoWriter(PhotoWriter *writer) { photoWriter_ = writer; }
+    // MJPG 拍照直通: 把摄像头输出的 JPEG 直接交给 PhotoWriter, 不解码也不重新编码
+    // 需要设置 PhotoWriter; 非 MJPG 格式始终解码
+    void setJpegPassthrough(bool enable) { jpegPassthrough_ = enable; }
+    // 拍照是否与预览一样旋转 270 度, 直通模式下用 tjTransform 无损旋转
+    void setStillRotation(bool rotate) { stillRotate_ = rotate; }
+    // 连拍: 保存快门前 preFrames 帧(预录)和快门起 postFrames 帧, 默认 0/1 即单张
+    // preFrames > 0 时处理线程把每帧原始数据(MJPG 为压缩数据)拷贝进预录环, 预录环和待保存帧各自不超过 ramBudget 字节
+    // 超出预算的连拍帧直接丢弃, 不会阻塞预览
+    void setBurst(int preFrames, int postFrames, size_t ramBudget = DEFAULT_BURST_BUDGET);
+    // 录像为 MJPEG-AVI, 帧率取驱动实际的 timeperframe, 帧位置按 V4L2 时间戳排布
+    // MJPG 直接写入摄像头输出的 JPEG, 不解码不转码; YUYV/NV12 在线程池中用 TurboJPEG 编码(quality 为质量)
+    // 画面保持摄像头原始方向, 不做预览的 270 度旋转
+    // 编码或写盘跟不上时丢帧并计数, 不会拖慢预览
+    bool startRecording(const QString &fileName, int quality = DEFAULT_RECORD_QUALITY);
+    // 立即返回, 文件在写入线程中收尾, 完成后发出 recordingFinished
+    void stopRecording() { recorder_.stop(); }
+    bool isRecording() const { return recorder_.active(); }
+    RecordingStats recordingStats() { return recorder_.stats(); }
+    // 预览缩放解码开关(仅 MJPG), 拍照始终按全分辨率解码
+    void setPreviewScaledDecode(bool enable) { previewScaledDecode_ = enable; }
+    // 转换线程数, 需在 run() 之前设置; 小于等于 1 时在处理线程中串行转换
+    // YUYV/NV12 每帧按水平条带并行, MJPG 按帧并行解码, 显示顺序与采集顺序一致
+    void setWorkerThreads(int count) { workerThreads_ = count; }
+    // 预览输出格式, 默认与屏幕一致(PreviewWidget::nativeFormat), 绘制时 Qt 不再逐像素转换
+    // 可在运行中切换, 不支持的格式返回 false
+    bool setOutputFormat(QImage::Format format);
+    QImage::Format outputFormat() const { return outputFormat_; }
+    // 没有预览控件(preview 为 nullptr, 如 --bench)时图像适配的区域大小
+    void setTargetSize(const QSize &size) { targetWidth_ = size.width(); targetHeight_ = size.height(); }
+    // 逐帧记录采集到显示的延迟(微秒), 用于统计分位数; takeLatencySamples 取走已记录的样本
+    void setLatencySampling(bool enable);
+    std::vector<uint32_t> takeLatencySamples();
+    // 各流水线阶段的队列占用和耗时, 顺序为 decode, transform, present
+    std::vector<StageStats> stageStats();
+    // 帧导出: 每帧以 dmabuf(驱动不支持时为 memfd 拷贝) + 元数据交给其它组件或进程, 见 FrameExporter
+    // socketPath 非空时在该路径监听外部进程; 需在 initBuffers 之前调用
+    bool enableFrameExport(const std::string &socketPath);
+    // 采集写入程序自己的页对齐内存(V4L2_MEMORY_USERPTR, 默认开启), 拍照/连拍帧直接摘下不拷贝
+    // 驱动不支持时自动使用 MMAP; 开启帧导出时始终使用 MMAP 以便导出 dmabuf; 需在 initBuffers 之前设置
+    void setUserPtrCapture(bool enable) { userPtrCapture_ = enable; }
+    // 采集缓冲区数按预算确定: 帧率 × depthMs 覆盖流水线中的帧, 再加一个留给驱动填充
+    // 总大小(帧大小 × 数量)不超过 maxBytes, 但不少于可运行的最小数量; 需在 initBuffers 之前设置
+    void setCaptureBudget(int depthMs, size_t maxBytes) { captureDepthMs_ = depthMs; captureBudget_ = maxBytes; }
+    FrameExporter *frameExporter() { return exporter_.get(); }
     int closeDevice();
   
     void stop() {
-        quit_ = true;  // 设置退出标志
+        {
+            std::lock_guard<std::mutex> lock(runMutex_);
+            quit_ = true;  // 设置退出标志
+        }
+        runCond_.notify_all();
+        closeQueues();
     }  
+
+signals:
+    // 有新帧可显示; 在 UI 线程取走之前不会重复发出, 期间到达的帧只替换待显示帧
+    void frameReady();
+    // 拍照结果(全分辨率, 已旋转), 解码失败或请求被丢弃时 image 为空
+    void stillReady(const QImage &image, qint64 captureUs);
+    // 录像文件收尾完成(在录像写入线程中发出), ok 为 false 表示写盘出错
+    void recordingFinished(const QString &fileName, bool ok);
+
 private:
-    int fd;
-    bool is_M;
+    std::unique_ptr<CaptureSource> source_;  // 采集源: V4L2 设备或文件回放
     __u32 w,h,fmt;
     std::atomic<bool> quit_{false};  // 使用 atomic 防止竞态 退出标志
     // QMutex mutex;              /* 线程锁交由queue处理 */
     std::thread captureThread_;
     std::thread processThread_;
-    QLabel *displayLabel = nullptr;
+    std::thread transformThread_;
+    std::thread presentThread_;
+    std::thread stillThread_;
+    PreviewWidget *displayWidget = nullptr;
+    std::mutex runMutex_;
+    std::condition_variable runCond_;
     // SafeQueue<video_buf_t> frameQueue; // 原始数据帧队列
-    SafeQueue<int> frameIndexQueue; // 尝试用索引队列(失败)
-    SafeQueue<QPixmap> QPixmapframes;    // 处理后帧队列
-    struct v4l2_buffer buffer;
+    RingQueue<int> frameIndexQueue;      // 待处理的缓冲区索引, 满时挤掉最旧帧
+    RingQueue<DisplayFrame> displayFrames; // 待显示帧, 只保留最新一帧
+    RingQueue<StageFrame> decodedFrames;  // 解码 -> 旋转缩放, 满时阻塞上游
+    RingQueue<StageFrame> renderedFrames; // 旋转缩放 -> 显示, 满时阻塞上游
+    RingQueue<StageFrame> spareFrames;    // 显示完的帧, 回收给解码阶段
+    RingQueue<StillJob> stillJobs;       // 待解码的拍照帧, 超出数量或内存预算时丢弃
+    std::atomic<int64_t> stillRequestUs_{NO_STILL_REQUEST}; // 待处理的拍照请求(notBeforeUs)
+    std::atomic<int64_t> stillShutterUs_{0};
+    std::atomic<bool> stillRotate_{true};
+    std::atomic<bool> jpegPassthrough_{false};
+    std::atomic<int> burstPre_{0};
+    std::atomic<int> burstPost_{1};
+    std::atomic<size_t> burstBudget_{DEFAULT_BURST_BUDGET};
+    std::atomic<size_t> stillQueuedBytes_{0}; // stillJobs 中原始数据的字节数
+    std::atomic<uint64_t> stillDropped_{0};
+    // 预录环和连拍剩余帧数, 仅处理线程使用
+    std::deque<StillJob> preroll_;
+    size_t prerollBytes_ = 0;
+    int burstRemaining_ = 0;
+    int64_t burstShutterUs_ = 0;
+    PhotoWriter *photoWriter_ = nullptr;
+    VideoRecorder recorder_;
+    std::atomic<int> recordQuality_{DEFAULT_RECORD_QUALITY};
+    std::atomic<int> recordInflight_{0};     // 正在线程池中编码的录像帧数
+    RingQueue<std::vector<uint8_t>> recordSpare_; // 编码完的 I420 缓冲区, 回收复用
+    std::atomic<bool> previewScaledDecode_{true}; // 预览时 MJPG 按显示尺寸缩放解码
     video_buf_t *framebuf = nullptr; // 映射
+    int bufferCount_ = 0;            // 采集源实际提供的缓冲区数
+    // 缓冲区引用计数: 处理线程 1 个, 导出的每个消费者各 1 个, 归零后才归还给采集源
+    std::unique_ptr<std::atomic<int>[]> bufferRefs_;
+    std::unique_ptr<FrameExporter> exporter_;
+    bool userPtrCapture_ = true;
+    int captureDepthMs_ = DEFAULT_CAPTURE_DEPTH_MS;
+    size_t captureBudget_ = DEFAULT_CAPTURE_BUDGET;
+    size_t bufferBytes_ = 0;
+    std::atomic<int> buffersHeld_{0};           // 已出列、尚未归还给采集源的缓冲区数
+    std::atomic<uint64_t> starvation_{0};
+    std::atomic<int> minFreeBuffers_{0};
+    StageCounter decodeCounter_;
+    StageCounter transformCounter_;
+    StageCounter presentCounter_;
+    std::atomic<bool> notifyPending_{false};
+    // 采集统计, 由采集线程更新
+    std::atomic<uint64_t> dequeued_{0};
+    std::atomic<uint64_t> sequenceGaps_{0};
+    std::atomic<uint64_t> lostFrames_{0};
+    std::atomic<uint64_t> errorFrames_{0};
+    std::atomic<uint64_t> requeuedBusy_{0};
+    std::atomic<uint64_t> overflowDropped_{0};
+    std::atomic<uint64_t> detachedFrames_{0};
+    std::atomic<uint32_t> lastSequence_{0};
+    // 显示统计, 由 UI 线程更新
+    std::mutex displayMutex_;
+    uint64_t displayedFrames_ = 0;
+    int64_t lastLatencyUs_ = 0;
+    int64_t windowStartUs_ = 0;
+    int windowFrames_ = 0;
+    int64_t windowLatencyUs_ = 0;
+    int64_t windowDequeueUs_ = 0;
+    int64_t windowDecodeUs_ = 0;
+    int64_t windowTransformUs_ = 0;
+    int64_t windowPresentUs_ = 0;
+    FrameTiming lastTiming_;
+    double avgDequeueMs_ = 0;
+    double avgDecodeMs_ = 0;
+    double avgTransformMs_ = 0;
+    double avgPresentMs_ = 0;
+    double displayFps_ = 0;
+    double avgLatencyMs_ = 0;
+    bool latencySampling_ = false;
+    std::vector<uint32_t> latencySamples_;
+    std::atomic<int> targetWidth_{800};
+    std::atomic<int> targetHeight_{480};
+
+    int workerThreads_ = ThreadPool::defaultThreadCount();
+    std::atomic<QImage::Format> outputFormat_{QImage::Format_RGB32};
+    std::unique_ptr<ThreadPool> pool_;
+    uint64_t frameSeq_ = 0;          // 分发序号, 仅处理线程使用
+    // 按帧并行时的重排: 工作线程完成顺序不定, 按序号依次送入旋转缩放阶段
+    std::mutex reorderMutex_;
+    std::map<uint64_t, StageFrame> reorderFrames_;
+    uint64_t nextSeq_ = 0;
+    // 按帧并行时同时处理的帧数不超过线程数, 其余帧留在索引队列中按策略丢弃
+    std::mutex inflightMutex_;
+    std::condition_variable inflightCond_;
+    int inflight_ = 0;
     
     int captureFrame();
-    void processFrame(QLabel *displayLabel);
+    void processFrame(PreviewWidget *displayWidget);
+    void transformFrame();
+    void presentFrame();
+    void stillFrame();
+    void handleStill(int buf_index);
+    bool copyStill(int buf_index, StillJob &job);
+    void pushStill(StillJob &&job);
+    void keepPreroll(int buf_index);
+    void saveJpegStill(StillJob &job);
+    void failStill(const StillJob &job);
+    void recordFrame(int buf_index);
+    int captureBufferTarget();
+    void exportBuffers();
+    void exportFrame(int buf_index);
+    void closeQueues();
+    void logStageStats();
+    void recordDisplayed(const FrameTiming &timing);
+    void updateOverlay();
 
-    int initSinglePlaneBuffers();
-    int initMultiPlaneBuffers();
+    void requeueBuffer(int index);
+    bool isMjpgStream() const;
+    void dispatchMjpg(int buf_index, StageFrame &&frame, const QSize &decodeBox);
+    void deliverFrame(StageFrame &&frame);
 
-    void MJPG2RGB(QImage &image_, void *data, size_t length);
+    bool rawFrameView(const video_buf_t &vb, FrameView &view);
+    bool decodePreview(int buf_index, const QSize &decodeBox, StageFrame &frame, ThreadPool *pool);
+    bool convertFrame(const video_buf_t &vb, QImage &image_, const QSize &fitSize);
+    void prepareFrameImage(QImage &image_);
+    bool MJPG2RGB(QImage &image_, void *data, size_t length, const QSize &fitSize = QSize());
     void YUYV2RGB(QImage &image_, void *data, size_t length);
     void NV12ToRGB(QImage &image_, void *data_y, size_t len_y, void *data_uv, size_t len_uv);
 
@@ -0,0 +1,175 @@
+#include "video_recorder.h"
+
+#include <QDebug>
+
+#include "trace.h"
+
+VideoRecorder::VideoRecorder(int queueLen)
+    : frames_(queueLen > 0 ? queueLen : 1, OverflowPolicy::DropNewest)
+{
+}
+
+VideoRecorder::~VideoRecorder()
+{
+    stop();
+    wait();
+}
+
+bool VideoRecorder::start(const QString &fileName, int width, int height, uint32_t rate, uint32_t scale)
+{
+    stop();
+    wait();
+    basePath_ = fileName.toLocal8Bit().toStdString();
+    width_ = width;
+    height_ = height;
+    rate_ = rate;
+    scale_ = scale;
+    writeFailed_ = false;
+    written_ = 0;
+    dropped_ = 0;
+    duplicated_ = 0;
+    bytes_ = 0;
+    files_ = 0;
+    if (!openSegment()) return false;
+
+    frames_.reset();
+    {
+        std::lock_guard<std::mutex> lock(reorderMutex_);
+        nextWrite_ = nextSeq_;
+        active_ = true;
+    }
+    thread_ = std::thread(&VideoRecorder::writerLoop, this);
+    qDebug() << "Recording to" << fileName << width << "x" << height << "at" << rate << "/" << scale << "fps";
+    return true;
+}
+
+void VideoRecorder::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(reorderMutex_);
+        if (!active_) return;
+        active_ = false;
+        // 还在编码的帧之后到达时序号小于 nextWrite_, 直接忽略
+        dropped_ += reorder_.size();
+        reorder_.clear();
+        nextWrite_ = nextSeq_;
+    }
+    // 写入线程写完队列中剩余的帧后收尾并退出, 这里不等待
+    frames_.close();
+}
+
+void VideoRecorder::wait()
+{
+    if (thread_.joinable()) thread_.join();
+}
+
+uint64_t VideoRecorder::reserve()
+{
+    std::lock_guard<std::mutex> lock(reorderMutex_);
+    return nextSeq_++;
+}
+
+void VideoRecorder::submit(uint64_t seq, std::vector<uint8_t> &&jpeg, int64_t timestampUs)
+{
+    Frame frame;
+    frame.jpeg = std::move(jpeg);
+    frame.timestampUs = timestampUs;
+    complete(seq, std::move(frame));
+}
+
+void VideoRecorder::skip(uint64_t seq)
+{
+    complete(seq, Frame());
+}
+
+// 按序号送入写盘队列; 写盘跟不上时丢弃本帧
+void VideoRecorder::complete(uint64_t seq, Frame &&frame)
+{
+    std::lock_guard<std::mutex> lock(reorderMutex_);
+    if (!active_ || seq < nextWrite_) return;
+    reorder_[seq] = std::move(frame);
+    while (!reorder_.empty() && reorder_.begin()->first == nextWrite_) {
+        Frame ready = std::move(reorder_.begin()->second);
+        reorder_.erase(reorder_.begin());
+        nextWrite_++;
+        if (ready.jpeg.empty() || frames_.push(std::move(ready)) != QueueStatus::Ok) {
+            dropped_++;
+        }
+    }
+}
+
+bool VideoRecorder::openSegment()
+{
+    std::string path = basePath_;
+    const int index = files_;
+    if (index > 0) {
+        // name.avi -> name_1.avi
+        const size_t dot = path.rfind('.');
+        const size_t slash = path.rfind('/');
+        const std::string suffix = "_" + std::to_string(index);
+        if (dot != std::string::npos && (slash == std::string::npos || dot > slash)) {
+            path.insert(dot, suffix);
+        } else {
+            path += suffix;
+        }
+    }
+    if (!avi_.open(path, width_, height_, rate_, scale_)) {
+        qDebug() << "Failed to open video file" << path.c_str();
+        return false;
+    }
+    files_++;
+    return true;
+}
+
+void VideoRecorder::writerLoop()
+{
+    Tracer::setThreadName("record");
+    Frame frame;
+    while (frames_.pop(frame) == QueueStatus::Ok) {
+        if (writeFailed_) {
+            dropped_++;
+            continue;
+        }
+        // 超过单文件上限前切换到下一段, 时间戳在新文件中重新对齐
+        if (avi_.projectedBytes() + frame.jpeg.size() + 24 > AVI_MAX_FILE_BYTES) {
+            avi_.close();
+            if (!openSegment()) {
+                writeFailed_ = true;
+                dropped_++;
+                continue;
+            }
+        }
+        const int gap = avi_.writeFrame(frame.jpeg.data(), frame.jpeg.size(), frame.timestampUs);
+        if (gap < 0) {
+            // 磁盘写满或出错, 之后的帧全部丢弃, 已写部分在 stop 时照常收尾
+            qDebug() << "Recording write failed, dropping remaining frames";
+            writeFailed_ = true;
+            dropped_++;
+            continue;
+        }
+        written_++;
+        duplicated_ += static_cast<uint64_t>(gap);
+        bytes_ += frame.jpeg.size();
+    }
+
+    // 队列已关闭且写空: 回写索引并关闭文件
+    const bool ok = avi_.close() && !writeFailed_;
+    const RecordingStats st = stats();
+    qDebug() << "Recording stopped:" << st.written << "frames," << st.bytes / 1024 << "KiB in" << st.files
+             << "file(s)," << st.dropped << "dropped," << st.duplicated << "duplicated";
+    if (finished_) finished_(basePath_, ok);
+}
+
+RecordingStats VideoRecorder::stats()
+{
+    RecordingStats st;
+    st.active = active_;
+    st.written = written_;
+    st.dropped = dropped_;
+    st.duplicated = duplicated_;
+    st.bytes = bytes_;
+    st.queued = frames_.size();
+    st.capacity = frames_.capacity();
+    st.files = files_;
+    return st;
+}
@@ -0,0 +1,107 @@
+#ifndef VIDEO_RECORDER_H
+#define VIDEO_RECORDER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <QString>
+
+#include "avi_writer.h"
+#include "queue_.h"
+
+#define RECORD_QUEUE_LEN 32     // 等待写盘的帧数上限(30fps 约 1 秒), 满了丢帧而不阻塞采集
+
+// 录像统计
+struct RecordingStats {
+    bool active;
+    uint64_t written;       // 已写入的帧数
+    uint64_t dropped;       // 来不及编码/写盘而丢弃的帧数
+    uint64_t duplicated;    // 按时间戳补的空帧数(相机或本程序掉帧)
+    uint64_t bytes;         // 已写入的帧数据字节数
+    size_t queued;          // 等待写盘的帧数
+    size_t capacity;
+    int files;              // 已打开的文件数(超过单文件上限时分段)
+};
+
+/*
+ * 录像写入服务: 把已编码的 JPEG 帧按采集顺序写入 MJPEG-AVI
+ * 采集侧按帧调用 reserve() 取序号, 编码可以在线程池中乱序完成, submit() 后按序号重新排好再进入写盘队列
+ * 写盘在独立线程中进行(write-behind), 队列满时丢帧并计数, 不会让采集或预览等磁盘
+ * 单个文件接近 AVI_MAX_FILE_BYTES 时自动切换到 name_1.avi, name_2.avi ...
+ * 结束录像时的收尾(写完剩余帧, fdatasync, 回写索引)也在写入线程中进行, 完成后调用 finished 回调
+ */
+class VideoRecorder {
+public:
+    // 收尾完成, 在写入线程中调用; path 为第一段文件名, ok 为 false 表示写盘出错
+    typedef std::function<void(const std::string &path, bool ok)> FinishedCallback;
+
+    explicit VideoRecorder(int queueLen = RECORD_QUEUE_LEN);
+    ~VideoRecorder();
+
+    VideoRecorder(const VideoRecorder&) = delete;
+    VideoRecorder& operator=(const VideoRecorder&) = delete;
+
+    // 开始录像, 帧率为 rate/scale; 已在录像时先结束当前录像
+    bool start(const QString &fileName, int width, int height, uint32_t rate, uint32_t scale);
+    // 结束录像并立即返回: 丢弃还在编码的帧, 写入线程写完队列中的帧后回写索引并关闭文件
+    void stop();
+    // 等待上一次录像收尾完成
+    void wait();
+    // 需在 start 之前设置
+    void setFinishedCallback(const FinishedCallback &callback) { finished_ = callback; }
+    bool active() const { return active_; }
+
+    // 按采集顺序为一帧分配序号, 之后必须以该序号调用 submit 或 skip
+    uint64_t reserve();
+    // 交付编码好的帧, timestampUs 为采集时间
+    void submit(uint64_t seq, std::vector<uint8_t> &&jpeg, int64_t timestampUs);
+    // 放弃该帧(编码失败或来不及编码), 计入丢帧
+    void skip(uint64_t seq);
+
+    RecordingStats stats();
+
+private:
+    struct Frame {
+        std::vector<uint8_t> jpeg;      // 为空表示被跳过
+        int64_t timestampUs = 0;
+    };
+
+    void complete(uint64_t seq, Frame &&frame);
+    void writerLoop();
+    bool openSegment();
+
+    RingQueue<Frame> frames_;
+    std::thread thread_;
+    FinishedCallback finished_;
+    std::atomic<bool> active_{false};
+
+    // 重排, 序号在多次录像之间单调递增, 结束录像后迟到的帧直接忽略
+    std::mutex reorderMutex_;
+    std::map<uint64_t, Frame> reorder_;
+    uint64_t nextSeq_ = 0;
+    uint64_t nextWrite_ = 0;
+
+    // 只在写入线程(及 start/stop)使用
+    AviWriter avi_;
+    std::string basePath_;
+    int width_ = 0;
+    int height_ = 0;
+    uint32_t rate_ = 30;
+    uint32_t scale_ = 1;
+    bool writeFailed_ = false;
+
+    std::atomic<uint64_t> written_{0};
+    std::atomic<uint64_t> dropped_{0};
+    std::atomic<uint64_t> duplicated_{0};
+    std::atomic<uint64_t> bytes_{0};
+    std::atomic<int> files_{0};
+};
+
+#endif // VIDEO_RECORDER_H
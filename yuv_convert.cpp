@@ -0,0 +1,264 @@
+#include "yuv_convert.h"
+
+#include <vector>
+
+#if defined(__arm__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+namespace yuvconv {
+namespace detail {
+
+namespace {
+
+inline uint8_t clamp255(int v)
+{
+    return static_cast<uint8_t>(v < 0 ? 0 : (v > 255 ? 255 : v));
+}
+
+// 6 位定点 BT.601: 1.164 -> 74, 1.596 -> 102, 0.391 -> 25, 0.813 -> 52, 2.018 -> 129
+// SIMD 实现使用相同系数和 16 位饱和运算, 结果与此处逐位一致
+inline void yuvToRgb(int y, int u, int v, uint8_t &r, uint8_t &g, uint8_t &b)
+{
+    const int y1 = y * 74 - 1152;   // (y - 16) * 74 + 32(舍入)
+    const int d = u - 128;
+    const int e = v - 128;
+    r = clamp255((y1 + 102 * e) >> 6);
+    g = clamp255((y1 - 25 * d - 52 * e) >> 6);
+    b = clamp255((y1 + 129 * d) >> 6);
+}
+
+} // namespace
+
+void rowToRGB888_C(const uint8_t *y, const uint8_t *u, const uint8_t *v, uint8_t *dst, int width)
+{
+    for (int x = 0; x < width; x++) {
+        yuvToRgb(y[x], u[x >> 1], v[x >> 1], dst[0], dst[1], dst[2]);
+        dst += 3;
+    }
+}
+
+void rowToBGRA_C(const uint8_t *y, const uint8_t *u, const uint8_t *v, uint8_t *dst, int width)
+{
+    for (int x = 0; x < width; x++) {
+        yuvToRgb(y[x], u[x >> 1], v[x >> 1], dst[2], dst[1], dst[0]);
+        dst[3] = 0xFF;
+        dst += 4;
+    }
+}
+
+void rowToRGB565_C(const uint8_t *y, const uint8_t *u, const uint8_t *v, uint8_t *dst, int width)
+{
+    for (int x = 0; x < width; x++) {
+        uint8_t r, g, b;
+        yuvToRgb(y[x], u[x >> 1], v[x >> 1], r, g, b);
+        const uint16_t px = static_cast<uint16_t>(((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3));
+        dst[0] = static_cast<uint8_t>(px & 0xFF);
+        dst[1] = static_cast<uint8_t>(px >> 8);
+        dst += 2;
+    }
+}
+
+void splitUV_C(const uint8_t *uv, uint8_t *u, uint8_t *v, int count)
+{
+    for (int i = 0; i < count; i++) {
+        u[i] = uv[2 * i];
+        v[i] = uv[2 * i + 1];
+    }
+}
+
+void splitYUY2_C(const uint8_t *src, uint8_t *y, uint8_t *u, uint8_t *v, int width)
+{
+    for (int x = 0; x + 1 < width; x += 2) {
+        y[x] = src[0];
+        u[x >> 1] = src[1];
+        y[x + 1] = src[2];
+        v[x >> 1] = src[3];
+        src += 4;
+    }
+    if (width & 1) {
+        y[width - 1] = src[0];
+        u[width >> 1] = src[1];
+        v[width >> 1] = src[3];
+    }
+}
+
+} // namespace detail
+
+namespace {
+
+using detail::Kernels;
+
+Kernels scalarKernels()
+{
+    Kernels k;
+    k.toRGB888 = detail::rowToRGB888_C;
+    k.toBGRA = detail::rowToBGRA_C;
+    k.toRGB565 = detail::rowToRGB565_C;
+    k.splitUV = detail::splitUV_C;
+    k.splitYUY2 = detail::splitYUY2_C;
+    return k;
+}
+
+bool cpuHas(Isa isa)
+{
+    switch (isa) {
+    case Isa::Scalar:
+        return true;
+#if defined(__x86_64__) || defined(__i386__)
+    case Isa::SSE2:
+        return __builtin_cpu_supports("sse2");
+    case Isa::AVX2:
+        return __builtin_cpu_supports("avx2");
+#endif
+#if defined(__aarch64__)
+    case Isa::NEON:
+        return true;
+#elif defined(__arm__)
+    case Isa::NEON:
+        return (getauxval(AT_HWCAP) & HWCAP_NEON) != 0;
+#endif
+    default:
+        return false;
+    }
+}
+
+bool loadKernels(Isa isa, Kernels &k)
+{
+    k = scalarKernels();
+    if (!cpuHas(isa)) return false;
+    switch (isa) {
+    case Isa::Scalar: return true;
+    case Isa::SSE2:   return detail::kernelsSSE2(k);
+    case Isa::AVX2:   return detail::kernelsAVX2(k);
+    case Isa::NEON:   return detail::kernelsNEON(k);
+    }
+    return false;
+}
+
+struct Dispatch {
+    Kernels kernels;
+    Isa isa;
+
+    Dispatch()
+    {
+        // 按优先级探测
+        static const Isa order[] = {Isa::AVX2, Isa::NEON, Isa::SSE2};
+        isa = Isa::Scalar;
+        kernels = scalarKernels();
+        for (Isa candidate : order) {
+            Kernels k;
+            if (loadKernels(candidate, k)) {
+                kernels = k;
+                isa = candidate;
+                break;
+            }
+        }
+    }
+};
+
+Dispatch &dispatch()
+{
+    static Dispatch d;
+    return d;
+}
+
+// 行缓冲区按线程复用
+struct RowBuffers {
+    std::vector<uint8_t> y, u, v;
+};
+
+RowBuffers &rowBuffers(int width)
+{
+    static thread_local RowBuffers buf;
+    const size_t chroma = static_cast<size_t>(width + 1) / 2;
+    if (buf.y.size() < static_cast<size_t>(width)) buf.y.resize(width);
+    if (buf.u.size() < chroma) {
+        buf.u.resize(chroma);
+        buf.v.resize(chroma);
+    }
+    return buf;
+}
+
+} // namespace
+
+Isa activeIsa()
+{
+    return dispatch().isa;
+}
+
+const char *isaName(Isa isa)
+{
+    switch (isa) {
+    case Isa::Scalar: return "scalar";
+    case Isa::SSE2:   return "sse2";
+    case Isa::AVX2:   return "avx2";
+    case Isa::NEON:   return "neon";
+    }
+    return "unknown";
+}
+
+bool isaSupported(Isa isa)
+{
+    Kernels k;
+    return loadKernels(isa, k);
+}
+
+bool setIsa(Isa isa)
+{
+    Kernels k;
+    if (!loadKernels(isa, k)) return false;
+    dispatch().kernels = k;
+    dispatch().isa = isa;
+    return true;
+}
+
+int bytesPerPixel(OutFormat out)
+{
+    switch (out) {
+    case OutFormat::RGB888: return 3;
+    case OutFormat::BGRA:   return 4;
+    case OutFormat::RGB565: return 2;
+    }
+    return 0;
+}
+
+int convert(InFormat in, const Planes &src, int width, int height,
+            uint8_t *dst, int dstStride, OutFormat out)
+{
+    if (width <= 0 || height <= 0 || !dst || !src.data[0]) return -1;
+    if (in != InFormat::YUYV && !src.data[1]) return -1;
+    if (in == InFormat::I420 && !src.data[2]) return -1;
+
+    const Kernels &k = dispatch().kernels;
+    detail::RowFn row = out == OutFormat::RGB888 ? k.toRGB888
+                      : out == OutFormat::BGRA   ? k.toBGRA
+                                                 : k.toRGB565;
+    RowBuffers &buf = rowBuffers(width);
+    const int chroma = (width + 1) / 2;
+
+    for (int y = 0; y < height; y++) {
+        const uint8_t *yRow = src.data[0] + static_cast<size_t>(y) * src.stride[0];
+        const uint8_t *uRow = buf.u.data();
+        const uint8_t *vRow = buf.v.data();
+
+        if (in == InFormat::I420) {
+            uRow = src.data[1] + static_cast<size_t>(y >> 1) * src.stride[1];
+            vRow = src.data[2] + static_cast<size_t>(y >> 1) * src.stride[2];
+        } else if (in == InFormat::NV12) {
+            // 两行亮度共用一行色度, 只在偶数行拆分
+            if ((y & 1) == 0) {
+                k.splitUV(src.data[1] + static_cast<size_t>(y >> 1) * src.stride[1],
+                          buf.u.data(), buf.v.data(), chroma);
+            }
+        } else {
+            k.splitYUY2(yRow, buf.y.data(), buf.u.data(), buf.v.data(), width);
+            yRow = buf.y.data();
+        }
+        row(yRow, uRow, vRow, dst + static_cast<size_t>(y) * dstStride, width);
+    }
+    return 0;
+}
+
+} // namespace yuvconv
@@ -0,0 +1,80 @@
+#ifndef YUV_CONVERT_H
+#define YUV_CONVERT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * YUV -> RGB 转换库(BT.601 limited range)
+ * 输入 NV12/YUYV/I420, 输出 RGB888/BGRA/RGB565
+ * 每种输出格式有 NEON, SSE2, AVX2 实现和标量实现, 启动时按 CPU 特性选择
+ *
+ * 输出内存布局:
+ *   RGB888 : R,G,B           (QImage::Format_RGB888, libyuv RAW)
+ *   BGRA   : B,G,R,A(0xFF)   (小端 QImage::Format_RGB32/ARGB32, libyuv ARGB)
+ *   RGB565 : 小端 uint16 RRRRRGGGGGGBBBBB (QImage::Format_RGB16, libyuv RGB565)
+ *
+ * 目前只用于 convert_bench 对比, 不编进 QC_e:
+ *   NV12/I420 -> RGB888/BGRA 比 libyuv 慢; 只有 YUYV 输入和 RGB565 输出在 AVX2 上更快, 而
+ *   预览的 RGB565 由 convertRotateScale 融合旋转缩放生成, 用不上整帧转换; 拍照一次只转一帧, 收益可忽略,
+ *   换用后还会与 libyuv 相差几个 LSB, 破坏 yuyv_check 的逐字节比较; NEON 实现尚未在 ARM 上验证
+ */
+namespace yuvconv {
+
+enum class InFormat { NV12, YUYV, I420 };
+enum class OutFormat { RGB888, BGRA, RGB565 };
+enum class Isa { Scalar, SSE2, AVX2, NEON };
+
+// 输入平面: NV12 用 0/1(Y, UV), YUYV 用 0, I420 用 0/1/2(Y, U, V)
+struct Planes {
+    const uint8_t *data[3];
+    int stride[3];
+};
+
+// 当前使用的指令集
+Isa activeIsa();
+const char *isaName(Isa isa);
+bool isaSupported(Isa isa);
+// 强制使用指定指令集(用于测试), CPU 不支持时返回 false 且不切换
+bool setIsa(Isa isa);
+
+// 转换整帧, 参数错误返回 -1
+int convert(InFormat in, const Planes &src, int width, int height,
+            uint8_t *dst, int dstStride, OutFormat out);
+
+// 每像素字节数
+int bytesPerPixel(OutFormat out);
+
+namespace detail {
+
+// 行转换: y 为 width 个亮度, u/v 为 (width+1)/2 个色度
+typedef void (*RowFn)(const uint8_t *y, const uint8_t *u, const uint8_t *v, uint8_t *dst, int width);
+// NV12 的 UV 行拆分为 U/V 两行, count 为色度个数
+typedef void (*SplitUVFn)(const uint8_t *uv, uint8_t *u, uint8_t *v, int count);
+// YUYV 行拆分为 Y/U/V 三行
+typedef void (*SplitYUY2Fn)(const uint8_t *src, uint8_t *y, uint8_t *u, uint8_t *v, int width);
+
+struct Kernels {
+    RowFn toRGB888;
+    RowFn toBGRA;
+    RowFn toRGB565;
+    SplitUVFn splitUV;
+    SplitYUY2Fn splitYUY2;
+};
+
+// 标量实现, 也用于 SIMD 实现处理行尾
+void rowToRGB888_C(const uint8_t *y, const uint8_t *u, const uint8_t *v, uint8_t *dst, int width);
+void rowToBGRA_C(const uint8_t *y, const uint8_t *u, const uint8_t *v, uint8_t *dst, int width);
+void rowToRGB565_C(const uint8_t *y, const uint8_t *u, const uint8_t *v, uint8_t *dst, int width);
+void splitUV_C(const uint8_t *uv, uint8_t *u, uint8_t *v, int count);
+void splitYUY2_C(const uint8_t *src, uint8_t *y, uint8_t *u, uint8_t *v, int width);
+
+// 各指令集的实现, 编译目标不支持时返回 false
+bool kernelsSSE2(Kernels &k);
+bool kernelsAVX2(Kernels &k);
+bool kernelsNEON(Kernels &k);
+
+} // namespace detail
+} // namespace yuvconv
+
+#endif // YUV_CONVERT_H
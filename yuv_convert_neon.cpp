@@ -0,0 +1,139 @@
+/*
+ * NEON 实现(RV1126 Cortex-A7 / aarch64)
+ * 32 位 ARM 需要以 -mfpu=neon 编译本文件, 由 CMakeLists.txt 单独设置; 运行时由 yuv_convert.cpp 通过 HWCAP 检测
+ */
+#include "yuv_convert.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+
+#include <arm_neon.h>
+
+namespace yuvconv {
+namespace detail {
+
+namespace {
+
+// 8 个像素(16 位)的 YUV -> RGB, 系数与标量实现一致
+inline void yuvToRgb8_neon(uint8x8_t y8, uint8x8_t u8, uint8x8_t v8,
+                           uint8x8_t &r, uint8x8_t &g, uint8x8_t &b)
+{
+    const int16x8_t y = vreinterpretq_s16_u16(vmovl_u8(y8));
+    const int16x8_t d = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(u8)), vdupq_n_s16(128));
+    const int16x8_t e = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(v8)), vdupq_n_s16(128));
+    const int16x8_t y1 = vsubq_s16(vmulq_n_s16(y, 74), vdupq_n_s16(1152));
+    r = vqmovun_s16(vshrq_n_s16(vqaddq_s16(y1, vmulq_n_s16(e, 102)), 6));
+    g = vqmovun_s16(vshrq_n_s16(vqaddq_s16(vqaddq_s16(y1, vmulq_n_s16(d, -25)), vmulq_n_s16(e, -52)), 6));
+    b = vqmovun_s16(vshrq_n_s16(vqaddq_s16(y1, vmulq_n_s16(d, 129)), 6));
+}
+
+// 16 个像素
+inline void yuvToRgb16_neon(const uint8_t *yp, const uint8_t *up, const uint8_t *vp,
+                            uint8x16_t &r, uint8x16_t &g, uint8x16_t &b)
+{
+    const uint8x16_t y = vld1q_u8(yp);
+    // 色度水平复制到每个像素
+    const uint8x8x2_t u = vzip_u8(vld1_u8(up), vld1_u8(up));
+    const uint8x8x2_t v = vzip_u8(vld1_u8(vp), vld1_u8(vp));
+    uint8x8_t rl, gl, bl, rh, gh, bh;
+    yuvToRgb8_neon(vget_low_u8(y), u.val[0], v.val[0], rl, gl, bl);
+    yuvToRgb8_neon(vget_high_u8(y), u.val[1], v.val[1], rh, gh, bh);
+    r = vcombine_u8(rl, rh);
+    g = vcombine_u8(gl, gh);
+    b = vcombine_u8(bl, bh);
+}
+
+inline uint16x8_t pack565_neon(uint8x8_t r, uint8x8_t g, uint8x8_t b)
+{
+    const uint16x8_t r5 = vshlq_n_u16(vmovl_u8(vshr_n_u8(r, 3)), 11);
+    const uint16x8_t g6 = vshlq_n_u16(vmovl_u8(vshr_n_u8(g, 2)), 5);
+    const uint16x8_t b5 = vmovl_u8(vshr_n_u8(b, 3));
+    return vorrq_u16(vorrq_u16(r5, g6), b5);
+}
+
+void rowToRGB888_NEON(const uint8_t *y, const uint8_t *u, const uint8_t *v, uint8_t *dst, int width)
+{
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        uint8x16x3_t rgb;
+        yuvToRgb16_neon(y + x, u + x / 2, v + x / 2, rgb.val[0], rgb.val[1], rgb.val[2]);
+        vst3q_u8(dst + x * 3, rgb);
+    }
+    if (x < width) rowToRGB888_C(y + x, u + x / 2, v + x / 2, dst + x * 3, width - x);
+}
+
+void rowToBGRA_NEON(const uint8_t *y, const uint8_t *u, const uint8_t *v, uint8_t *dst, int width)
+{
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        uint8x16x4_t bgra;
+        yuvToRgb16_neon(y + x, u + x / 2, v + x / 2, bgra.val[2], bgra.val[1], bgra.val[0]);
+        bgra.val[3] = vdupq_n_u8(0xFF);
+        vst4q_u8(dst + x * 4, bgra);
+    }
+    if (x < width) rowToBGRA_C(y + x, u + x / 2, v + x / 2, dst + x * 4, width - x);
+}
+
+void rowToRGB565_NEON(const uint8_t *y, const uint8_t *u, const uint8_t *v, uint8_t *dst, int width)
+{
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        uint8x16_t r, g, b;
+        yuvToRgb16_neon(y + x, u + x / 2, v + x / 2, r, g, b);
+        uint16_t *out = reinterpret_cast<uint16_t*>(dst + x * 2);
+        vst1q_u16(out, pack565_neon(vget_low_u8(r), vget_low_u8(g), vget_low_u8(b)));
+        vst1q_u16(out + 8, pack565_neon(vget_high_u8(r), vget_high_u8(g), vget_high_u8(b)));
+    }
+    if (x < width) rowToRGB565_C(y + x, u + x / 2, v + x / 2, dst + x * 2, width - x);
+}
+
+void splitUV_NEON(const uint8_t *uv, uint8_t *u, uint8_t *v, int count)
+{
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        const uint8x16x2_t p = vld2q_u8(uv + 2 * i);
+        vst1q_u8(u + i, p.val[0]);
+        vst1q_u8(v + i, p.val[1]);
+    }
+    if (i < count) splitUV_C(uv + 2 * i, u + i, v + i, count - i);
+}
+
+void splitYUY2_NEON(const uint8_t *src, uint8_t *y, uint8_t *u, uint8_t *v, int width)
+{
+    int x = 0;
+    for (; x + 32 <= width; x += 32) {
+        // val[0]=Y0, val[1]=U, val[2]=Y1, val[3]=V
+        const uint8x16x4_t p = vld4q_u8(src + x * 2);
+        uint8x16x2_t yy;
+        yy.val[0] = p.val[0];
+        yy.val[1] = p.val[2];
+        vst2q_u8(y + x, yy);
+        vst1q_u8(u + x / 2, p.val[1]);
+        vst1q_u8(v + x / 2, p.val[3]);
+    }
+    if (x < width) splitYUY2_C(src + x * 2, y + x, u + x / 2, v + x / 2, width - x);
+}
+
+} // namespace
+
+bool kernelsNEON(Kernels &k)
+{
+    k.toRGB888 = rowToRGB888_NEON;
+    k.toBGRA = rowToBGRA_NEON;
+    k.toRGB565 = rowToRGB565_NEON;
+    k.splitUV = splitUV_NEON;
+    k.splitYUY2 = splitYUY2_NEON;
+    return true;
+}
+
+} // namespace detail
+} // namespace yuvconv
+
+#else
+
+namespace yuvconv {
+namespace detail {
+bool kernelsNEON(Kernels &) { return false; }
+} // namespace detail
+} // namespace yuvconv
+
+#endif
@@ -0,0 +1,316 @@
+/*
+ * SSE2/AVX2 实现
+ * 各段通过 #pragma GCC target 单独开启指令集, 整个工程不需要 -mavx2, 运行时由 yuv_convert.cpp 检测后再使用
+ */
+#include "yuv_convert.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#include <immintrin.h>
+
+namespace yuvconv {
+namespace detail {
+
+/* ---------------------------------- SSE2 ---------------------------------- */
+#pragma GCC push_options
+#pragma GCC target("sse2")
+
+namespace {
+
+// 8 个像素(16 位)的 YUV -> RGB, 系数与标量实现一致
+inline void yuvToRgb8_sse2(__m128i y, __m128i u, __m128i v, __m128i &r, __m128i &g, __m128i &b)
+{
+    const __m128i c128 = _mm_set1_epi16(128);
+    const __m128i y1 = _mm_sub_epi16(_mm_mullo_epi16(y, _mm_set1_epi16(74)), _mm_set1_epi16(1152));
+    const __m128i d = _mm_sub_epi16(u, c128);
+    const __m128i e = _mm_sub_epi16(v, c128);
+    r = _mm_srai_epi16(_mm_adds_epi16(y1, _mm_mullo_epi16(e, _mm_set1_epi16(102))), 6);
+    g = _mm_srai_epi16(_mm_adds_epi16(_mm_adds_epi16(y1, _mm_mullo_epi16(d, _mm_set1_epi16(-25))),
+                                      _mm_mullo_epi16(e, _mm_set1_epi16(-52))), 6);
+    b = _mm_srai_epi16(_mm_adds_epi16(y1, _mm_mullo_epi16(d, _mm_set1_epi16(129))), 6);
+}
+
+// 16 个像素, 输出饱和到 8 位的 R/G/B
+inline void yuvToRgb16_sse2(const uint8_t *yp, const uint8_t *up, const uint8_t *vp,
+                            __m128i &r, __m128i &g, __m128i &b)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(yp));
+    __m128i u = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(up));
+    __m128i v = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(vp));
+    // 色度水平复制到每个像素
+    u = _mm_unpacklo_epi8(u, u);
+    v = _mm_unpacklo_epi8(v, v);
+
+    __m128i rl, gl, bl, rh, gh, bh;
+    yuvToRgb8_sse2(_mm_unpacklo_epi8(y, zero), _mm_unpacklo_epi8(u, zero), _mm_unpacklo_epi8(v, zero),
+                   rl, gl, bl);
+    yuvToRgb8_sse2(_mm_unpackhi_epi8(y, zero), _mm_unpackhi_epi8(u, zero), _mm_unpackhi_epi8(v, zero),
+                   rh, gh, bh);
+    r = _mm_packus_epi16(rl, rh);
+    g = _mm_packus_epi16(gl, gh);
+    b = _mm_packus_epi16(bl, bh);
+}
+
+inline __m128i pack565_sse2(__m128i r, __m128i g, __m128i b)
+{
+    // r/g/b 为 16 位 0..255
+    const __m128i r5 = _mm_slli_epi16(_mm_srli_epi16(r, 3), 11);
+    const __m128i g6 = _mm_slli_epi16(_mm_srli_epi16(g, 2), 5);
+    const __m128i b5 = _mm_srli_epi16(b, 3);
+    return _mm_or_si128(_mm_or_si128(r5, g6), b5);
+}
+
+void rowToRGB888_SSE2(const uint8_t *y, const uint8_t *u, const uint8_t *v, uint8_t *dst, int width)
+{
+    // SSE2 没有字节重排指令, 先写到栈上再交织为 3 字节
+    alignas(16) uint8_t rb[16], gb[16], bb[16];
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m128i r, g, b;
+        yuvToRgb16_sse2(y + x, u + x / 2, v + x / 2, r, g, b);
+        _mm_store_si128(reinterpret_cast<__m128i*>(rb), r);
+        _mm_store_si128(reinterpret_cast<__m128i*>(gb), g);
+        _mm_store_si128(reinterpret_cast<__m128i*>(bb), b);
+        for (int i = 0; i < 16; i++) {
+            dst[0] = rb[i];
+            dst[1] = gb[i];
+            dst[2] = bb[i];
+            dst += 3;
+        }
+    }
+    if (x < width) rowToRGB888_C(y + x, u + x / 2, v + x / 2, dst, width - x);
+}
+
+void rowToBGRA_SSE2(const uint8_t *y, const uint8_t *u, const uint8_t *v, uint8_t *dst, int width)
+{
+    const __m128i alpha = _mm_set1_epi8(static_cast<char>(0xFF));
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m128i r, g, b;
+        yuvToRgb16_sse2(y + x, u + x / 2, v + x / 2, r, g, b);
+        const __m128i bgLo = _mm_unpacklo_epi8(b, g);
+        const __m128i bgHi = _mm_unpackhi_epi8(b, g);
+        const __m128i raLo = _mm_unpacklo_epi8(r, alpha);
+        const __m128i raHi = _mm_unpackhi_epi8(r, alpha);
+        __m128i *out = reinterpret_cast<__m128i*>(dst + x * 4);
+        _mm_storeu_si128(out + 0, _mm_unpacklo_epi16(bgLo, raLo));
+        _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(bgLo, raLo));
+        _mm_storeu_si128(out + 2, _mm_unpacklo_epi16(bgHi, raHi));
+        _mm_storeu_si128(out + 3, _mm_unpackhi_epi16(bgHi, raHi));
+    }
+    if (x < width) rowToBGRA_C(y + x, u + x / 2, v + x / 2, dst + x * 4, width - x);
+}
+
+void rowToRGB565_SSE2(const uint8_t *y, const uint8_t *u, const uint8_t *v, uint8_t *dst, int width)
+{
+    const __m128i zero = _mm_setzero_si128();
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m128i r, g, b;
+        yuvToRgb16_sse2(y + x, u + x / 2, v + x / 2, r, g, b);
+        __m128i *out = reinterpret_cast<__m128i*>(dst + x * 2);
+        _mm_storeu_si128(out + 0, pack565_sse2(_mm_unpacklo_epi8(r, zero), _mm_unpacklo_epi8(g, zero),
+                                               _mm_unpacklo_epi8(b, zero)));
+        _mm_storeu_si128(out + 1, pack565_sse2(_mm_unpackhi_epi8(r, zero), _mm_unpackhi_epi8(g, zero),
+                                               _mm_unpackhi_epi8(b, zero)));
+    }
+    if (x < width) rowToRGB565_C(y + x, u + x / 2, v + x / 2, dst + x * 2, width - x);
+}
+
+void splitUV_SSE2(const uint8_t *uv, uint8_t *u, uint8_t *v, int count)
+{
+    const __m128i mask = _mm_set1_epi16(0x00FF);
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(uv + 2 * i));
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(uv + 2 * i + 16));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(u + i),
+                         _mm_packus_epi16(_mm_and_si128(a, mask), _mm_and_si128(b, mask)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(v + i),
+                         _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8)));
+    }
+    if (i < count) splitUV_C(uv + 2 * i, u + i, v + i, count - i);
+}
+
+void splitYUY2_SSE2(const uint8_t *src, uint8_t *y, uint8_t *u, uint8_t *v, int width)
+{
+    const __m128i mask = _mm_set1_epi16(0x00FF);
+    int x = 0;
+    for (; x + 32 <= width; x += 32) {
+        // 32 个像素 = 64 字节 Y0 U Y1 V ...
+        const __m128i *in = reinterpret_cast<const __m128i*>(src + x * 2);
+        const __m128i a = _mm_loadu_si128(in + 0);
+        const __m128i b = _mm_loadu_si128(in + 1);
+        const __m128i c = _mm_loadu_si128(in + 2);
+        const __m128i d = _mm_loadu_si128(in + 3);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(y + x),
+                         _mm_packus_epi16(_mm_and_si128(a, mask), _mm_and_si128(b, mask)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(y + x + 16),
+                         _mm_packus_epi16(_mm_and_si128(c, mask), _mm_and_si128(d, mask)));
+        // 剩下 U V U V ...
+        const __m128i uv0 = _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8));
+        const __m128i uv1 = _mm_packus_epi16(_mm_srli_epi16(c, 8), _mm_srli_epi16(d, 8));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(u + x / 2),
+                         _mm_packus_epi16(_mm_and_si128(uv0, mask), _mm_and_si128(uv1, mask)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(v + x / 2),
+                         _mm_packus_epi16(_mm_srli_epi16(uv0, 8), _mm_srli_epi16(uv1, 8)));
+    }
+    if (x < width) splitYUY2_C(src + x * 2, y + x, u + x / 2, v + x / 2, width - x);
+}
+
+} // namespace
+
+bool kernelsSSE2(Kernels &k)
+{
+    k.toRGB888 = rowToRGB888_SSE2;
+    k.toBGRA = rowToBGRA_SSE2;
+    k.toRGB565 = rowToRGB565_SSE2;
+    k.splitUV = splitUV_SSE2;
+    k.splitYUY2 = splitYUY2_SSE2;
+    return true;
+}
+
+#pragma GCC pop_options
+
+/* ---------------------------------- AVX2 ---------------------------------- */
+#pragma GCC push_options
+#pragma GCC target("avx2")
+
+namespace {
+
+inline void yuvToRgb16_avx2(__m256i y, __m256i u, __m256i v, __m256i &r, __m256i &g, __m256i &b)
+{
+    const __m256i c128 = _mm256_set1_epi16(128);
+    const __m256i y1 = _mm256_sub_epi16(_mm256_mullo_epi16(y, _mm256_set1_epi16(74)), _mm256_set1_epi16(1152));
+    const __m256i d = _mm256_sub_epi16(u, c128);
+    const __m256i e = _mm256_sub_epi16(v, c128);
+    r = _mm256_srai_epi16(_mm256_adds_epi16(y1, _mm256_mullo_epi16(e, _mm256_set1_epi16(102))), 6);
+    g = _mm256_srai_epi16(_mm256_adds_epi16(_mm256_adds_epi16(y1, _mm256_mullo_epi16(d, _mm256_set1_epi16(-25))),
+                                            _mm256_mullo_epi16(e, _mm256_set1_epi16(-52))), 6);
+    b = _mm256_srai_epi16(_mm256_adds_epi16(y1, _mm256_mullo_epi16(d, _mm256_set1_epi16(129))), 6);
+}
+
+// 32 个像素, 输出按像素顺序排列的 8 位 R/G/B
+inline void yuvToRgb32_avx2(const uint8_t *yp, const uint8_t *up, const uint8_t *vp,
+                            __m256i &r, __m256i &g, __m256i &b)
+{
+    const __m256i yLo = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(yp)));
+    const __m256i yHi = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(yp + 16)));
+    // 16 个色度扩展为 16 位后调整 64 位块顺序, 使 lane 内的 unpack 得到按像素顺序的复制结果
+    const __m256i u16 = _mm256_permute4x64_epi64(
+        _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(up))), 0xD8);
+    const __m256i v16 = _mm256_permute4x64_epi64(
+        _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(vp))), 0xD8);
+
+    __m256i rl, gl, bl, rh, gh, bh;
+    yuvToRgb16_avx2(yLo, _mm256_unpacklo_epi16(u16, u16), _mm256_unpacklo_epi16(v16, v16), rl, gl, bl);
+    yuvToRgb16_avx2(yHi, _mm256_unpackhi_epi16(u16, u16), _mm256_unpackhi_epi16(v16, v16), rh, gh, bh);
+    // packus 在 lane 内交错, 再恢复像素顺序
+    r = _mm256_permute4x64_epi64(_mm256_packus_epi16(rl, rh), 0xD8);
+    g = _mm256_permute4x64_epi64(_mm256_packus_epi16(gl, gh), 0xD8);
+    b = _mm256_permute4x64_epi64(_mm256_packus_epi16(bl, bh), 0xD8);
+}
+
+// 32 个像素的 BGRA, 按像素顺序输出 4 个向量
+inline void toBGRA32_avx2(__m256i r, __m256i g, __m256i b, __m256i out[4])
+{
+    const __m256i alpha = _mm256_set1_epi8(static_cast<char>(0xFF));
+    const __m256i bgLo = _mm256_unpacklo_epi8(b, g);     // 像素 0-7 | 16-23
+    const __m256i bgHi = _mm256_unpackhi_epi8(b, g);     // 像素 8-15 | 24-31
+    const __m256i raLo = _mm256_unpacklo_epi8(r, alpha);
+    const __m256i raHi = _mm256_unpackhi_epi8(r, alpha);
+    const __m256i q0 = _mm256_unpacklo_epi16(bgLo, raLo); // 0-3 | 16-19
+    const __m256i q1 = _mm256_unpackhi_epi16(bgLo, raLo); // 4-7 | 20-23
+    const __m256i q2 = _mm256_unpacklo_epi16(bgHi, raHi); // 8-11 | 24-27
+    const __m256i q3 = _mm256_unpackhi_epi16(bgHi, raHi); // 12-15 | 28-31
+    out[0] = _mm256_permute2x128_si256(q0, q1, 0x20);
+    out[1] = _mm256_permute2x128_si256(q2, q3, 0x20);
+    out[2] = _mm256_permute2x128_si256(q0, q1, 0x31);
+    out[3] = _mm256_permute2x128_si256(q2, q3, 0x31);
+}
+
+void rowToBGRA_AVX2(const uint8_t *y, const uint8_t *u, const uint8_t *v, uint8_t *dst, int width)
+{
+    int x = 0;
+    for (; x + 32 <= width; x += 32) {
+        __m256i r, g, b, out[4];
+        yuvToRgb32_avx2(y + x, u + x / 2, v + x / 2, r, g, b);
+        toBGRA32_avx2(r, g, b, out);
+        __m256i *p = reinterpret_cast<__m256i*>(dst + x * 4);
+        for (int i = 0; i < 4; i++) _mm256_storeu_si256(p + i, out[i]);
+    }
+    if (x < width) rowToBGRA_C(y + x, u + x / 2, v + x / 2, dst + x * 4, width - x);
+}
+
+void rowToRGB888_AVX2(const uint8_t *y, const uint8_t *u, const uint8_t *v, uint8_t *dst, int width)
+{
+    // 每个 128 位 lane 的 4 个 BGRA 像素压缩为 12 字节 R,G,B
+    const __m256i shuffle = _mm256_setr_epi8(
+        2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+        2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    int x = 0;
+    // 每个 lane 写 16 字节只有 12 字节有效, 多写的 4 字节会被后续写覆盖, 因此行尾至少留 2 个像素给标量处理
+    for (; x + 34 <= width; x += 32) {
+        __m256i r, g, b, out[4];
+        yuvToRgb32_avx2(y + x, u + x / 2, v + x / 2, r, g, b);
+        toBGRA32_avx2(r, g, b, out);
+        uint8_t *p = dst + x * 3;
+        for (int i = 0; i < 4; i++) {
+            const __m256i packed = _mm256_shuffle_epi8(out[i], shuffle);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(p), _mm256_castsi256_si128(packed));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(p + 12), _mm256_extracti128_si256(packed, 1));
+            p += 24;
+        }
+    }
+    if (x < width) rowToRGB888_C(y + x, u + x / 2, v + x / 2, dst + x * 3, width - x);
+}
+
+void rowToRGB565_AVX2(const uint8_t *y, const uint8_t *u, const uint8_t *v, uint8_t *dst, int width)
+{
+    int x = 0;
+    for (; x + 32 <= width; x += 32) {
+        __m256i r, g, b;
+        yuvToRgb32_avx2(y + x, u + x / 2, v + x / 2, r, g, b);
+        __m256i *p = reinterpret_cast<__m256i*>(dst + x * 2);
+        for (int half = 0; half < 2; half++) {
+            const __m256i r16 = _mm256_cvtepu8_epi16(half ? _mm256_extracti128_si256(r, 1) : _mm256_castsi256_si128(r));
+            const __m256i g16 = _mm256_cvtepu8_epi16(half ? _mm256_extracti128_si256(g, 1) : _mm256_castsi256_si128(g));
+            const __m256i b16 = _mm256_cvtepu8_epi16(half ? _mm256_extracti128_si256(b, 1) : _mm256_castsi256_si128(b));
+            const __m256i px = _mm256_or_si256(
+                _mm256_or_si256(_mm256_slli_epi16(_mm256_srli_epi16(r16, 3), 11),
+                                _mm256_slli_epi16(_mm256_srli_epi16(g16, 2), 5)),
+                _mm256_srli_epi16(b16, 3));
+            _mm256_storeu_si256(p + half, px);
+        }
+    }
+    if (x < width) rowToRGB565_C(y + x, u + x / 2, v + x / 2, dst + x * 2, width - x);
+}
+
+} // namespace
+
+bool kernelsAVX2(Kernels &k)
+{
+    // 拆分操作是纯内存带宽, 沿用 SSE2 实现
+    kernelsSSE2(k);
+    k.toRGB888 = rowToRGB888_AVX2;
+    k.toBGRA = rowToBGRA_AVX2;
+    k.toRGB565 = rowToRGB565_AVX2;
+    return true;
+}
+
+#pragma GCC pop_options
+
+} // namespace detail
+} // namespace yuvconv
+
+#else
+
+namespace yuvconv {
+namespace detail {
+bool kernelsSSE2(Kernels &) { return false; }
+bool kernelsAVX2(Kernels &) { return false; }
+} // namespace detail
+} // namespace yuvconv
+
+#endif